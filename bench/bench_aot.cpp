@@ -0,0 +1,180 @@
+// Checks code recompiled ahead of time against the interpreter: runs
+// HELLO_WORLD, recompiled at build time by `vm_6502 --recompile`, under
+// AotRunner, CPU::Execute and BlockCache, and requires the same console
+// output, registers, memory, cycles and stop reason from each. Besides the
+// image as recompiled, it runs one patched before the start and one whose
+// code is rewritten while it runs, where the blocks that no longer match
+// have to be interpreted.
+//
+// HELLO_WORLD never halts and runs its stack out of memory after some 600k
+// cycles, so it is booted BOOTS times into the same Memory for
+// CYCLES_PER_BOOT each, the engine keeping what it checked or decoded.
+//
+// Each run reports its emulated MHz and, for AotRunner, how many blocks ran
+// natively. Exits with 1 when any run differs from CPU::Execute's.
+//
+//   cmake --build build --target bench_aot && build/bench_aot
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+#include "aot.hpp"
+#include "block.hpp"
+#include "compiler.hpp"
+#include "console.hpp"
+#include "hello.hpp"
+
+extern const aot::Program HELLO_WORLD_AOT;
+
+static constexpr u64 CYCLES_PER_BOOT = 500'000;
+static constexpr u32 BOOTS = 40;
+
+// the operands of `LDA #'H'` and of the `SDA $00` after it, which the
+// printing loop keeps coming back to
+static constexpr word FIRST_CHARACTER = 0x0101;
+static constexpr word FIRST_STORE = 0x0103;
+static constexpr u64 REWRITE_AT = 100;		// cycles into a boot, once the loop has started
+
+enum class Change
+{
+	None,
+	Patched,		// FIRST_CHARACTER before the start
+	Rewritten,		// FIRST_STORE at REWRITE_AT
+};
+
+using Engine = std::function<ExecResult(CPU& cpu, u64 cycles, Memory& ram)>;
+
+struct Run
+{
+	std::string output;
+	CPU cpu;				// after the last boot, as is memory
+	ExecResult result;		// cycles of all boots, reason of the last
+	std::vector<byte> memory;
+	double seconds = 0;
+};
+
+// Runs `engine` for `cycles` in all, or until the guest halts or idles: like
+// main(), it carries on after invalid opcodes and I/O waits.
+static ExecResult RunFor(const Engine& engine, CPU& cpu, u64 cycles, Memory& ram)
+{
+	ExecResult total{ 0, StopReason::Budget };
+	while (total.cycles < cycles)
+	{
+		ExecResult result = engine(cpu, cycles - total.cycles, ram);
+		total.cycles += result.cycles;
+		total.reason = result.reason;
+		if (result.reason == StopReason::Halt || result.reason == StopReason::Idle)
+		{
+			break;
+		}
+	}
+	return total;
+}
+
+static Run Boot(const Assembly& program, Change change, const Engine& engine)
+{
+	Run run;
+	run.result = { 0, StopReason::Budget };
+	Memory ram;
+	Console console([&](std::span<const byte> data) { run.output.append(data.begin(), data.end()); });
+	ram.Map(Console::ADDRESS, Console::ADDRESS, console);
+	for (u32 boot = 0; boot < BOOTS; boot++)
+	{
+		run.cpu.Reset(ram);
+		program.Load(ram);
+		if (change == Change::Patched)
+		{
+			ram[FIRST_CHARACTER] = 'J';
+		}
+
+		auto begin = std::chrono::steady_clock::now();
+		ExecResult first = RunFor(engine, run.cpu, REWRITE_AT, ram);
+		if (change == Change::Rewritten)
+		{
+			ram[FIRST_STORE] = 0x01;
+		}
+		ExecResult rest = RunFor(engine, run.cpu, CYCLES_PER_BOOT - first.cycles, ram);
+		auto end = std::chrono::steady_clock::now();
+
+		run.result.cycles += first.cycles + rest.cycles;
+		run.result.reason = rest.reason;
+		run.seconds += std::chrono::duration<double>(end - begin).count();
+	}
+	console.Flush();
+
+	// bypassing the console
+	for (u32 page = 0; page < Memory::PAGE_COUNT; page++)
+	{
+		const byte* data = ram.PageData(page);
+		run.memory.insert(run.memory.end(), data, data + Memory::PAGE_SIZE);
+	}
+	return run;
+}
+
+static const char* Differs(const Run& run, const Run& reference)
+{
+	if (run.result.cycles != reference.result.cycles || run.result.reason != reference.result.reason)
+	{
+		return "cycles or stop reason differ";
+	}
+	if (!(run.cpu == reference.cpu))
+	{
+		return "registers differ";
+	}
+	if (run.output != reference.output)
+	{
+		return "console output differs";
+	}
+	if (run.memory != reference.memory)
+	{
+		return "memory differs";
+	}
+	return nullptr;
+}
+
+int main()
+{
+	Assembly program = compile(HELLO_WORLD);
+	if (!program.Ok())
+	{
+		std::fprintf(stderr, "%s\n", program.errors.front().c_str());
+		return 1;
+	}
+
+	const struct { const char* name; Change change; } changes[] =
+	{
+		{ "hello", Change::None },
+		{ "patched", Change::Patched },
+		{ "rewritten", Change::Rewritten },
+	};
+
+	bool ok = true;
+	std::printf("%-10s %-7s %10s %10s %10s   %s\n", "program", "engine", "seconds", "MHz", "native", "result");
+	for (const auto& c : changes)
+	{
+		auto report = [&](const char* engine, const Run& run, const char* difference, const char* native)
+		{
+			std::printf("%-10s %-7s %10.3f %10.1f %10s   %s\n", c.name, engine, run.seconds,
+				run.result.cycles / run.seconds / 1e6, native, difference ? difference : "identical");
+			ok &= difference == nullptr;
+		};
+
+		Run reference = Boot(program, c.change, [](CPU& cpu, u64 cycles, Memory& ram) { return cpu.Execute(cycles, ram); });
+		report("execute", reference, nullptr, "-");
+
+		auto cache = std::make_shared<BlockCache>();
+		Run blocks = Boot(program, c.change, [cache](CPU& cpu, u64 cycles, Memory& ram) { return cache->Execute(cpu, cycles, ram); });
+		report("blocks", blocks, Differs(blocks, reference), "-");
+
+		auto runner = std::make_shared<AotRunner>(HELLO_WORLD_AOT);
+		Run aot = Boot(program, c.change, [runner](CPU& cpu, u64 cycles, Memory& ram) { return runner->Execute(cpu, cycles, ram); });
+		std::string native = std::to_string(runner->m_NativeRuns);
+		report("aot", aot, Differs(aot, reference), native.c_str());
+	}
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,177 @@
+// Checks and times CpuBatch against CPU::Execute: runs LANES copies of a
+// program, each on its own data, as one batch and as LANES Execute() calls
+// one after the other, and requires every lane to end with the registers,
+// memory, cycles and stop reason of its scalar run.
+//
+// The lock-step program takes the same path on any data, so every step but
+// the last is uniform. The diverging one branches on its data, so lanes come
+// apart at every byte and wait for each other to meet again; it shows what
+// that costs.
+//
+// Reports the emulated MHz of both, summed over the lanes, and the share of
+// batch steps taken in lock-step. Exits with 1 when a check fails.
+//
+//   cmake --build build --target bench_batch && build/bench_batch
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <utility>
+#include "batch.hpp"
+#include "compiler.hpp"
+
+static constexpr size_t LANES = 256;
+static constexpr u64 CYCLES = 100'000'000;		// more than the programs run
+static constexpr word DATA = 0x0300;			// a page of lane data
+
+// mixes the data page into a hash at $10, PASSES times
+static constexpr const char* LOCK_STEP = R"(
+PASSES = 8
+DATA = $0300
+
+		.org $0200
+start:	LDY #PASSES
+pass:	LDX #0
+loop:	LDA $10
+		EOR DATA,X
+		CLC
+		ADC #$3B
+		SDA $10
+		EOR DATA+1,X
+		SDA DATA,X
+		INX
+		CPX #$FF
+		BEQ next
+		JMP loop
+next:	DEY
+		BEQ done
+		JMP pass
+done:	JMP done
+)";
+
+// counts the data bytes with bit 7 set at $11, taking a branch on each
+static constexpr const char* DIVERGING = R"(
+PASSES = 8
+DATA = $0300
+
+		.org $0200
+start:	LDY #PASSES
+pass:	LDX #0
+loop:	LDA #0
+		EOR DATA,X
+		CMP #$80
+		BCC skip
+		INC $11
+skip:	INX
+		CPX #$FF
+		BEQ next
+		JMP loop
+next:	DEY
+		BEQ done
+		JMP pass
+done:	JMP done
+)";
+
+// lane `lane`'s data
+static void Seed(Memory& ram, size_t lane)
+{
+	u32 state = (u32)lane * 2654435761u + 1;
+	for (u32 i = 0; i < Memory::PAGE_SIZE; i++)
+	{
+		state = state * 1103515245u + 12345u;
+		ram[DATA + i] = (byte)(state >> 16);
+	}
+	ram[0x10] = (byte)lane;
+}
+
+static bool Same(const Memory& a, const Memory& b)
+{
+	static byte left[Memory::MAX_MEM], right[Memory::MAX_MEM];
+	a.ReadBlock(0, left, Memory::MAX_MEM);
+	b.ReadBlock(0, right, Memory::MAX_MEM);
+	return std::equal(left, left + Memory::MAX_MEM, right);
+}
+
+struct Timing
+{
+	double scalar = 0;
+	double batch = 0;
+	u64 cycles = 0;		// over all lanes
+	double uniform = 0;	// share of batch steps in lock-step
+};
+
+static const char* Compare(const char* source, Timing& timing)
+{
+	Assembly program = compile(source);
+	if (!program.Ok())
+	{
+		return "the program does not assemble";
+	}
+	const Symbol* start = program.Find("start");
+	Memory base;
+	program.Load(base);
+
+	std::vector<Memory> rams(LANES);
+	std::vector<CPU> cpus(LANES);
+	std::vector<ExecResult> results(LANES);
+	CpuBatch batch(LANES);
+	for (size_t lane = 0; lane < LANES; lane++)
+	{
+		rams[lane] = base;
+		cpus[lane].SoftReset();
+		Seed(rams[lane], lane);
+		cpus[lane].PC = (word)start->value;
+		batch.Ram(lane) = rams[lane];
+		batch.Load(lane, cpus[lane]);
+	}
+
+	auto begin = std::chrono::steady_clock::now();
+	for (size_t lane = 0; lane < LANES; lane++)
+	{
+		results[lane] = cpus[lane].Execute(CYCLES, rams[lane]);
+	}
+	auto middle = std::chrono::steady_clock::now();
+	batch.Execute(CYCLES);
+	auto end = std::chrono::steady_clock::now();
+
+	timing.scalar = std::chrono::duration<double>(middle - begin).count();
+	timing.batch = std::chrono::duration<double>(end - middle).count();
+	timing.cycles = 0;
+	for (size_t lane = 0; lane < LANES; lane++)
+	{
+		if (results[lane].reason != StopReason::Halt)
+		{
+			return "the program does not halt";
+		}
+		const ExecResult& result = batch.Result(lane);
+		if (!(batch.Get(lane) == cpus[lane]) || result.cycles != results[lane].cycles || result.reason != results[lane].reason
+			|| !Same(batch.Ram(lane), rams[lane]))
+		{
+			return "a lane differs from its CPU::Execute run";
+		}
+		timing.cycles += result.cycles;
+	}
+	timing.uniform = (double)batch.m_UniformSteps / (batch.m_UniformSteps + batch.m_DivergentSteps);
+	return nullptr;
+}
+
+int main()
+{
+	std::printf("%zu lanes\n", LANES);
+	std::printf("%-10s %12s %12s %10s %10s\n", "program", "execute MHz", "batch MHz", "speedup", "lock-step");
+	const char* failure = nullptr;
+	for (const auto& [name, source] : { std::pair{ "lock-step", LOCK_STEP }, std::pair{ "diverging", DIVERGING } })
+	{
+		Timing timing;
+		failure = Compare(source, timing);
+		if (failure)
+		{
+			std::printf("%-10s %s\n", name, failure);
+			break;
+		}
+		std::printf("%-10s %12.1f %12.1f %9.2fx %9.0f%%\n", name, timing.cycles / timing.scalar / 1e6,
+			timing.cycles / timing.batch / 1e6, timing.scalar / timing.batch, timing.uniform * 100);
+	}
+	std::printf("%s\n", failure ? failure : "lanes checked");
+	return failure ? 1 : 0;
+}
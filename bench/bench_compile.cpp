@@ -0,0 +1,47 @@
+// Assembler throughput on a large generated source.
+//
+//   g++ -std=c++20 -O2 -I vm_6502 bench/bench_compile.cpp vm_6502/compiler.cpp
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include "compiler.hpp"
+
+int main()
+{
+	// 16 routines of 256 loops each, about 53 KiB of code: labels, forward references, constants
+	std::string source = "CONSOLE = $FFFF\n\t.org $0200\n";
+	u32 lines = 2;
+	for (u32 routine = 0; routine < 16; routine++)
+	{
+		for (u32 loop = 0; loop < 256; loop++)
+		{
+			std::string name = "r" + std::to_string(routine) + "_" + std::to_string(loop);
+			source += name + "_size = " + name + "_end - " + name + "\t; constant from later labels\n";
+			source += name + ":\tLDA #'a' + " + std::to_string(loop % 26) + "\n";
+			source += "\t\tSDA CONSOLE\n";
+			source += "\t\tLDX $" + std::to_string(loop % 100) + ",Y\n";
+			source += "\t\tCPY #" + name + "_size\n";
+			source += "\t\tBEQ " + name + "_end\n";
+			source += "\t\tINY\n";
+			source += name + "_end:\n";
+			lines += 8;
+		}
+	}
+
+	constexpr u32 ROUNDS = 50;
+	size_t errors = 0;
+	auto begin = std::chrono::steady_clock::now();
+	for (u32 i = 0; i < ROUNDS; i++)
+	{
+		Assembly assembly = compile(source);
+		errors += assembly.errors.size();
+	}
+	auto end = std::chrono::steady_clock::now();
+	double seconds = std::chrono::duration<double>(end - begin).count() / ROUNDS;
+
+	std::printf("%10s %10s %12s %10s\n", "lines", "ms", "lines/s", "MB/s");
+	std::printf("%10u %10.2f %12.0f %10.1f\n", lines, seconds * 1000, lines / seconds,
+		source.size() / seconds / 1e6);
+	return errors != 0;
+}
@@ -0,0 +1,206 @@
+// Compares CPU::ExecuteSwitch, CPU::ExecuteTable (handler table),
+// CPU::ExecuteThreaded (computed goto), BlockCache (pre-decoded basic blocks,
+// with and without fused pairs, whose dispatches per instruction it also
+// reports) and Jit (x86-64 translation) on the same guest programs, plus the cost of
+// running CPU::ExecuteTable's loop under the Profiler and the TraceRecorder (which
+// writes bench_dispatch.trace in the current directory and deletes it after).
+//
+//   g++ -std=c++20 -O2 -I vm_6502 bench/bench_dispatch.cpp vm_6502/cpu.cpp vm_6502/dispatch.cpp vm_6502/threaded.cpp vm_6502/block.cpp vm_6502/jit.cpp vm_6502/profiler.cpp vm_6502/compiler.cpp vm_6502/trace.cpp
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "block.hpp"
+#include "jit.hpp"
+#include "profiler.hpp"
+#include "trace.hpp"
+
+struct Program
+{
+	const char* name;
+	word start;
+	std::vector<byte> code;
+};
+
+static const Program s_Programs[] =
+{
+	// arithmetic / zero page mix, JMP back to the top
+	{ "alu", 0x0200, {
+		CPU::INS_LDA_IM, 0x10,
+		CPU::INS_ADC_ZP, 0x20,
+		CPU::INS_SDA_ZP, 0x21,
+		CPU::INS_AND_IM, 0x7F,
+		CPU::INS_ORA_ZP, 0x22,
+		CPU::INS_EOR_ZP, 0x23,
+		CPU::INS_INX_IM,
+		CPU::INS_CMP_ZP, 0x24,
+		CPU::INS_DEC_ZP, 0x25,
+		CPU::INS_INC_ABS, 0x03, 0x00,
+		CPU::INS_LDY_ZP, 0x26,
+		CPU::INS_ADC_ABSX, 0x03, 0x00,
+		CPU::INS_JMP_ABS, 0x02, 0x00,
+	} },
+	// counted inner loop, taken and not-taken branches
+	{ "branch", 0x0200, {
+		CPU::INS_INY_IM,
+		CPU::INS_CPY_IM, 0x00,
+		CPU::INS_BEQ_RL, 0x03,
+		CPU::INS_JMP_ABS, 0x02, 0x00,
+		CPU::INS_INX_IM,
+		CPU::INS_CPX_IM, 0x80,
+		CPU::INS_BNE_RL, 0x00,
+		CPU::INS_JMP_ABS, 0x02, 0x00,
+	} },
+	// the pairs dispatch::FUSIONS decodes as one, as HELLO_WORLD has them
+	{ "pairs", 0x0200, {
+		CPU::INS_LDA_IM, 'H',
+		CPU::INS_SDA_ZP, 0x00,
+		CPU::INS_LDA_IM, 'i',
+		CPU::INS_SDA_ZP, 0x01,
+		CPU::INS_INY_IM,
+		CPU::INS_LDX_ZPY, 0x00,
+		CPU::INS_PHA_IM,
+		CPU::INS_LDA_IM, 0x00,
+		CPU::INS_PLA_IM,
+		CPU::INS_CPY_IM, 0x00,
+		CPU::INS_BEQ_RL, 0x00,
+		CPU::INS_JMP_ABS, 0x02, 0x00,
+	} },
+	// software interrupt round trips through the ISR table
+	{ "isr", 0x0200, {
+		CPU::INS_LDA_IM, 0x00,
+		CPU::INS_BRK_IM,
+		CPU::INS_NOP_IM,
+		CPU::INS_PHA_IM,
+		CPU::INS_PLA_IM,
+		CPU::INS_JMP_ABS, 0x02, 0x00,
+	} },
+};
+
+static void Load(const Program& program, CPU& cpu, Memory& ram)
+{
+	cpu.Reset(ram);
+	for (size_t i = 0; i < program.code.size(); i++)
+	{
+		ram[program.start + i] = program.code[i];
+	}
+
+	// ISR 0: LDA #$00; RTI
+	ram[0xF100] = CPU::INS_LDA_IM;
+	ram[0xF101] = 0x00;
+	ram[0xF102] = CPU::INS_RTI_IM;
+	ram[0xFDFC] = 0xF1;
+	ram[0xFDFD] = 0x00;
+
+	cpu.PC = program.start;
+	cpu.SP = 0x8000;
+}
+
+// ExecuteSwitch() only stops when the budget hits zero exactly and the others
+// where a block ends, so the budget is measured by stepping the program for
+// the requested number of instructions and on to the end of that block.
+// Counts the instructions stepped into `instructions`.
+static u32 Budget(const Program& program, u32& instructions)
+{
+	static Memory ram;
+	CPU cpu;
+	Load(program, cpu, ram);
+
+	u32 cycles = 0;
+	for (u32 i = 0; ; i++)
+	{
+		byte opcode = ram.Read(cpu.PC);
+		cycles += cpu.Step(ram);
+		if (i + 1 >= instructions && dispatch::s_Decoding[opcode].endsBlock)
+		{
+			instructions = i + 1;
+			return cycles;
+		}
+	}
+}
+
+using Engine = void (*)(CPU&, u32, Memory&);
+
+static BlockCache s_Cache, s_Unfused;
+static Jit s_Jit;
+static Profiler s_Profiler;
+static TraceRecorder* s_Recorder;
+
+static const char* const TRACE_PATH = "bench_dispatch.trace";
+
+static double Run(const Program& program, Engine engine, u32 budget, CPU& cpu, Memory& ram)
+{
+	Load(program, cpu, ram);
+
+	auto begin = std::chrono::steady_clock::now();
+	engine(cpu, budget, ram);
+	auto end = std::chrono::steady_clock::now();
+
+	return std::chrono::duration<double>(end - begin).count();
+}
+
+int main()
+{
+	constexpr u32 INSTRUCTIONS = 20'000'000;
+
+	struct { const char* name; Engine engine; } engines[] =
+	{
+		{ "switch", [](CPU& cpu, u32 cycles, Memory& ram) { cpu.ExecuteSwitch(cycles, ram); } },
+		{ "table", [](CPU& cpu, u32 cycles, Memory& ram) { cpu.ExecuteTable(cycles, ram); } },
+		{ "threaded", [](CPU& cpu, u32 cycles, Memory& ram) { cpu.ExecuteThreaded(cycles, ram); } },
+		{ "unfused", [](CPU& cpu, u32 cycles, Memory& ram) { s_Unfused.Execute(cpu, cycles, ram); } },
+		{ "blocks", [](CPU& cpu, u32 cycles, Memory& ram) { s_Cache.Execute(cpu, cycles, ram); } },
+		{ "jit", [](CPU& cpu, u32 cycles, Memory& ram) { s_Jit.Execute(cpu, cycles, ram); } },
+		{ "profiled", [](CPU& cpu, u32 cycles, Memory& ram) { s_Profiler.Execute(cpu, cycles, ram); } },
+		{ "traced", [](CPU& cpu, u32 cycles, Memory& ram) { s_Recorder->Execute(cpu, cycles, ram); } },
+	};
+
+	TraceRecorder recorder(TRACE_PATH);
+	s_Recorder = &recorder;
+	s_Unfused.m_Fuse = false;
+
+	static Memory ram;
+	static byte reference[Memory::MAX_MEM], current[Memory::MAX_MEM];
+
+	std::printf("%-8s %-9s %10s %12s %10s\n", "program", "engine", "seconds", "MIPS", "MHz");
+	for (const Program& program : s_Programs)
+	{
+		u32 instructions = INSTRUCTIONS;
+		u32 budget = Budget(program, instructions);
+
+		s_Cache.m_Dispatched = s_Unfused.m_Dispatched = 0;
+		CPU first{};
+		bool haveFirst = false;
+		for (const auto& e : engines)
+		{
+			CPU cpu;
+			double seconds = Run(program, e.engine, budget, cpu, ram);
+
+			std::printf("%-8s %-9s %10.3f %12.1f %10.1f\n", program.name, e.name, seconds,
+				instructions / seconds / 1e6, budget / seconds / 1e6);
+
+			if (!haveFirst)
+			{
+				first = cpu;
+				ram.ReadBlock(0, reference, Memory::MAX_MEM);
+				haveFirst = true;
+				continue;
+			}
+
+			ram.ReadBlock(0, current, Memory::MAX_MEM);
+			if (cpu.PC != first.PC || cpu.A != first.A || cpu.X != first.X || cpu.Y != first.Y
+				|| std::memcmp(reference, current, Memory::MAX_MEM) != 0)
+			{
+				std::printf("  !! %s diverged from %s\n", e.name, engines[0].name);
+				return 1;
+			}
+		}
+		std::printf("%-8s dispatches per instruction: %.2f unfused, %.2f fused\n", program.name,
+			(double)s_Unfused.m_Dispatched / instructions, (double)s_Cache.m_Dispatched / instructions);
+	}
+
+	std::printf("\ntrace: %.2f bytes per instruction\n", (double)recorder.m_Bytes / recorder.m_Instructions);
+	std::remove(TRACE_PATH);
+	return 0;
+}
@@ -0,0 +1,724 @@
+// Functional test gate: boots a self-checking test program on every engine,
+// runs it at full speed to its success trap and checks the result against
+// CPU::Step, the one-instruction-at-a-time reference.
+//
+// The program works like Klaus Dormann's 6502 functional test: each check
+// branches over a `JMP *` when it passes, so a failing check halts on its own
+// trap and a passing run ends on the success trap. Without IMAGE the checks
+// below are assembled and run, written for this CPU's dialect (big-endian
+// words, two-byte stack slots, BRK vectored by A) since the standard binaries
+// assume a stock 6502. IMAGE is any file Load() takes, e.g.
+// 6502_functional_test.bin with --start 0x0400 and --success set to the
+// success trap of that build.
+//
+// The checks cover the implemented instructions and addressing modes, decimal
+// ADC / SBC included, except where this CPU knowingly differs from a 6502,
+// which they leave alone:
+// LDA / LDX / LDY from memory and INX / INY do not set Z and N, CMP / CPX /
+// CPY take N from operand - register, DEC abs,X ignores X, zero page,X does
+// not wrap, BMI is not implemented and RTS returns to the JSR itself.
+//
+// Each engine reports how long its run took (as MIPS and emulated MHz over
+// the reference's instruction and cycle counts) and whether it ended on the
+// success trap in the reference's state. When it did not, the budget at which
+// it first disagrees with the reference is found by bisection and the block
+// and registers or memory that differ are printed. Exits with 1 when any
+// engine fails.
+//
+//   bench_functional [--start ADDR] [--success ADDR] [--cycles N] [IMAGE]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include "batch.hpp"
+#include "block.hpp"
+#include "compiler.hpp"
+#include "disassembler.hpp"
+#include "jit.hpp"
+#include "loader.hpp"
+
+struct Test
+{
+	std::shared_ptr<const Memory> image;
+	std::optional<word> start;				// PC after reset, Vectors::STARTUP when unset
+	word success = 0;						// address of the success trap
+	std::map<word, std::string> checks;		// trap address -> what failed, if known
+	u64 limit = 1'000'000'000;				// cycles before giving up on reaching a trap
+};
+
+// -- the built-in test ------------------------------------------------------
+
+// Rounds of all checks, so the run is long enough to time. A multiple of 256.
+static constexpr u32 ROUNDS = 200 * 256;
+
+struct Source
+{
+	std::string text;
+	std::string check;							// what the following traps test
+	std::vector<std::string> descriptions;		// by trap number
+
+	void operator()(const std::string& line) { text += "\t\t" + line + "\n"; }
+
+	// traps unless `branch` is taken
+	void Expect(const char* branch)
+	{
+		text += "\t\t" + std::string(branch) + " * + 5\n";
+		Trap();
+	}
+
+	// traps if `branch` is taken
+	void Refuse(const char* branch)
+	{
+		text += "\t\t" + std::string(branch) + " * + 5\n\t\tJMP * + 6\n";
+		Trap();
+	}
+
+	void Trap()
+	{
+		text += "fail_" + std::to_string(descriptions.size()) + ":\tJMP *\n";
+		descriptions.push_back(check);
+	}
+
+	// CMP, CPX or CPY against `value`; traps unless equal
+	void Equal(const char* compare, byte value)
+	{
+		(*this)(std::string(compare) + " #" + std::to_string(value));
+		Expect("BEQ");
+	}
+};
+
+static Source Checks()
+{
+	Source s;
+	s.text = R"(
+		.org $FFFC
+		JMP start
+
+		.org $FDFC + $10 * 2
+		.word isr16
+
+		.org $F000
+isr16:	LDA #$A5				; BRK with A = $10
+		SDA $50
+		RTI
+
+		.org $0400
+start:	LDA #0
+		SDA $E0
+		LDA #)" + std::to_string(ROUNDS / 256) + R"(
+		SDA $E1
+round:
+)";
+
+	s.check = "LDA # sets Z and N";
+	s("LDA #$00"); s.Expect("BEQ"); s.Expect("BPL");
+	s("LDA #$80"); s.Expect("BNE"); s.Refuse("BPL");
+
+	s.check = "LDX # sets Z and N from X";
+	s("LDX #$00"); s.Expect("BEQ"); s.Expect("BPL");
+	s("LDA #$00"); s("LDX #$80"); s.Expect("BNE"); s.Refuse("BPL");
+	s.Equal("CPX", 0x80);
+
+	s.check = "LDY # sets Z and N from Y";
+	s("LDA #$80"); s("LDY #$00"); s.Expect("BEQ"); s.Expect("BPL");
+	s("LDA #$00"); s("LDY #$FF"); s.Expect("BNE"); s.Refuse("BPL");
+	s.Equal("CPY", 0xFF);
+
+	s.check = "EOR # keeps the result in A";
+	s("LDA #$5A"); s("EOR #$FF"); s.Expect("BNE"); s.Refuse("BPL");
+	s.Equal("CMP", 0xA5);
+	s("LDA #$5A"); s("EOR #$5A"); s.Expect("BEQ"); s.Expect("BPL");
+	s.Equal("CMP", 0x00);
+
+	s.check = "AND # and ORA #";
+	s("LDA #$F0"); s("AND #$3C"); s.Expect("BNE"); s.Expect("BPL");
+	s.Equal("CMP", 0x30);
+	s("LDA #$0F"); s("ORA #$80"); s.Refuse("BPL");
+	s.Equal("CMP", 0x8F);
+	s("LDA #$F0"); s("AND #$0F"); s.Expect("BEQ");
+
+	s.check = "ADC sets V on signed overflow";
+	s("CLC"); s("LDA #$50"); s("ADC #$50");
+	s.Expect("BVS"); s.Expect("BCC"); s.Refuse("BPL");
+	s.Equal("CMP", 0xA0);
+	s("CLC"); s("LDA #$D0"); s("ADC #$90");
+	s.Expect("BVS"); s.Expect("BCS"); s.Expect("BPL");
+	s.Equal("CMP", 0x60);
+	s("CLC"); s("LDA #$7F"); s("ADC #$01");
+	s.Expect("BVS"); s.Refuse("BPL"); s.Expect("BCC");
+
+	s.check = "ADC clears V without signed overflow";
+	s("CLC"); s("LDA #$01"); s("ADC #$01");
+	s.Expect("BVC"); s.Expect("BCC"); s.Expect("BNE");
+	s.Equal("CMP", 0x02);
+	s("CLC"); s("LDA #$FF"); s("ADC #$01");
+	s.Expect("BVC"); s.Expect("BCS"); s.Expect("BEQ");
+
+	s.check = "ADC adds the carry in";
+	s("LDA #$01"); s("CMP #$01");			// sets C
+	s("LDA #$FF"); s("ADC #$00");
+	s.Expect("BCS"); s.Expect("BEQ"); s.Expect("BVC");
+	s("LDA #$10"); s("CMP #$01");
+	s("LDA #$10"); s("ADC #$10");
+	s.Equal("CMP", 0x21);
+
+	s.check = "SBC subtracts the borrow and sets C and V";
+	s("CMP #$00");						// sets C: no borrow
+	s("LDA #$50"); s("SBC #$10");
+	s.Expect("BCS"); s.Expect("BVC"); s.Expect("BPL");
+	s.Equal("CMP", 0x40);
+	s("LDA #$50"); s("SBC #$B0");
+	s.Expect("BCC"); s.Expect("BVS"); s.Refuse("BPL");
+	s.Equal("CMP", 0xA0);
+	s("CLC"); s("LDA #$10"); s("SBC #$0F");
+	s.Expect("BCS"); s.Expect("BEQ");
+
+	s.check = "ADC and SBC in decimal mode";
+	s("SED");
+	s("CLC"); s("LDA #$19"); s("ADC #$28"); s.Expect("BCC");
+	s.Equal("CMP", 0x47);
+	s("CLC"); s("LDA #$58"); s("ADC #$46"); s.Expect("BCS");
+	s.Equal("CMP", 0x04);
+	s("CMP #$00"); s("LDA #$46"); s("SBC #$12"); s.Expect("BCS");
+	s.Equal("CMP", 0x34);
+	s("CMP #$00"); s("LDA #$12"); s("SBC #$21"); s.Expect("BCC");
+	s.Equal("CMP", 0x91);
+	s("CLD");
+	s("CLC"); s("LDA #$19"); s("ADC #$28"); s.Equal("CMP", 0x41);
+
+	s.check = "CLV and CLC";
+	s("CLC"); s("LDA #$50"); s("ADC #$50"); s("CLV"); s.Expect("BVC");
+	s("LDA #$01"); s("CMP #$01"); s("CLC"); s.Expect("BCC");
+
+	s.check = "CMP, CPX and CPY set C and Z";
+	s("LDA #$40"); s("CMP #$41"); s.Expect("BCC"); s.Expect("BNE");
+	s("CMP #$40"); s.Expect("BCS"); s.Expect("BEQ");
+	s("CMP #$3F"); s.Expect("BCS"); s.Refuse("BEQ");
+	s("LDX #$10"); s("CPX #$10"); s.Expect("BCS"); s.Expect("BEQ");
+	s("CPX #$11"); s.Expect("BCC");
+	s("LDY #$10"); s("CPY #$0F"); s.Expect("BCS"); s.Expect("BNE");
+
+	s.check = "INC and DEC";
+	s("LDA #$FF"); s("SDA $30"); s("INC $30"); s.Expect("BEQ");
+	s("LDA $30"); s.Equal("CMP", 0x00);
+	s("DEC $30"); s.Refuse("BPL"); s.Expect("BNE");
+	s("LDA #$7F"); s("SDA $0300"); s("INC $0300"); s.Refuse("BPL");
+	s("DEC $0300"); s.Expect("BPL");
+	s("LDX #$01"); s("LDA #$00"); s("SDA $31"); s("INC $30,X"); s.Expect("BNE");
+	s("DEC $30,X"); s.Expect("BEQ");
+	s("LDA #$02"); s("SDA $0301"); s("INC $0300,X"); s.Expect("BNE");
+	s("LDA #$03"); s("CMP $0301"); s.Expect("BEQ");
+
+	s.check = "INX, INY, DEX and DEY";
+	s("LDX #$01"); s("DEX"); s.Expect("BEQ"); s("DEX"); s.Refuse("BPL");
+	s.Equal("CPX", 0xFF);
+	s("INX"); s("INX"); s.Equal("CPX", 0x01);
+	s("LDY #$01"); s("DEY"); s.Expect("BEQ"); s("DEY"); s.Refuse("BPL");
+	s("INY"); s("INY"); s.Equal("CPY", 0x01);
+
+	s.check = "stores in every addressing mode";
+	s("LDA #$11"); s("SDA $40");
+	s("LDX #$02"); s("LDA #$22"); s("SDA $40,X");
+	s("LDA #$33"); s("SDA $0341");
+	s("LDA #$44"); s("SDA $0340,X");
+	s("LDY #$03"); s("LDA #$55"); s("SDA $0340,Y");
+	s("LDX #$66"); s("SDX $44");
+	s("LDY #$01"); s("LDX #$77"); s("SDX $44,Y");
+	s("LDX #$88"); s("SDX $0344");
+
+	s.check = "loads in every addressing mode";
+	s("LDA $40"); s.Equal("CMP", 0x11);
+	s("LDX #$02"); s("LDA $40,X"); s.Equal("CMP", 0x22);
+	s("LDX $44"); s.Equal("CPX", 0x66);
+	s("LDY #$01"); s("LDX $44,Y"); s.Equal("CPX", 0x77);
+	s("LDY $44"); s.Equal("CPY", 0x66);
+	s("LDX #$01"); s("LDY $44,X"); s.Equal("CPY", 0x77);
+
+	s.check = "ALU operands in every addressing mode";
+	s("LDX #$02"); s("LDY #$03");
+	s("LDA #$FF"); s("AND $0341"); s.Equal("CMP", 0x33);
+	s("LDA #$FF"); s("AND $0340,X"); s.Equal("CMP", 0x44);
+	s("LDA #$FF"); s("AND $0340,Y"); s.Equal("CMP", 0x55);
+	s("LDA #$FF"); s("AND $40"); s.Equal("CMP", 0x11);
+	s("LDA #$FF"); s("AND $40,X"); s.Equal("CMP", 0x22);
+	s("LDA #$00"); s("ORA $0341"); s.Equal("CMP", 0x33);
+	s("LDA #$00"); s("ORA $0340,X"); s.Equal("CMP", 0x44);
+	s("LDA #$00"); s("ORA $0340,Y"); s.Equal("CMP", 0x55);
+	s("LDA #$00"); s("ORA $40"); s.Equal("CMP", 0x11);
+	s("LDA #$00"); s("ORA $40,X"); s.Equal("CMP", 0x22);
+	s("LDA #$FF"); s("EOR $0341"); s.Equal("CMP", 0xCC);
+	s("LDA #$FF"); s("EOR $0340,X"); s.Equal("CMP", 0xBB);
+	s("LDA #$FF"); s("EOR $0340,Y"); s.Equal("CMP", 0xAA);
+	s("LDA #$FF"); s("EOR $40"); s.Equal("CMP", 0xEE);
+	s("LDA #$FF"); s("EOR $40,X"); s.Equal("CMP", 0xDD);
+	s("CLC"); s("LDA #$01"); s("ADC $0341"); s.Equal("CMP", 0x34);
+	s("CLC"); s("LDA #$01"); s("ADC $0340,X"); s.Equal("CMP", 0x45);
+	s("CLC"); s("LDA #$01"); s("ADC $0340,Y"); s.Equal("CMP", 0x56);
+	s("CLC"); s("LDA #$01"); s("ADC $40"); s.Equal("CMP", 0x12);
+	s("CLC"); s("LDA #$01"); s("ADC $40,X"); s.Equal("CMP", 0x23);
+	s("CMP #$00"); s("LDA #$40"); s("SBC $0341"); s.Equal("CMP", 0x0D);
+	s("CMP #$00"); s("LDA #$50"); s("SBC $0340,X"); s.Equal("CMP", 0x0C);
+	s("CMP #$00"); s("LDA #$60"); s("SBC $0340,Y"); s.Equal("CMP", 0x0B);
+	s("CMP #$00"); s("LDA #$20"); s("SBC $40"); s.Equal("CMP", 0x0F);
+	s("CMP #$00"); s("LDA #$30"); s("SBC $40,X"); s.Equal("CMP", 0x0E);
+	s("LDA #$33"); s("CMP $0341"); s.Expect("BEQ");
+	s("LDA #$44"); s("CMP $0340,X"); s.Expect("BEQ");
+	s("LDA #$55"); s("CMP $0340,Y"); s.Expect("BEQ");
+	s("LDA #$11"); s("CMP $40"); s.Expect("BEQ");
+	s("LDA #$22"); s("CMP $40,X"); s.Expect("BEQ");
+	s("LDX #$66"); s("CPX $44"); s.Expect("BEQ");
+	s("LDX #$88"); s("CPX $0344"); s.Expect("BEQ");
+	s("LDY #$66"); s("CPY $44"); s.Expect("BEQ");
+	s("LDY #$88"); s("CPY $0344"); s.Expect("BEQ");
+
+	s.check = "branches that are not taken";
+	s("LDA #$00"); s.Refuse("BNE"); s.Expect("BPL");
+	s("LDA #$80"); s.Refuse("BEQ"); s.Refuse("BPL");
+	s("CLC"); s.Refuse("BCS");
+	s("CMP #$00"); s.Refuse("BCC");
+	s("CLV"); s.Refuse("BVS");
+	s("CLC"); s("LDA #$50"); s("ADC #$50"); s.Refuse("BVC");
+
+	s.check = "PHA and PLA";
+	s("LDA #$5C"); s("PHA"); s("LDA #$00"); s("PLA");
+	s.Equal("CMP", 0x5C);
+
+	s.check = "PHP and PLP";
+	s("LDA #$01"); s("CMP #$01"); s("PHP"); s("CLC"); s("PLP"); s.Expect("BCS");
+	s("CLC"); s("PHP"); s("CMP #$00"); s("PLP"); s.Expect("BCC");
+
+	s.check = "SEI and CLI";
+	s("SEI"); s("CLI"); s("NOP");
+
+	s.check = "BRK and RTI through the ISR table";
+	s("LDA #$00"); s("SDA $50");
+	s("LDA #$10"); s("BRK");
+	s.Equal("CMP", 0xA5);
+	s("LDA $50"); s.Equal("CMP", 0xA5);
+
+	s.text += R"(
+		DEC $E0
+		BEQ * + 5
+		JMP round
+		DEC $E1
+		BEQ * + 5
+		JMP round
+success:
+		JMP success
+)";
+	return s;
+}
+
+static Test BuiltIn()
+{
+	Source source = Checks();
+	Assembly assembly = compile(source.text);
+	if (!assembly.Ok())
+	{
+		for (const std::string& error : assembly.errors)
+		{
+			std::fprintf(stderr, "%s\n", error.c_str());
+		}
+		std::exit(1);
+	}
+
+	auto image = std::make_shared<Memory>();
+	assembly.Load(*image);
+
+	Test test;
+	test.image = image;
+	test.success = assembly.Find("success")->value;
+	for (size_t i = 0; i < source.descriptions.size(); i++)
+	{
+		test.checks[assembly.Find("fail_" + std::to_string(i))->value] = source.descriptions[i];
+	}
+	return test;
+}
+
+// -- engines ----------------------------------------------------------------
+
+using Execute = std::function<ExecResult(CPU&, u64, Memory&)>;
+
+struct Engine
+{
+	const char* name;
+	bool blockEnds;					// stops where a block ends, like CPU::Execute;
+									// otherwise only when the budget is used up exactly
+	std::function<Execute()> make;	// a fresh instance, with nothing cached
+};
+
+static const Engine s_Engines[] =
+{
+	// ExecuteSwitch() counts the budget in a u32 that wraps unless an
+	// instruction ends exactly on zero, so it is only given budgets that
+	// the reference ended an instruction on, and it reports them as used
+	{ "switch", false, [] { return Execute([](CPU& cpu, u64 cycles, Memory& ram)
+	{
+		cpu.ExecuteSwitch((u32)std::min<u64>(cycles, 1u << 30), ram);
+		return ExecResult{ cycles, StopReason::Budget };
+	}); } },
+	{ "table", true, [] { return Execute([](CPU& cpu, u64 cycles, Memory& ram) { return cpu.ExecuteTable(cycles, ram); }); } },
+	{ "threaded", true, [] { return Execute([](CPU& cpu, u64 cycles, Memory& ram) { return cpu.ExecuteThreaded(cycles, ram); }); } },
+	{ "blocks", true, []
+	{
+		auto cache = std::make_shared<BlockCache>();
+		return Execute([cache](CPU& cpu, u64 cycles, Memory& ram) { return cache->Execute(cpu, cycles, ram); });
+	} },
+	{ "jit", true, []
+	{
+		auto jit = std::make_shared<Jit>();
+		return Execute([jit](CPU& cpu, u64 cycles, Memory& ram) { return jit->Execute(cpu, cycles, ram); });
+	} },
+	// one lane, forked in and out of the batch's own memory
+	{ "batch", true, []
+	{
+		auto batch = std::make_shared<CpuBatch>(1);
+		return Execute([batch](CPU& cpu, u64 cycles, Memory& ram)
+		{
+			batch->Ram(0) = ram;
+			batch->Load(0, cpu);
+			batch->Execute(cycles);
+			cpu = batch->Get(0);
+			ram = batch->Ram(0);
+			return batch->Result(0);
+		});
+	} },
+};
+
+// -- running ----------------------------------------------------------------
+
+static bool OnTrap(const CPU& cpu, const Memory& ram)
+{
+	return ram.Read(cpu.PC) == CPU::INS_JMP_ABS
+		&& (word)(ram.Read(cpu.PC + 1) << 8 | ram.Read(cpu.PC + 2)) == cpu.PC;
+}
+
+static void Boot(const Test& test, CPU& cpu, Memory& ram)
+{
+	cpu.Reset(ram, *test.image);
+	if (test.start)
+	{
+		cpu.PC = *test.start;
+	}
+}
+
+struct Outcome
+{
+	u64 cycles = 0;
+	u64 instructions = 0;		// counted by the reference only
+	bool trapped = false;
+	std::optional<byte> invalid;
+	bool idle = false;
+};
+
+// CPU::Step from boot until `until` cycles are used, on to the end of that
+// block with `blockEnds`; or to a trap or an invalid opcode.
+static Outcome Reference(const Test& test, CPU& cpu, Memory& ram, u64 until, bool blockEnds)
+{
+	Boot(test, cpu, ram);
+	Outcome outcome;
+	bool blockEnded = true;
+	while (outcome.cycles < until || (blockEnds && !blockEnded))
+	{
+		word pc = cpu.PC;
+		byte opcode = ram.Read(pc);
+		outcome.cycles += cpu.Step(ram);
+		outcome.instructions++;
+		blockEnded = dispatch::s_Traits[opcode].endsBlock;
+
+		dispatch::Ending ending = dispatch::EndOf(opcode, pc, cpu.PC);
+		if (ending == dispatch::Ending::Halt)
+		{
+			outcome.trapped = true;
+			break;
+		}
+		if (ending == dispatch::Ending::Invalid)
+		{
+			outcome.invalid = opcode;
+			break;
+		}
+	}
+	return outcome;
+}
+
+// Runs `execute` from boot to a trap, an invalid opcode, an idle loop or
+// `until` cycles, calling it with at most `chunk` cycles at a time.
+static Outcome Run(const Test& test, const Execute& execute, CPU& cpu, Memory& ram, u64 until, u64 chunk)
+{
+	Boot(test, cpu, ram);
+	Outcome outcome;
+	while (outcome.cycles < until)
+	{
+		ExecResult result = execute(cpu, std::min(chunk, until - outcome.cycles), ram);
+		outcome.cycles += result.cycles;
+		if (result.reason == StopReason::Halt || OnTrap(cpu, ram))
+		{
+			outcome.trapped = true;
+			break;
+		}
+		if (result.reason == StopReason::InvalidOpcode)
+		{
+			outcome.invalid = cpu.X;
+			break;
+		}
+		if (result.reason == StopReason::Idle)
+		{
+			outcome.idle = true;
+			break;
+		}
+	}
+	return outcome;
+}
+
+// What differs between `cpu` / `ram` and the reference's; empty when nothing.
+static std::string Difference(const CPU& cpu, const Memory& ram, const CPU& ref, const Memory& refRam)
+{
+	std::string text;
+	char buffer[64];
+	auto compare = [&](const char* name, u32 value, u32 expected, int digits)
+	{
+		if (value != expected)
+		{
+			std::snprintf(buffer, sizeof(buffer), " %s=$%0*X (reference $%0*X)", name, digits, value, digits, expected);
+			text += buffer;
+		}
+	};
+	compare("PC", cpu.PC, ref.PC, 4);
+	compare("SP", cpu.SP, ref.SP, 4);
+	compare("A", cpu.A, ref.A, 2);
+	compare("X", cpu.X, ref.X, 2);
+	compare("Y", cpu.Y, ref.Y, 2);
+	compare("C", cpu.C, ref.C, 1);
+	compare("Z", cpu.Z(), ref.Z(), 1);
+	compare("N", cpu.N(), ref.N(), 1);
+	compare("V", cpu.V, ref.V, 1);
+	compare("I", cpu.I, ref.I, 1);
+	compare("D", cpu.D, ref.D, 1);
+	compare("B", cpu.B, ref.B, 1);
+
+	static byte mine[Memory::MAX_MEM], theirs[Memory::MAX_MEM];
+	ram.ReadBlock(0, mine, Memory::MAX_MEM);
+	refRam.ReadBlock(0, theirs, Memory::MAX_MEM);
+	for (u32 address = 0; address < Memory::MAX_MEM; address++)
+	{
+		if (mine[address] != theirs[address])
+		{
+			std::snprintf(buffer, sizeof(buffer), " [$%04X]=$%02X (reference $%02X)", address, mine[address], theirs[address]);
+			text += buffer;
+			break;
+		}
+	}
+	return text;
+}
+
+// Where a run that ended differently from the reference first disagrees
+// with it: the smallest budget at which they differ, by bisection between 0
+// and `disagrees`.
+static std::string Divergence(const Test& test, const Engine& engine, u64 disagrees)
+{
+	static Memory ram, refRam;
+	CPU cpu, ref;
+	auto check = [&](u64 budget, Outcome& refOutcome)
+	{
+		refOutcome = Reference(test, ref, refRam, budget, engine.blockEnds);
+		u64 until = engine.blockEnds ? budget : refOutcome.cycles;
+		Execute execute = engine.make();
+		Outcome outcome = Run(test, execute, cpu, ram, until, until);
+		std::string text = Difference(cpu, ram, ref, refRam);
+		if (text.empty() && engine.blockEnds && !outcome.trapped && outcome.cycles != refOutcome.cycles)
+		{
+			text = " used " + std::to_string(outcome.cycles) + " cycles (reference "
+				+ std::to_string(refOutcome.cycles) + ")";
+		}
+		return text;
+	};
+
+	Outcome refOutcome;
+	std::string text = check(disagrees, refOutcome);
+	if (text.empty())
+	{
+		return "agrees with the reference but did not reach the same end";
+	}
+
+	u64 agrees = 0;
+	word from = test.start.value_or(0xFFFC);
+	while (disagrees - agrees > 1)
+	{
+		u64 middle = agrees + (disagrees - agrees) / 2;
+		std::string difference = check(middle, refOutcome);
+		if (difference.empty())
+		{
+			agrees = middle;
+			from = ref.PC;
+		}
+		else
+		{
+			disagrees = middle;
+			text = difference;
+		}
+	}
+
+	check(disagrees, refOutcome);
+	char buffer[128];
+	std::snprintf(buffer, sizeof(buffer), "diverged running from $%04X (%s), %llu instructions in:", from,
+		Disassemble(refRam, from).text.c_str(), (unsigned long long)refOutcome.instructions);
+	return buffer + text;
+}
+
+static std::string Describe(const Test& test, const Outcome& outcome, const CPU& cpu)
+{
+	char buffer[128];
+	if (outcome.invalid)
+	{
+		std::snprintf(buffer, sizeof(buffer), "invalid opcode $%02X", *outcome.invalid);
+		return buffer;
+	}
+	if (outcome.idle)
+	{
+		std::snprintf(buffer, sizeof(buffer), "idle at $%04X", cpu.PC);
+		return buffer;
+	}
+	if (!outcome.trapped)
+	{
+		return "no trap within " + std::to_string(test.limit) + " cycles";
+	}
+	if (cpu.PC == test.success)
+	{
+		return "success";
+	}
+	std::snprintf(buffer, sizeof(buffer), "trapped at $%04X", cpu.PC);
+	auto check = test.checks.find(cpu.PC);
+	return check == test.checks.end() ? buffer : buffer + (": " + check->second);
+}
+
+static std::optional<u64> Number(const char* text)
+{
+	char* end;
+	unsigned long long value = std::strtoull(text, &end, 0);
+	return *text && !*end ? std::optional<u64>(value) : std::nullopt;
+}
+
+int main(int argc, char** argv)
+{
+	const char* path = nullptr;
+	std::optional<u64> start, success, limit;
+	bool usage = false;
+	for (int i = 1; i < argc && !usage; i++)
+	{
+		std::string_view arg = argv[i];
+		if (arg == "--start" && i + 1 < argc)
+		{
+			usage = !(start = Number(argv[++i])) || *start > 0xFFFF;
+		}
+		else if (arg == "--success" && i + 1 < argc)
+		{
+			usage = !(success = Number(argv[++i])) || *success > 0xFFFF;
+		}
+		else if (arg == "--cycles" && i + 1 < argc)
+		{
+			usage = !(limit = Number(argv[++i]));
+		}
+		else if (!path && !arg.starts_with("--"))
+		{
+			path = argv[i];
+		}
+		else
+		{
+			usage = true;
+		}
+	}
+	if (usage || (path && !success))
+	{
+		std::fprintf(stderr, "usage: %s [--start ADDR] [--success ADDR] [--cycles N] [IMAGE]\n"
+			"       --success is required with IMAGE\n", argv[0]);
+		return 1;
+	}
+
+	Test test;
+	if (path)
+	{
+		Image image = Load(path);
+		if (!image.Ok())
+		{
+			std::fprintf(stderr, "%s\n", image.error.c_str());
+			return 1;
+		}
+		test.image = image.memory;
+	}
+	else
+	{
+		test = BuiltIn();
+	}
+	if (start)
+	{
+		test.start = (word)*start;
+	}
+	if (success)
+	{
+		test.success = (word)*success;
+	}
+	if (limit)
+	{
+		test.limit = *limit;
+	}
+
+	static Memory refRam;
+	CPU ref;
+	auto begin = std::chrono::steady_clock::now();
+	Outcome reference = Reference(test, ref, refRam, test.limit, false);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	std::printf("reference: %s after %llu instructions, %llu cycles (%.1f MIPS)\n",
+		Describe(test, reference, ref).c_str(), (unsigned long long)reference.instructions,
+		(unsigned long long)reference.cycles, reference.instructions / seconds / 1e6);
+
+	bool passed = reference.trapped && ref.PC == test.success;
+	bool failed = !passed;
+
+	std::printf("%-9s %9s %10s %10s   %s\n", "engine", "seconds", "MIPS", "MHz", "result");
+	for (const Engine& engine : s_Engines)
+	{
+		static Memory ram;
+		CPU cpu;
+		Execute execute = engine.make();
+
+		begin = std::chrono::steady_clock::now();
+		u64 until = engine.blockEnds ? test.limit : reference.cycles;
+		Outcome outcome = Run(test, execute, cpu, ram, until, engine.blockEnds ? 1u << 16 : until);
+		seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+		std::string result = Describe(test, outcome, cpu);
+		bool same = outcome.trapped == reference.trapped && outcome.invalid == reference.invalid
+			&& outcome.idle == reference.idle;
+		if (same)
+		{
+			std::string difference = Difference(cpu, ram, ref, refRam);
+			same = difference.empty();
+			result += same ? "" : ", but" + difference;
+		}
+		if (!same)
+		{
+			result += "\n          " + Divergence(test, engine, outcome.cycles);
+		}
+		bool ok = same && passed;
+		failed |= !ok;
+
+		if (ok)
+		{
+			std::printf("%-9s %9.3f %10.1f %10.1f   %s\n", engine.name, seconds,
+				reference.instructions / seconds / 1e6, reference.cycles / seconds / 1e6, result.c_str());
+		}
+		else
+		{
+			std::printf("%-9s %9.3f %10s %10s   %s\n", engine.name, seconds, "-", "-", result.c_str());
+		}
+		std::fflush(stdout);
+	}
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,245 @@
+// Checks and times bank switching through Mmu.
+//
+// The check boots a program that switches a window through 255 banks spread
+// over an arena of Mmu::MAX_BANKS (just under 256 MiB), marks each one,
+// reads the marks back through another window, and then runs code from a
+// third window switched between two banks holding different code at the same
+// address. It must reach its success trap on every engine, leave the marks in
+// the arena and none in the RAM under the windows.
+//
+// The timings compare the same loads and stores to a window showing RAM and
+// one showing a bank, which should run at the same speed, and measure a
+// switch, done by the guest through the registers and by the host through
+// Mmu::Select. Exits with 1 when the check fails on any engine.
+//
+//   cmake --build build --target bench_mmu && build/bench_mmu
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include "block.hpp"
+#include "compiler.hpp"
+#include "jit.hpp"
+#include "mmu.hpp"
+
+static constexpr u32 MMU_ADDRESS = 0xF000;
+static constexpr u32 CHECK_CYCLES = 1'000'000;
+static constexpr u64 TIMED_CYCLES = 50'000'000;
+static constexpr u32 SWITCHES = 10'000'000;
+
+// keeps the reads after host switches from being optimized away
+static volatile u64 s_Sink;
+
+// window 8 is marked, 9 reads the marks back, code runs from 10
+static constexpr const char* CHECK = R"(
+MMU = $F000
+DATA = $8000
+MIRROR = $9000
+CODE = $A000
+COUNT = 255
+
+		.org $FFFC
+		JMP start
+
+		.org $0200
+; bank X * $101 into DATA, marked with X at both ends
+start:	LDX #0
+fill:	SDX MMU + 16
+		SDX MMU + 17
+		SDX DATA
+		SDX DATA + $FFF
+		INX
+		CPX #COUNT
+		BEQ read
+		JMP fill
+
+; the same banks into MIRROR
+read:	LDX #0
+verify:	SDX MMU + 18
+		SDX MMU + 19
+		CPX MIRROR
+		BEQ * + 5
+		JMP fail
+		CPX MIRROR + $FFF
+		BEQ * + 5
+		JMP fail
+		INX
+		CPX #COUNT
+		BEQ code
+		JMP verify
+
+; banks 1 and 2 into CODE, each holding LDA #bank; JMP back
+code:	LDX #0
+		SDX MMU + 20
+		LDX #1
+again:	SDX MMU + 21
+		JMP CODE
+back:	SDA $10
+		CPX $10
+		BEQ * + 5
+		JMP fail
+		INX
+		CPX #3
+		BEQ pass
+		JMP again
+
+pass:	JMP pass
+fail:	JMP fail
+)";
+
+using Engine = std::function<ExecResult(CPU& cpu, u64 cycles, Memory& ram)>;
+
+struct NamedEngine
+{
+	const char* name;
+	std::function<Engine()> make;		// a fresh instance, with nothing cached
+};
+
+static const NamedEngine s_Engines[] =
+{
+	{ "execute", [] { return Engine([](CPU& cpu, u64 cycles, Memory& ram) { return cpu.Execute(cycles, ram); }); } },
+	{ "blocks", []
+	{
+		auto cache = std::make_shared<BlockCache>();
+		return Engine([cache](CPU& cpu, u64 cycles, Memory& ram) { return cache->Execute(cpu, cycles, ram); });
+	} },
+	{ "jit", []
+	{
+		auto jit = std::make_shared<Jit>();
+		return Engine([jit](CPU& cpu, u64 cycles, Memory& ram) { return jit->Execute(cpu, cycles, ram); });
+	} },
+};
+
+static word Address(const Assembly& program, const char* label)
+{
+	return program.Find(label)->value;
+}
+
+// Runs the check on `engine`; nullptr when it passed, else what went wrong.
+static const char* Check(const Assembly& program, const Engine& engine)
+{
+	Memory ram;
+	CPU cpu;
+	cpu.Reset(ram);
+	program.Load(ram);
+	Mmu mmu(ram, MMU_ADDRESS, Mmu::MAX_BANKS);
+	if (mmu.Banks() != Mmu::MAX_BANKS)
+	{
+		return "the arena could not be allocated";
+	}
+	word back = Address(program, "back");
+	for (byte bank = 1; bank <= 2; bank++)
+	{
+		const byte code[] = { CPU::INS_LDA_IM, bank, CPU::INS_JMP_ABS, (byte)(back >> 8), (byte)back };
+		std::copy(std::begin(code), std::end(code), mmu.Bank(bank));
+	}
+
+	u64 used = 0;
+	ExecResult result;
+	do
+	{
+		result = engine(cpu, CHECK_CYCLES - used, ram);
+		used += result.cycles;
+	} while (result.reason != StopReason::Halt && used < CHECK_CYCLES);
+	if (cpu.PC != Address(program, "pass"))
+	{
+		return cpu.PC == Address(program, "fail") ? "failed a check" : "did not reach a trap";
+	}
+
+	for (u32 x = 0; x < 255; x++)
+	{
+		const byte* bank = mmu.Bank(x * 0x101);
+		if (bank[0] != x || bank[Mmu::WINDOW_SIZE - 1] != x)
+		{
+			return "the marks are not in the arena";
+		}
+	}
+	for (u32 window = 8; window <= 10; window++)
+	{
+		mmu.Select(window, Mmu::NONE);
+	}
+	for (u32 address = 0x8000; address < 0xB000; address++)
+	{
+		if (ram.Read(address) != 0)
+		{
+			return "the RAM under the windows was written";
+		}
+	}
+	return nullptr;
+}
+
+// `body` 16 times, then back to the start
+static Assembly Loop(const std::string& body)
+{
+	std::string source = "MMU = $F000\n\t.org $FFFC\n\tJMP start\n\t.org $0200\nstart:\n";
+	for (int i = 0; i < 16; i++)
+	{
+		source += body;
+	}
+	source += "\tJMP start\n";
+	return compile(source);
+}
+
+// MHz of `program` under `engine`, with window 8 showing `bank`
+static double Time(const Assembly& program, const Engine& engine, word bank)
+{
+	Memory ram;
+	CPU cpu;
+	cpu.Reset(ram);
+	program.Load(ram);
+	Mmu mmu(ram, MMU_ADDRESS, Mmu::MAX_BANKS);
+	mmu.Select(8, bank);
+
+	auto begin = std::chrono::steady_clock::now();
+	u64 used = 0;
+	while (used < TIMED_CYCLES)
+	{
+		used += engine(cpu, TIMED_CYCLES - used, ram).cycles;
+	}
+	auto end = std::chrono::steady_clock::now();
+	return used / std::chrono::duration<double>(end - begin).count() / 1e6;
+}
+
+int main()
+{
+	Assembly check = compile(CHECK);
+	Assembly access = Loop("\tSDA $8123\n\tCMP $8456\n\tSDA $8F00\n\tCMP $8F01\n");
+	// bank X * $101 into window 8 and a store to it; X wraps
+	Assembly switching = Loop("\tSDX MMU + 16\n\tSDX MMU + 17\n\tSDA $8000\n\tINX\n");
+	for (const Assembly* program : { &check, &access, &switching })
+	{
+		if (!program->Ok())
+		{
+			std::fprintf(stderr, "%s\n", program->errors.front().c_str());
+			return 1;
+		}
+	}
+
+	bool ok = true;
+	std::printf("%-8s %-12s %12s %12s %12s   %s\n", "engine", "check", "ram MHz", "banked MHz", "switch MHz", "");
+	for (const NamedEngine& engine : s_Engines)
+	{
+		const char* failure = Check(check, engine.make());
+		ok &= failure == nullptr;
+		std::printf("%-8s %-12s %12.1f %12.1f %12.1f   %s\n", engine.name, failure ? "FAILED" : "passed",
+			Time(access, engine.make(), Mmu::NONE), Time(access, engine.make(), 0x1234),
+			Time(switching, engine.make(), Mmu::NONE), failure ? failure : "");
+	}
+
+	// host-side switches of window 8 to banks all over the arena, each read from
+	Memory ram;
+	Mmu mmu(ram, MMU_ADDRESS, Mmu::MAX_BANKS);
+	u64 sum = 0;
+	auto begin = std::chrono::steady_clock::now();
+	for (u32 i = 0; i < SWITCHES; i++)
+	{
+		mmu.Select(8, (word)(i * 7919u % Mmu::MAX_BANKS));
+		sum += ram.Read(0x8000);
+	}
+	auto end = std::chrono::steady_clock::now();
+	s_Sink = sum;
+	std::printf("host switch: %.1f ns\n", std::chrono::duration<double>(end - begin).count() / SWITCHES * 1e9);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,72 @@
+// Throughput of VmPool with 1..hardware_concurrency worker threads.
+//
+//   cmake --build build --target bench_pool && build/bench_pool
+
+#include <chrono>
+#include <cstdio>
+#include "pool.hpp"
+
+int main()
+{
+	constexpr u32 JOBS = 512;
+	constexpr u64 CYCLES = 200'000;
+
+	// counts X, printing it every time Y wraps around
+	const byte program[] = {
+		CPU::INS_INX_IM,
+		CPU::INS_INY_IM,
+		CPU::INS_CPY_IM, 0x00,
+		CPU::INS_BEQ_RL, 0x03,
+		CPU::INS_JMP_ABS, 0x02, 0x00,
+		CPU::INS_SDX_ABS, 0xFF, 0xFF,
+		CPU::INS_JMP_ABS, 0x02, 0x00,
+	};
+
+	// every job forks this template instead of copying the program
+	auto base = std::make_shared<Memory>();
+	base->WriteBlock(0x0200, program, sizeof(program));
+	base->Freeze();
+
+	unsigned maxThreads = std::thread::hardware_concurrency();
+	if (maxThreads == 0)
+	{
+		maxThreads = 1;
+	}
+
+	std::vector<unsigned> counts;
+	for (unsigned threads = 1; threads < maxThreads; threads *= 2)
+	{
+		counts.push_back(threads);
+	}
+	counts.push_back(maxThreads);
+
+	double baseline = 0;
+	std::printf("%8s %10s %12s %10s %8s\n", "threads", "seconds", "jobs/s", "MHz", "speedup");
+	for (unsigned threads : counts)
+	{
+		VmPool pool(threads);
+		std::vector<std::future<VmResult>> results;
+		results.reserve(JOBS);
+
+		auto begin = std::chrono::steady_clock::now();
+		for (u32 i = 0; i < JOBS; i++)
+		{
+			results.push_back(pool.Submit({ base, nullptr, 0x0200, CYCLES }));
+		}
+
+		u64 cycles = 0;
+		for (auto& result : results)
+		{
+			cycles += result.get().cycles;
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+		if (threads == 1)
+		{
+			baseline = seconds;
+		}
+		std::printf("%8u %10.3f %12.1f %10.1f %7.2fx\n", threads, seconds, JOBS / seconds,
+			cycles / seconds / 1e6, baseline / seconds);
+	}
+	return 0;
+}
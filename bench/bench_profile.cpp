@@ -0,0 +1,211 @@
+// Checks and times the Profiler: runs a program that calls two ISRs of
+// different cost through BRK until it halts, under Profiler::Execute and
+// CPU::Execute, and requires the same registers and cycles from both. The
+// profile's folded call stacks (Profiler::WriteFolded) are read back: they
+// must add up to the cycles run and charge each ISR to its own frame under
+// the root, named after the labels of the program, and again after the same
+// names loaded from a symbol file (Profiler::LoadSymbols).
+//
+// Reports the emulated MHz of both runs. Exits with 1 when a check fails.
+//
+//   cmake --build build --target bench_profile && build/bench_profile
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include "compiler.hpp"
+#include "profiler.hpp"
+
+static constexpr u64 CYCLES = 100'000'000;		// more than the program runs
+
+static constexpr const char* PROGRAM = R"(
+ISR_TABLE = $FDFC
+CALLS = 200
+
+		.org ISR_TABLE
+		.word fast
+		.word slow
+
+		.org $FFFC
+reset:	JMP start
+
+		.org $0200
+start:	LDY #0
+loop:	LDA #0
+		BRK
+		LDA #1
+		BRK
+		INY
+		CPY #CALLS
+		BEQ done
+		JMP loop
+done:	JMP done
+
+		.org $F100
+fast:	NOP
+		RTI
+slow:	LDX #0
+spin:	INX
+		CPX #200
+		BEQ back
+		JMP spin
+back:	RTI
+)";
+
+struct Run
+{
+	CPU cpu;
+	ExecResult result;
+	double seconds = 0;
+};
+
+template <typename Execute>
+static Run Boot(const Assembly& program, Execute execute)
+{
+	Run run;
+	Memory ram;
+	run.cpu.Reset(ram);
+	program.Load(ram);
+	auto begin = std::chrono::steady_clock::now();
+	run.result = execute(run.cpu, ram);
+	run.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	return run;
+}
+
+// The folded stacks of `profiler` as stack -> cycles; nullptr when they read
+// back, else what is wrong with them.
+static const char* ReadFolded(const Profiler& profiler, std::map<std::string, u64>& stacks)
+{
+	FILE* file = std::tmpfile();
+	if (!file)
+	{
+		return "cannot create a temporary file";
+	}
+	profiler.WriteFolded(file);
+	std::rewind(file);
+
+	const char* error = nullptr;
+	char line[512];
+	while (!error && std::fgets(line, sizeof(line), file))
+	{
+		std::string text(line);
+		size_t space = text.rfind(' ');
+		char* end;
+		u64 cycles = space == std::string::npos ? 0 : std::strtoull(text.c_str() + space + 1, &end, 10);
+		if (!cycles || (*end != '\n' && *end != '\0') || !stacks.emplace(text.substr(0, space), cycles).second)
+		{
+			error = "a line is not `stack cycles`, or repeats a stack";
+		}
+	}
+	std::fclose(file);
+	return error;
+}
+
+static const char* CheckFolded(const Profiler& profiler, u64 cycles)
+{
+	std::map<std::string, u64> stacks;
+	if (const char* error = ReadFolded(profiler, stacks))
+	{
+		return error;
+	}
+
+	u64 total = 0;
+	for (const auto& [stack, count] : stacks)
+	{
+		total += count;
+	}
+	if (total != cycles)
+	{
+		return "the stacks do not add up to the cycles run";
+	}
+	if (stacks.size() != 3 || !stacks.contains("reset") || !stacks.contains("reset;fast") || !stacks.contains("reset;slow"))
+	{
+		return "the stacks are not reset, reset;fast and reset;slow";
+	}
+	if (stacks["reset;slow"] <= stacks["reset;fast"])
+	{
+		return "the slow ISR is not charged more than the fast one";
+	}
+	return nullptr;
+}
+
+// The labels of `program` written out and loaded back, in both line formats.
+static bool LoadSymbols(const Assembly& program, Profiler& profiler)
+{
+	FILE* file = std::fopen("bench_profile.sym", "w");
+	if (!file)
+	{
+		return false;
+	}
+	std::fprintf(file, "; labels of the bench program\n");
+	bool assigned = false;
+	for (const Symbol& symbol : program.Labels())
+	{
+		if (assigned)
+		{
+			std::fprintf(file, "%s = $%04X\n", symbol.name.c_str(), symbol.value);
+		}
+		else
+		{
+			std::fprintf(file, "0x%04X %s\n", symbol.value, symbol.name.c_str());
+		}
+		assigned = !assigned;
+	}
+	std::fclose(file);
+	bool loaded = profiler.LoadSymbols("bench_profile.sym");
+	std::remove("bench_profile.sym");
+	return loaded;
+}
+
+int main()
+{
+	Assembly program = compile(PROGRAM);
+	if (!program.Ok())
+	{
+		std::fprintf(stderr, "%s\n", program.errors.front().c_str());
+		return 1;
+	}
+
+	Run reference = Boot(program, [](CPU& cpu, Memory& ram) { return cpu.Execute(CYCLES, ram); });
+	if (reference.result.reason != StopReason::Halt)
+	{
+		std::fprintf(stderr, "the program does not halt\n");
+		return 1;
+	}
+
+	Profiler labelled;
+	labelled.SetSymbols(program.Labels());
+	Run profiled = Boot(program, [&](CPU& cpu, Memory& ram) { return labelled.Execute(cpu, CYCLES, ram); });
+
+	const char* failure = nullptr;
+	if (!(profiled.cpu == reference.cpu) || profiled.result.cycles != reference.result.cycles
+		|| profiled.result.reason != reference.result.reason)
+	{
+		failure = "the profiled run differs from CPU::Execute's";
+	}
+	if (!failure)
+	{
+		failure = CheckFolded(labelled, reference.result.cycles);
+	}
+
+	Profiler loaded;
+	if (!failure && !LoadSymbols(program, loaded))
+	{
+		failure = "cannot write and load a symbol file";
+	}
+	if (!failure)
+	{
+		Boot(program, [&](CPU& cpu, Memory& ram) { return loaded.Execute(cpu, CYCLES, ram); });
+		failure = CheckFolded(loaded, reference.result.cycles);
+	}
+
+	std::printf("%-10s %10s %10s\n", "engine", "seconds", "MHz");
+	for (const auto& [name, run] : { std::pair{ "execute", &reference }, std::pair{ "profiler", &profiled } })
+	{
+		std::printf("%-10s %10.4f %10.1f\n", name, run->seconds, run->result.cycles / run->seconds / 1e6);
+	}
+	std::printf("%s\n", failure ? failure : "profile checked");
+	return failure ? 1 : 0;
+}
@@ -0,0 +1,86 @@
+// Cost of resetting a VM between jobs.
+//
+//   g++ -std=c++20 -O2 -I vm_6502 bench/bench_reset.cpp
+
+#include <chrono>
+#include <cstdio>
+#include "cpu.hpp"
+
+template <typename F>
+static double NanosecondsPer(u32 iterations, F f)
+{
+	auto begin = std::chrono::steady_clock::now();
+	for (u32 i = 0; i < iterations; i++)
+	{
+		f(i);
+	}
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::nano>(end - begin).count() / iterations;
+}
+
+// what a short job does to memory: a little stack, zero page and one data page
+static void Touch(Memory& ram, u32 i)
+{
+	ram.Write(0x0010, (byte)i);
+	ram.Write(0x00FE, (byte)i);
+	ram.Write(0x0200 + (i & 0xFF), (byte)i);
+}
+
+int main()
+{
+	constexpr u32 ITERATIONS = 200'000;
+
+	// the previous Memory::Init, one byte at a time over a flat array
+	static byte flat[Memory::MAX_MEM];
+	double flatLoop = NanosecondsPer(ITERATIONS, [](u32 i)
+	{
+		flat[i & 0xFFFF] = (byte)i;
+		for (u32 address = 0; address < Memory::MAX_MEM; address++)
+		{
+			((volatile byte*)flat)[address] = 0;
+		}
+	});
+
+	Memory pristine;
+	for (u32 address = 0xF100; address < Memory::MAX_MEM; address++)
+	{
+		pristine[address] = (byte)address;
+	}
+	pristine.Freeze();
+
+	Memory ram;
+	CPU cpu;
+
+	double init = NanosecondsPer(ITERATIONS, [&](u32 i)
+	{
+		Touch(ram, i);
+		cpu.Reset(ram);
+	});
+
+	cpu.Reset(ram, pristine);
+	double restore = NanosecondsPer(ITERATIONS, [&](u32 i)
+	{
+		Touch(ram, i);
+		cpu.Reset(ram, pristine);
+	});
+
+	double fork = NanosecondsPer(ITERATIONS, [&](u32 i)
+	{
+		Touch(ram, i);
+		ram = pristine;
+	});
+
+	double soft = NanosecondsPer(ITERATIONS, [&](u32 i)
+	{
+		Touch(ram, i);
+		cpu.SoftReset();
+	});
+
+	std::printf("%-36s %10s\n", "reset (3 dirty pages per job)", "ns/reset");
+	std::printf("%-36s %10.1f\n", "byte loop over 64 KiB (old Init)", flatLoop);
+	std::printf("%-36s %10.1f\n", "CPU::Reset (dirty pages only)", init);
+	std::printf("%-36s %10.1f\n", "CPU::Reset from pristine image", restore);
+	std::printf("%-36s %10.1f\n", "fork from pristine image", fork);
+	std::printf("%-36s %10.1f\n", "CPU::SoftReset", soft);
+	return 0;
+}
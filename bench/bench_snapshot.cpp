@@ -0,0 +1,75 @@
+// Cost and size of checkpointing a VM with SaveSnapshot / RestoreSnapshot.
+//
+//   g++ -std=c++20 -O2 -I vm_6502 bench/bench_snapshot.cpp vm_6502/snapshot.cpp
+
+#include <chrono>
+#include <cstdio>
+#include "snapshot.hpp"
+
+template <typename F>
+static double NanosecondsPer(u32 iterations, F f)
+{
+	auto begin = std::chrono::steady_clock::now();
+	for (u32 i = 0; i < iterations; i++)
+	{
+		f(i);
+	}
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::nano>(end - begin).count() / iterations;
+}
+
+// what a guest leaves behind: stack and zero page, then `pages` more pages of
+// mostly small counters
+static void Touch(Memory& ram, u32 pages, u32 i)
+{
+	ram.Write(0x0010, (byte)i);
+	ram.Write(0x00FE, (byte)i);
+	for (u32 page = 0; page < pages; page++)
+	{
+		for (u32 offset = 0; offset < Memory::PAGE_SIZE; offset += 16)
+		{
+			ram.Write(0x0200 + page * Memory::PAGE_SIZE + offset, (byte)(i + offset));
+		}
+	}
+}
+
+int main()
+{
+	constexpr u32 ITERATIONS = 100'000;
+
+	Memory pristine;
+	for (u32 address = 0xF100; address < Memory::MAX_MEM; address++)
+	{
+		pristine[address] = (byte)address;
+	}
+	pristine.Freeze();
+
+	std::printf("%-32s %12s %12s %10s\n", "snapshot against the image", "ns/save", "ns/restore", "bytes");
+	for (u32 pages : { 0u, 4u, 32u })
+	{
+		for (Compression compression : { Compression::None, Compression::Runs })
+		{
+			Memory ram;
+			Memory target;
+			CPU cpu, restored;
+			cpu.Reset(ram, pristine);
+			target.Restore(pristine);
+			std::vector<byte> snapshot;
+
+			Touch(ram, pages, 1);
+			double save = NanosecondsPer(ITERATIONS, [&](u32)
+			{
+				SaveSnapshot(snapshot, cpu, ram, &pristine, compression);
+			});
+			double restore = NanosecondsPer(ITERATIONS, [&](u32)
+			{
+				RestoreSnapshot(snapshot, restored, target, &pristine);
+			});
+
+			char name[64];
+			std::snprintf(name, sizeof(name), "%u + 1 dirty pages, %s", pages, compression == Compression::Runs ? "runs" : "raw");
+			std::printf("%-32s %12.1f %12.1f %10zu\n", name, save, restore, snapshot.size());
+		}
+	}
+	return 0;
+}
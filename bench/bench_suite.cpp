@@ -0,0 +1,601 @@
+// Micro and macro benchmarks of the interpreter (CPU::Execute and the CPU
+// helpers under it): byte fetches and reads, ADC / SBC as the CPU does them
+// against computed, every addressing mode, branches, decimal arithmetic,
+// the stack, ISR round trips through BRK / RTI, Reset, and whole programs
+// booted from reset.
+//
+// Like Google Benchmark, each benchmark is run with more and more iterations
+// until one run takes at least MIN_SECONDS, and that run is reported as
+// instructions per second (MIPS) and emulated cycles per second (MHz). For
+// the micro benchmarks an instruction is one call of the helper, for reset/*
+// one reset.
+//
+//   bench_suite [FILTER] [--save FILE] [--baseline FILE]
+//
+// FILTER runs only the benchmarks whose name contains it. --save writes the
+// results to FILE; --baseline reads such a file back and shows how far each
+// MIPS figure moved since, so a change can be measured against the tree it
+// started from.
+//
+//   cmake -S . -B build && cmake --build build --target bench_suite && build/bench_suite
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "alu.hpp"
+#include "compiler.hpp"
+#include "console.hpp"
+#include "dispatch.hpp"
+#include "hello.hpp"
+
+static constexpr double MIN_SECONDS = 0.5;
+static constexpr u64 MAX_ITERATIONS = 1ull << 40;
+
+struct State
+{
+	u64 iterations;			// times to do the benchmark's unit of work
+	u64 instructions = 0;	// guest instructions, or calls / resets, done in them
+	u64 cycles = 0;			// emulated cycles they took
+
+	/// Leaves whatever was done so far (setup) out of the measurement.
+	void ResetTimer() { m_Begin = std::chrono::steady_clock::now(); }
+
+	std::chrono::steady_clock::time_point m_Begin;
+};
+
+struct Benchmark
+{
+	std::string name;
+	std::function<void(State&)> run;
+};
+
+// keeps results the benchmarks compute from being optimized away
+static volatile u64 s_Sink;
+
+static void Fail(const std::string& name, const char* what)
+{
+	std::fprintf(stderr, "%s: %s\n", name.c_str(), what);
+	std::exit(1);
+}
+
+// -- micro ------------------------------------------------------------------
+
+// u32 cycle counters would wrap on long runs, so the micro benchmarks count
+// in chunks
+static constexpr u64 CHUNK = 1u << 20;
+
+static void FetchByte(State& state)
+{
+	static Memory ram;
+	CPU cpu;
+	cpu.Reset(ram);
+	state.ResetTimer();
+
+	u64 sum = 0;
+	for (u64 done = 0; done < state.iterations; done += CHUNK)
+	{
+		u64 n = std::min(CHUNK, state.iterations - done);
+		u32 cycles = 0;
+		for (u64 i = 0; i < n; i++)
+		{
+			sum += cpu.FetchByte(cycles, ram);
+		}
+		state.cycles += 0 - cycles;
+	}
+	state.instructions = state.iterations;
+	s_Sink = sum;
+}
+
+static void ReadByte(State& state)
+{
+	static Memory ram;
+	CPU cpu;
+	cpu.Reset(ram);
+	state.ResetTimer();
+
+	u64 sum = 0;
+	u32 address = 0;
+	for (u64 done = 0; done < state.iterations; done += CHUNK)
+	{
+		u64 n = std::min(CHUNK, state.iterations - done);
+		u32 cycles = 0;
+		for (u64 i = 0; i < n; i++)
+		{
+			// a stride that visits every page, like scattered operands do
+			address = (address + 0x0101) & 0xFFFF;
+			sum += cpu.ReadByte(cycles, ram, address);
+		}
+		state.cycles += 0 - cycles;
+	}
+	state.instructions = state.iterations;
+	s_Sink = sum;
+}
+
+// -- alu --------------------------------------------------------------------
+
+// ADC / SBC as the CPU does them (alu::Execute: binary computed, decimal
+// looked up in alu::s_Decimal) against computed by alu::Add and
+// alu::Subtract, chained through A and C as a guest's arithmetic is, with
+// operands that wander over the whole table
+template <alu::Operation Operation, bool Decimal, bool Lookup>
+static void Arithmetic(State& state)
+{
+	byte a = 0, carry = 0;
+	u64 sum = 0;
+	state.ResetTimer();
+	for (u64 i = 0; i < state.iterations; i++)
+	{
+		byte data = (byte)(i * 0x9D);
+		alu::Entry entry;
+		if constexpr (Lookup)
+		{
+			entry = alu::Execute(Operation, a, data, carry, Decimal);
+		}
+		else if constexpr (Operation == alu::ADC)
+		{
+			entry = alu::Add(a, data, carry, Decimal);
+		}
+		else
+		{
+			entry = alu::Subtract(a, data, carry, Decimal);
+		}
+		a = alu::Result(entry);
+		carry = alu::Carry(entry);
+		sum += alu::ZN(entry) + alu::Overflow(entry);
+	}
+	// as ADC # / SBC #
+	state.instructions = state.iterations;
+	state.cycles = state.iterations * 2;
+	s_Sink = sum + a;
+}
+
+// -- guest loops ------------------------------------------------------------
+
+// The loops start at $0200 and JMP back to it; one pass is an iteration. They
+// all write memory on every pass so that Execute never takes them for idle.
+struct Loop
+{
+	const char* name;
+	std::vector<byte> code;
+};
+
+static std::vector<byte> Repeat(std::vector<byte> instruction, u32 times)
+{
+	std::vector<byte> code;
+	for (u32 i = 0; i < times; i++)
+	{
+		code.insert(code.end(), instruction.begin(), instruction.end());
+	}
+	code.insert(code.end(), { CPU::INS_INC_ZP, 0x10, CPU::INS_JMP_ABS, 0x02, 0x00 });
+	return code;
+}
+
+static std::vector<Loop> Loops()
+{
+	return
+	{
+		// one instruction per addressing mode, 16 times a pass
+		{ "mode/implied", Repeat({ CPU::INS_NOP_IM }, 16) },
+		{ "mode/immediate", Repeat({ CPU::INS_AND_IM, 0xFF }, 16) },
+		{ "mode/zero_page", Repeat({ CPU::INS_AND_ZP, 0x20 }, 16) },
+		{ "mode/zero_page_x", Repeat({ CPU::INS_AND_ZPX, 0x20 }, 16) },
+		{ "mode/zero_page_y", Repeat({ CPU::INS_LDX_ZPY, 0x20 }, 16) },
+		{ "mode/absolute", Repeat({ CPU::INS_AND_ABS, 0x03, 0x00 }, 16) },
+		{ "mode/absolute_x", Repeat({ CPU::INS_AND_ABSX, 0x03, 0x00 }, 16) },
+		{ "mode/absolute_y", Repeat({ CPU::INS_AND_ABSY, 0x03, 0x00 }, 16) },
+		{ "mode/store_zero_page", Repeat({ CPU::INS_SDA_ZP, 0x20 }, 16) },
+		{ "mode/store_absolute", Repeat({ CPU::INS_SDA_ABS, 0x03, 0x00 }, 16) },
+		{ "mode/read_modify_write", Repeat({ CPU::INS_INC_ZP, 0x20 }, 16) },
+		// Z is clear after reset, so each of these is taken to the next one
+		{ "mode/relative", Repeat({ CPU::INS_BNE_RL, 0x00 }, 16) },
+
+		// arithmetic / zero page mix
+		{ "loop/alu", {
+			CPU::INS_LDA_IM, 0x10,
+			CPU::INS_ADC_ZP, 0x20,
+			CPU::INS_SDA_ZP, 0x21,
+			CPU::INS_AND_IM, 0x7F,
+			CPU::INS_ORA_ZP, 0x22,
+			CPU::INS_EOR_ZP, 0x23,
+			CPU::INS_INX_IM,
+			CPU::INS_CMP_ZP, 0x24,
+			CPU::INS_DEC_ZP, 0x25,
+			CPU::INS_INC_ABS, 0x03, 0x00,
+			CPU::INS_LDY_ZP, 0x26,
+			CPU::INS_ADC_ABSX, 0x03, 0x00,
+			CPU::INS_JMP_ABS, 0x02, 0x00,
+		} },
+		// BCD counter: SED, then decimal ADC / SBC through memory
+		{ "loop/decimal", {
+			CPU::INS_SED_IM,
+			CPU::INS_LDA_ZP, 0x20,
+			CPU::INS_ADC_IM, 0x19,
+			CPU::INS_ADC_ZP, 0x21,
+			CPU::INS_SDA_ZP, 0x20,
+			CPU::INS_SBC_IM, 0x07,
+			CPU::INS_SBC_ZP, 0x22,
+			CPU::INS_ADC_ABS, 0x03, 0x00,
+			CPU::INS_SBC_ZPX, 0x23,
+			CPU::INS_SDA_ZP, 0x21,
+			CPU::INS_CLD_IM,
+			CPU::INS_JMP_ABS, 0x02, 0x00,
+		} },
+		// counted inner loop, every block a short one ended by a branch
+		{ "loop/branch", {
+			CPU::INS_INY_IM,
+			CPU::INS_CPY_IM, 0x00,
+			CPU::INS_BEQ_RL, 0x03,
+			CPU::INS_JMP_ABS, 0x02, 0x00,
+			CPU::INS_INX_IM,
+			CPU::INS_CPX_IM, 0x80,
+			CPU::INS_BNE_RL, 0x00,
+			CPU::INS_INC_ZP, 0x10,
+			CPU::INS_JMP_ABS, 0x02, 0x00,
+		} },
+		// PHA / PLA pairs
+		{ "loop/stack", Repeat({ CPU::INS_PHA_IM, CPU::INS_PLA_IM }, 8) },
+		// software interrupt round trips through the ISR table
+		{ "isr/brk_rti", {
+			CPU::INS_LDA_IM, 0x00,
+			CPU::INS_BRK_IM,
+			CPU::INS_NOP_IM,
+			CPU::INS_INC_ZP, 0x10,
+			CPU::INS_JMP_ABS, 0x02, 0x00,
+		} },
+	};
+}
+
+static constexpr word LOOP_START = 0x0200;
+
+static void Load(const Loop& loop, CPU& cpu, Memory& ram)
+{
+	cpu.Reset(ram);
+	for (size_t i = 0; i < loop.code.size(); i++)
+	{
+		ram[LOOP_START + i] = loop.code[i];
+	}
+
+	// ISR 0: LDA #$00; RTI
+	ram[0xF100] = CPU::INS_LDA_IM;
+	ram[0xF101] = 0x00;
+	ram[0xF102] = CPU::INS_RTI_IM;
+	ram[0xFDFC] = 0xF1;
+	ram[0xFDFD] = 0x00;
+
+	cpu.PC = LOOP_START;
+}
+
+static Benchmark Run(const Loop& loop)
+{
+	// one pass, stepped, gives the instructions and cycles of every pass
+	u64 instructions = 0, cycles = 0;
+	{
+		static Memory ram;
+		CPU cpu;
+		Load(loop, cpu, ram);
+		do
+		{
+			cycles += cpu.Step(ram);
+			instructions++;
+		} while (cpu.PC != LOOP_START && instructions < 1000);
+		if (cpu.PC != LOOP_START)
+		{
+			Fail(loop.name, "does not come back to its start");
+		}
+	}
+
+	return { loop.name, [loop, instructions, cycles](State& state)
+	{
+		static Memory ram;
+		CPU cpu;
+		Load(loop, cpu, ram);
+		state.ResetTimer();
+
+		ExecResult result = cpu.Execute(state.iterations * cycles, ram);
+		if (result.reason != StopReason::Budget)
+		{
+			Fail(loop.name, "stopped before its budget ran out");
+		}
+		state.cycles = result.cycles;
+		state.instructions = result.cycles * instructions / cycles;
+	} };
+}
+
+// -- reset ------------------------------------------------------------------
+
+// what a short job does to memory: a little stack, zero page and one data page
+static void Touch(Memory& ram, u64 i)
+{
+	ram.Write(0x0010, (byte)i);
+	ram.Write(0x00FE, (byte)i);
+	ram.Write(0x0200 + (i & 0xFF), (byte)i);
+}
+
+static void ResetCold(State& state)
+{
+	static Memory ram;
+	CPU cpu;
+	state.ResetTimer();
+	for (u64 i = 0; i < state.iterations; i++)
+	{
+		Touch(ram, i);
+		cpu.Reset(ram);
+	}
+	state.instructions = state.iterations;
+}
+
+static void ResetPristine(State& state)
+{
+	static Memory ram, pristine;
+	CPU cpu;
+	cpu.Reset(pristine);
+	compile(HELLO_WORLD).Load(pristine);
+	state.ResetTimer();
+	for (u64 i = 0; i < state.iterations; i++)
+	{
+		Touch(ram, i);
+		cpu.Reset(ram, pristine);
+	}
+	state.instructions = state.iterations;
+}
+
+// -- programs ---------------------------------------------------------------
+
+// bubble sort of 64 bytes in zero page, from descending to ascending order
+static std::string SortProgram()
+{
+	std::string source = "\t.org $20\n\t.byte 64";
+	for (int i = 63; i > 0; i--)
+	{
+		source += ", " + std::to_string(i);
+	}
+	source += R"(
+		.org $FFFC
+		JMP start
+
+		.org $0200
+start:	LDY #0					; swaps in this pass
+		LDX #0
+pass:	LDA $20,X
+		CMP $21,X
+		BCC next				; in order
+		BEQ next
+		PHA
+		LDA $21,X
+		SDA $20,X
+		PLA
+		SDA $21,X
+		INY
+next:	INX
+		CPX #63
+		BEQ done
+		JMP pass
+done:	CPY #0
+		BEQ halt
+		JMP start
+halt:	JMP halt
+)";
+	return source;
+}
+
+// Boots `source` and runs it until it halts or PROGRAM_CYCLES are used, once
+// per iteration. Stops for invalid opcodes, which the guest handles itself,
+// are run through.
+static constexpr u64 PROGRAM_CYCLES = 1'000'000;
+
+static Benchmark Program(const char* name, const std::string& source)
+{
+	Assembly assembly = compile(source);
+	if (!assembly.Ok())
+	{
+		Fail(name, assembly.errors[0].c_str());
+	}
+
+	auto pristine = std::make_shared<Memory>();
+	CPU cpu;
+	cpu.Reset(*pristine);
+	assembly.Load(*pristine);
+
+	// instructions up to where Execute stops, stepped on a copy without the console
+	u64 instructions = 0;
+	{
+		Memory ram(*pristine);
+		CPU stepped = cpu;
+		u64 cycles = 0;
+		for (;;)
+		{
+			word pc = stepped.PC;
+			byte opcode = ram.Read(pc);
+			cycles += stepped.Step(ram);
+			instructions++;
+			if (dispatch::s_Traits[opcode].endsBlock && (cycles >= PROGRAM_CYCLES
+				|| dispatch::EndOf(opcode, pc, stepped.PC) == dispatch::Ending::Halt))
+			{
+				break;
+			}
+		}
+	}
+
+	return { name, [name, pristine, instructions](State& state)
+	{
+		static Memory ram;
+		Console console([](std::span<const byte>) {});
+		ram.Map(Console::ADDRESS, Console::ADDRESS, console);
+		CPU cpu;
+		state.ResetTimer();
+
+		for (u64 i = 0; i < state.iterations; i++)
+		{
+			cpu.Reset(ram, *pristine);
+			u64 used = 0;
+			while (used < PROGRAM_CYCLES)
+			{
+				ExecResult result = cpu.Execute(PROGRAM_CYCLES - used, ram);
+				used += result.cycles;
+				if (result.reason == StopReason::Halt)
+				{
+					break;
+				}
+				if (result.reason != StopReason::Budget && result.reason != StopReason::InvalidOpcode)
+				{
+					Fail(name, "stopped for something else than its budget or a halt");
+				}
+			}
+			state.cycles += used;
+		}
+		state.instructions = state.iterations * instructions;
+		ram.Unmap(Console::ADDRESS, Console::ADDRESS);
+	} };
+}
+
+// -- harness ----------------------------------------------------------------
+
+struct Result
+{
+	u64 iterations;
+	double seconds;
+	double mips;
+	double mhz;
+};
+
+static Result Measure(const Benchmark& benchmark)
+{
+	u64 iterations = 1;
+	for (;;)
+	{
+		State state{ iterations, 0, 0, {} };
+		state.ResetTimer();
+		benchmark.run(state);
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - state.m_Begin).count();
+
+		if (seconds >= MIN_SECONDS || iterations >= MAX_ITERATIONS)
+		{
+			return { iterations, seconds, state.instructions / seconds / 1e6, state.cycles / seconds / 1e6 };
+		}
+
+		// aim a bit past MIN_SECONDS, growing at most tenfold a run
+		double factor = seconds > 0 ? MIN_SECONDS * 1.4 / seconds : 10;
+		factor = std::clamp(factor, 2.0, 10.0);
+		iterations = (u64)(iterations * factor);
+	}
+}
+
+// "name mips mhz" lines, as written by --save
+static std::map<std::string, double> ReadBaseline(const char* path)
+{
+	std::map<std::string, double> mips;
+	FILE* file = std::fopen(path, "r");
+	if (!file)
+	{
+		std::fprintf(stderr, "%s: cannot open the file\n", path);
+		std::exit(1);
+	}
+	char name[256];
+	double value, mhz;
+	while (std::fscanf(file, "%255s %lf %lf", name, &value, &mhz) == 3)
+	{
+		mips[name] = value;
+	}
+	std::fclose(file);
+	return mips;
+}
+
+int main(int argc, char** argv)
+{
+	const char* filter = "";
+	const char* save = nullptr;
+	const char* baselinePath = nullptr;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string_view arg = argv[i];
+		if (arg == "--save" && i + 1 < argc)
+		{
+			save = argv[++i];
+		}
+		else if (arg == "--baseline" && i + 1 < argc)
+		{
+			baselinePath = argv[++i];
+		}
+		else if (!arg.starts_with("--"))
+		{
+			filter = argv[i];
+		}
+		else
+		{
+			std::fprintf(stderr, "usage: %s [FILTER] [--save FILE] [--baseline FILE]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	std::map<std::string, double> baseline;
+	if (baselinePath)
+	{
+		baseline = ReadBaseline(baselinePath);
+	}
+
+	std::vector<Benchmark> benchmarks =
+	{
+		{ "micro/fetch_byte", FetchByte },
+		{ "micro/read_byte", ReadByte },
+		{ "alu/adc_binary", Arithmetic<alu::ADC, false, true> },
+		{ "alu/adc_decimal_lookup", Arithmetic<alu::ADC, true, true> },
+		{ "alu/adc_decimal_computed", Arithmetic<alu::ADC, true, false> },
+		{ "alu/sbc_decimal_lookup", Arithmetic<alu::SBC, true, true> },
+		{ "alu/sbc_decimal_computed", Arithmetic<alu::SBC, true, false> },
+	};
+	for (const Loop& loop : Loops())
+	{
+		benchmarks.push_back(Run(loop));
+	}
+	benchmarks.push_back({ "reset/cold", ResetCold });
+	benchmarks.push_back({ "reset/pristine", ResetPristine });
+	benchmarks.push_back(Program("program/hello_world", HELLO_WORLD));
+	benchmarks.push_back(Program("program/bubble_sort", SortProgram()));
+
+	FILE* out = nullptr;
+	if (save && !(out = std::fopen(save, "w")))
+	{
+		std::fprintf(stderr, "%s: cannot create the file\n", save);
+		return 1;
+	}
+
+	std::printf("%-26s %12s %12s %10s %10s%s\n", "benchmark", "iterations", "ns/iter", "MIPS", "MHz",
+		baselinePath ? "   baseline" : "");
+	for (const Benchmark& benchmark : benchmarks)
+	{
+		if (!std::strstr(benchmark.name.c_str(), filter))
+		{
+			continue;
+		}
+
+		Result result = Measure(benchmark);
+		std::printf("%-26s %12llu %12.1f %10.1f %10.1f", benchmark.name.c_str(), (unsigned long long)result.iterations,
+			result.seconds / result.iterations * 1e9, result.mips, result.mhz);
+		auto before = baseline.find(benchmark.name);
+		if (before != baseline.end() && before->second > 0)
+		{
+			std::printf("   %+8.1f%%", (result.mips / before->second - 1) * 100);
+		}
+		std::printf("\n");
+		std::fflush(stdout);
+
+		if (out)
+		{
+			std::fprintf(out, "%s %.3f %.3f\n", benchmark.name.c_str(), result.mips, result.mhz);
+		}
+	}
+
+	if (out)
+	{
+		std::fclose(out);
+	}
+	return 0;
+}
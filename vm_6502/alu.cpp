@@ -0,0 +1,22 @@
+#include "alu.hpp"
+
+alu::Entry alu::s_Decimal[ENTRIES];
+
+namespace
+{
+	struct Fill
+	{
+		Fill()
+		{
+			for (u32 i = 0; i < alu::ENTRIES; i++)
+			{
+				byte a = (byte)i;
+				byte data = (byte)(i >> 8);
+				bool carry = (i >> 16) & 1;
+				alu::s_Decimal[i] = (i >> 17) == alu::SBC
+					? alu::Subtract(a, data, carry, true)
+					: alu::Add(a, data, carry, true);
+			}
+		}
+	} s_Fill;
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include "memory.hpp"
+
+/// ADC and SBC, binary computed and decimal looked up.
+///
+/// Binary arithmetic is a few ALU operations without branches, as cheap as a
+/// load and without its cache footprint, so Execute() computes it. Decimal
+/// mode takes the decimal-adjust branches instead, so s_Decimal holds every
+/// decimal outcome, indexed by the operation, C, the operand and A (see
+/// Index). An entry packs all the instruction changes:
+///
+///		bits 0-7	A
+///		bit 8		C
+///		bit 9		V
+///		bits 16-24	CPU::ZN
+///
+/// Decimal mode follows the NMOS 6502: A and C are decimal, V and N come
+/// from the sum before the high digit is adjusted and Z from the binary sum;
+/// SBC only adjusts A. Binary entries keep the result itself as ZN, as
+/// SetZN(value) would; decimal ones use the SetZN(bool, bool) form, since Z
+/// and N need not agree with A.
+///
+/// The table takes 1 MiB and is filled before main() starts. Add() and
+/// Subtract() compute the same entries, for anything that runs earlier, and
+/// as the reference the table is checked and benchmarked against.
+///
+/// A single table of both modes took 2 MiB and was no faster than computing
+/// binary arithmetic, whose lookups it pushed out of L1 (see the alu/
+/// benchmarks of bench_suite).
+namespace alu
+{
+	using Entry = u32;
+
+	enum Operation : u32
+	{
+		ADC = 0,
+		SBC = 1,
+	};
+
+	constexpr u32 ENTRIES = 1u << 18;
+
+	constexpr u32 Index(Operation operation, byte a, byte data, byte carry)
+	{
+		return (u32)operation << 17 | (u32)carry << 16 | (u32)data << 8 | a;
+	}
+
+	inline Entry Pack(u32 result, bool carry, bool overflow, word zn)
+	{
+		return (byte)result | (u32)carry << 8 | (u32)overflow << 9 | (u32)zn << 16;
+	}
+
+	// CPU::SetZN(bool, bool)'s encoding
+	inline word Flags(bool zero, bool negative)
+	{
+		return (zero ? 0x000 : 0x001) | (negative ? 0x100 : 0x000);
+	}
+
+	inline Entry Add(byte a, byte data, bool carry, bool decimal)
+	{
+		u32 sum = a + data + carry;
+		bool overflow = ((a ^ sum) & (data ^ sum) & 0x80) != 0;
+		if (!decimal)
+		{
+			return Pack(sum, sum > 0xFF, overflow, (byte)sum);
+		}
+
+		int low = (a & 0x0F) + (data & 0x0F) + carry;
+		if (low >= 0x0A)
+		{
+			low = ((low + 0x06) & 0x0F) + 0x10;
+		}
+		int result = (a & 0xF0) + (data & 0xF0) + low;
+		// N and V before the high digit is adjusted, reading the digits as signed
+		int signedResult = (signed char)(a & 0xF0) + (signed char)(data & 0xF0) + low;
+		bool negative = (result & 0x80) != 0;
+		overflow = signedResult < -128 || signedResult > 127;
+		if (result >= 0xA0)
+		{
+			result += 0x60;
+		}
+		return Pack(result, result >= 0x100, overflow, Flags((byte)sum == 0, negative));
+	}
+
+	inline Entry Subtract(byte a, byte data, bool carry, bool decimal)
+	{
+		// binary SBC is ADC of the operand's complement, flags and all
+		Entry binary = Add(a, (byte)~data, carry, false);
+		if (!decimal)
+		{
+			return binary;
+		}
+
+		int low = (a & 0x0F) - (data & 0x0F) + carry - 1;
+		if (low < 0)
+		{
+			low = ((low - 0x06) & 0x0F) - 0x10;
+		}
+		int result = (a & 0xF0) - (data & 0xF0) + low;
+		if (result < 0)
+		{
+			result -= 0x60;
+		}
+		return (binary & ~0xFFu) | (byte)result;
+	}
+
+	extern Entry s_Decimal[ENTRIES];
+
+	/// ADC or SBC as the CPU does it.
+	inline Entry Execute(Operation operation, byte a, byte data, byte carry, byte decimal)
+	{
+		if (decimal)
+		{
+			return s_Decimal[Index(operation, a, data, carry)];
+		}
+		// binary SBC is ADC of the operand's complement, see Subtract
+		return Add(a, operation == SBC ? (byte)~data : data, carry, false);
+	}
+
+	inline byte Result(Entry entry) { return (byte)entry; }
+	inline byte Carry(Entry entry) { return (entry >> 8) & 1; }
+	inline byte Overflow(Entry entry) { return (entry >> 9) & 1; }
+	inline word ZN(Entry entry) { return (word)(entry >> 16); }
+}
@@ -0,0 +1,102 @@
+#include "aot.hpp"
+
+namespace
+{
+	byte FirstPage(const aot::Block& block)
+	{
+		return (byte)(block.address / Memory::PAGE_SIZE);
+	}
+
+	byte LastPage(const aot::Block& block)
+	{
+		return (byte)((block.address + block.length - 1) / Memory::PAGE_SIZE);
+	}
+}
+
+AotRunner::AotRunner(const aot::Program& program)
+	: m_Program(program), m_Index(Memory::MAX_MEM, NONE), m_Checks(program.count)
+{
+	for (u32 i = 0; i < program.count; i++)
+	{
+		m_Index[program.blocks[i].address] = i;
+	}
+}
+
+ExecResult AotRunner::Execute(CPU& cpu, u64 cycles, Memory& ram)
+{
+	if (m_RamId != ram.Id())
+	{
+		Clear();
+		m_RamId = ram.Id();
+	}
+
+	dispatch::Budget budget(cycles, &ram);
+	StopReason reason = StopReason::Budget;
+	bool running = budget.Remaining();
+	while (running)
+	{
+		const aot::Block* block = Lookup(cpu.PC, ram);
+		if (!block)
+		{
+			word pc = cpu.PC;
+			byte ins = dispatch::Fetch(cpu, ram);
+			dispatch::s_Table[ins](cpu, budget.cycles, ram);
+			if (dispatch::s_Traits[ins].endsBlock)
+			{
+				running = !dispatch::Stops(dispatch::EndOf(ins, pc, cpu.PC), cpu, ram, budget, reason);
+			}
+			continue;
+		}
+
+		m_NativeRuns++;
+		if (block->run(cpu, budget.cycles, ram) && block->endsBlock)
+		{
+			running = !dispatch::Stops(block->ending, cpu, ram, budget, reason);
+		}
+	}
+	ram.Flush();
+	return { budget.Used(), reason };
+}
+
+void AotRunner::Clear()
+{
+	std::fill(m_Checks.begin(), m_Checks.end(), Check{});
+	m_RamId = 0;
+}
+
+const aot::Block* AotRunner::Lookup(word pc, Memory& ram)
+{
+	u32 index = m_Index[pc];
+	if (index == NONE)
+	{
+		return nullptr;
+	}
+
+	const aot::Block& block = m_Program.blocks[index];
+	Check& check = m_Checks[index];
+	if (!check.done
+		|| ram.CodeVersion(FirstPage(block)) != check.versions[0]
+		|| ram.CodeVersion(LastPage(block)) != check.versions[1])
+	{
+		Verify(block, check, ram);
+	}
+	return check.matches ? &block : nullptr;
+}
+
+void AotRunner::Verify(const aot::Block& block, Check& check, Memory& ram)
+{
+	byte first = FirstPage(block);
+	byte last = LastPage(block);
+	check.matches = !ram.HasDevice(first) && !ram.HasDevice(last);
+	for (u32 i = 0; check.matches && i < block.length; i++)
+	{
+		check.matches = ram.Read(block.address + i) == block.code[i];
+	}
+
+	// watched either way, so that code written back is seen too
+	ram.WatchCode(first);
+	ram.WatchCode(last);
+	check.versions[0] = ram.CodeVersion(first);
+	check.versions[1] = ram.CodeVersion(last);
+	check.done = true;
+}
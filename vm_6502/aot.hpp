@@ -0,0 +1,77 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include "dispatch.hpp"
+
+/// What code recompiled ahead of time (see Recompile) is made of, and what
+/// runs it.
+///
+/// A recompiled program is a table of basic blocks, cut as in BlockCache,
+/// each a C++ function that runs the block's instructions through
+/// dispatch::HandleDecoded with their operands as constants, so that the
+/// compiler turns it into straight-line native code.
+namespace aot
+{
+	// Runs a block, charging its cycles. False when a write changed a watched
+	// code page before the last instruction, with PC at the next one.
+	using BlockFunction = bool (*)(CPU& cpu, u32& cycles, Memory& ram);
+
+	struct Block
+	{
+		word address;
+		word length;				// bytes of `code`
+		const byte* code;			// the bytes it was compiled from
+		BlockFunction run;
+		bool endsBlock;				// the last instruction ends a block, rather than a page limit
+		dispatch::Ending ending;	// and how
+	};
+
+	struct Program
+	{
+		const Block* blocks;		// by address
+		u32 count;
+	};
+}
+
+/// Runs an aot::Program, an alternative to CPU::Execute for fixed images.
+///
+/// A block runs natively only while memory holds the bytes it was compiled
+/// from and none of its pages has a device. That is checked the first time
+/// the block is entered and again whenever one of its pages changes
+/// (Memory::WatchCode). Anywhere else - code the recompiler did not reach,
+/// such as an RTS into the middle of a block, or code rewritten since -
+/// instructions are fetched and run through the handler table as in
+/// CPU::Execute, so the result is the same either way.
+///
+/// A runner serves one Memory at a time; handing it another checks every
+/// block again.
+struct AotRunner
+{
+	explicit AotRunner(const aot::Program& program);
+
+	/// Same contract as CPU::Execute, without breakpoints.
+	ExecResult Execute(CPU& cpu, u64 cycles, Memory& ram);
+
+	/// Forgets which blocks were checked.
+	void Clear();
+
+	u64 m_NativeRuns = 0;		// blocks run natively
+
+private:
+	struct Check
+	{
+		bool done = false;
+		bool matches = false;		// the block may run natively
+		u32 versions[2] = {};		// CodeVersion() of its first and last page then
+	};
+
+	static constexpr u32 NONE = ~0u;
+
+	const aot::Block* Lookup(word pc, Memory& ram);
+	void Verify(const aot::Block& block, Check& check, Memory& ram);
+
+	const aot::Program& m_Program;
+	std::vector<u32> m_Index;		// block starting at each address, or NONE
+	std::vector<Check> m_Checks;	// by block
+	u64 m_RamId = 0;			// Memory::Id() the blocks were checked against
+};
@@ -0,0 +1,776 @@
+#include <algorithm>
+#include <utility>
+#include "batch.hpp"
+#include "dispatch.hpp"
+
+CpuBatch::CpuBatch(size_t count)
+	: m_Ram(count), m_Budgets(count), PC(count), SP(count), A(count), X(count), Y(count),
+	C(count), I(count), D(count), B(count), V(count), ZN(count),
+	Cycles(count), ReadPages(count), WritePages(count), Next(count), Code(count),
+	m_Slot(count), m_Group(count), m_Position(count), m_Results(count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		m_Slot[i] = m_Position[i] = i;
+		ReadPages[i] = m_Ram[i].ReadPages();
+		WritePages[i] = m_Ram[i].WritePages();
+	}
+}
+
+void CpuBatch::Load(size_t lane, const CPU& cpu)
+{
+	size_t i = m_Position[lane];
+	PC[i] = cpu.PC;
+	SP[i] = cpu.SP;
+	A[i] = cpu.A;
+	X[i] = cpu.X;
+	Y[i] = cpu.Y;
+	C[i] = cpu.C;
+	I[i] = cpu.I;
+	D[i] = cpu.D;
+	B[i] = cpu.B;
+	V[i] = cpu.V;
+	ZN[i] = cpu.ZN;
+}
+
+CPU CpuBatch::Get(size_t lane) const
+{
+	size_t i = m_Position[lane];
+	CPU cpu;
+	cpu.PC = PC[i];
+	cpu.SP = SP[i];
+	cpu.A = A[i];
+	cpu.X = X[i];
+	cpu.Y = Y[i];
+	cpu.C = C[i];
+	cpu.I = I[i];
+	cpu.D = D[i];
+	cpu.B = B[i];
+	cpu.V = V[i];
+	cpu.ZN = ZN[i];
+	return cpu;
+}
+
+void CpuBatch::Execute(u64 cycles)
+{
+	for (size_t lane = 0; lane < Size(); lane++)
+	{
+		m_Budgets[lane] = dispatch::Budget(cycles, &m_Ram[lane]);
+		Cycles[m_Position[lane]] = (int)m_Budgets[lane].cycles;
+	}
+	Run();
+}
+
+void CpuBatch::Execute(const std::vector<u64>& cycles)
+{
+	for (size_t lane = 0; lane < Size(); lane++)
+	{
+		m_Budgets[lane] = dispatch::Budget(cycles[lane], &m_Ram[lane]);
+		Cycles[m_Position[lane]] = (int)m_Budgets[lane].cycles;
+	}
+	Run();
+}
+
+namespace
+{
+	// Reads ahead the opcode at `pc` through a lane's page table, and points
+	// `code` at the instruction when its page holds all three bytes; a
+	// device page is left to the lane's own step, which reads it once.
+	VM_ALWAYS_INLINE void Fetch(word pc, const byte* const* pages, word& opcode, const byte*& code)
+	{
+		const byte* page = pages[pc / Memory::PAGE_SIZE];
+		u32 offset = pc % Memory::PAGE_SIZE;
+		opcode = page ? page[offset] : CpuBatch::UNREAD;
+		code = page && offset <= Memory::PAGE_SIZE - 3 ? page + offset : nullptr;
+	}
+
+	// CpuBatch's arrays as plain pointers, for the lock-step kernels: a store
+	// through one of the vectors could alias all the others as far as the
+	// compiler knows.
+	struct Lanes
+	{
+		word* pc;
+		word* sp;
+		byte* a;
+		byte* x;
+		byte* y;
+		byte* c;
+		byte* i;
+		byte* d;
+		byte* v;
+		word* zn;
+		int64_t* cycles;
+		const byte* const* const* readPages;
+		byte* const* const* writePages;
+		word* next;
+		const byte** code;
+		Memory* ram;
+		const size_t* slot;
+		bool* touched;
+
+		// Memory::Read and Write through lane position `at`'s page tables;
+		// anything they would not take straight goes to the lane's Memory,
+		// asserts included, and is noted in `touched`
+		VM_ALWAYS_INLINE byte Read(size_t at, u32 address) const
+		{
+			const byte* page = address < Memory::MAX_MEM ? readPages[at][address / Memory::PAGE_SIZE] : nullptr;
+			if (page)
+			{
+				return page[address % Memory::PAGE_SIZE];
+			}
+			*touched = true;
+			return ram[slot[at]].Read(address);
+		}
+
+		VM_ALWAYS_INLINE void Write(size_t at, u32 address, byte data) const
+		{
+			byte* page = address < Memory::MAX_MEM ? writePages[at][address / Memory::PAGE_SIZE] : nullptr;
+			if (page)
+			{
+				page[address % Memory::PAGE_SIZE] = data;
+				return;
+			}
+			*touched = true;
+			ram[slot[at]].Write(address, data);
+		}
+
+		// the `bytes` operand bytes of the instruction lane position `at` is at
+		VM_ALWAYS_INLINE word Operand(size_t at, u32 bytes) const
+		{
+			if (const byte* instruction = code[at])
+			{
+				return bytes == 1 ? instruction[1] : (word)(instruction[1] << 8 | instruction[2]);
+			}
+			word high = Read(at, (word)(pc[at] + 1));
+			return bytes == 1 ? high : (word)(high << 8 | Read(at, (word)(pc[at] + 2)));
+		}
+
+		// the effective address of an instruction with `operand`
+		VM_ALWAYS_INLINE u32 Address(size_t at, dispatch::Addressing addressing, word operand) const
+		{
+			switch (addressing)
+			{
+				case dispatch::Addressing::ZeroPageX:
+				case dispatch::Addressing::AbsoluteX:			return operand + x[at];
+				case dispatch::Addressing::ZeroPageY:
+				case dispatch::Addressing::AbsoluteY:			return operand + y[at];
+				case dispatch::Addressing::ZeroPageYWrapped:	return (byte)(operand + y[at]);
+				default:										return operand;
+			}
+		}
+
+		// whether lane position `at` takes a branch on `condition`
+		VM_ALWAYS_INLINE bool Taken(size_t at, dispatch::Condition condition) const
+		{
+			switch (condition)
+			{
+				case dispatch::Condition::CarryClear:		return !c[at];
+				case dispatch::Condition::CarrySet:			return c[at] != 0;
+				case dispatch::Condition::ZeroSet:			return (zn[at] & 0x0FF) == 0;
+				case dispatch::Condition::ZeroClear:		return (zn[at] & 0x0FF) != 0;
+				case dispatch::Condition::NegativeClear:	return (zn[at] & 0x180) == 0;
+				case dispatch::Condition::OverflowClear:	return !v[at];
+				case dispatch::Condition::OverflowSet:		return v[at] != 0;
+			}
+			return false;
+		}
+
+		VM_ALWAYS_INLINE void Fetch(size_t at) const
+		{
+			::Fetch(pc[at], readPages[at], next[at], code[at]);
+		}
+
+		byte* Register(dispatch::Register which) const
+		{
+			return which == dispatch::Register::A ? a : which == dispatch::Register::X ? x : y;
+		}
+	};
+}
+
+void CpuBatch::Run()
+{
+	m_UniformSteps = m_DivergentSteps = 0;
+	for (m_First = 0; m_First < Size(); m_First += TILE)
+	{
+		m_Running = std::min(m_First + TILE, Size());
+		m_Converged = false;
+		// a fresh budget only has an empty slice when there is nothing to run
+		for (size_t i = m_First; i < m_Running;)
+		{
+			if (Cycles[i] <= 0)
+			{
+				m_Results[m_Slot[i]] = {};
+				Retire(i);
+			}
+			else
+			{
+				Fetch(i);
+				i++;
+			}
+		}
+
+		while (m_Running > m_First)
+		{
+			word opcode = m_Converged ? m_Code[0] : Gather();
+			if (opcode != UNREAD && StepUniform((byte)opcode))
+			{
+				m_UniformSteps++;
+				continue;
+			}
+			if (m_Converged)
+			{
+				Diverge();
+			}
+			// backwards, so lanes that stop swap in ones already stepped
+			for (size_t j = m_Grouped; j-- > 0;)
+			{
+				size_t i = m_Group[j];
+				if (StepScalar(i))
+				{
+					Retire(i);
+				}
+				else
+				{
+					Fetch(i);
+				}
+			}
+			m_DivergentSteps++;
+		}
+	}
+}
+
+void CpuBatch::Fetch(size_t i)
+{
+	::Fetch(PC[i], ReadPages[i], Next[i], Code[i]);
+}
+
+// Picks the opcode of the running lane furthest behind, and puts the
+// positions of the lanes at it in m_Group, in order. Branches only go
+// forward, so lanes that took different paths through a block wait for the
+// others at the first address they share. Opcodes were read ahead, when the
+// lanes last stepped: nothing but a lane's own steps changes its memory.
+//
+// Converges the tile instead when all of its lanes are at one instruction
+// of the same page, none with a request for where the block ends (which
+// only an access Memory handles itself could make while converged).
+word CpuBatch::Gather()
+{
+	const word* const pcs = PC.data();
+	const word* const opcodes = Next.data();
+	const byte* const* const code = Code.data();
+	const size_t first = m_First;
+	const size_t running = m_Running;
+
+	size_t behind = first;
+	bool together = code[first] != nullptr;
+	for (size_t i = first + 1; i < running; i++)
+	{
+		behind = pcs[i] < pcs[behind] ? i : behind;
+		together &= pcs[i] == pcs[first] && code[i] == code[first];
+	}
+	if (together)
+	{
+		int64_t least = Cycles[first];
+		for (size_t i = first; i < running && together; i++)
+		{
+			together = !m_Ram[m_Slot[i]].Requested();
+			least = std::min(least, Cycles[i]);
+		}
+		if (together)
+		{
+			m_Converged = true;
+			m_Pc = pcs[first];
+			m_Code = code[first];
+			m_Spent = 0;
+			m_Least = least;
+			m_Touched = false;
+			return opcodes[first];
+		}
+	}
+	word opcode = opcodes[behind];
+
+	size_t* const group = m_Group.data();
+	size_t count = 0;
+	for (size_t i = first; i < running; i++)
+	{
+		group[count] = i;
+		count += opcodes[i] == opcode;
+	}
+	m_Grouped = count;
+	return opcode;
+}
+
+// Leaves the converged state: brings every lane's PC and Cycles up to date,
+// reads ahead their opcodes and puts all of them in the group.
+void CpuBatch::Diverge()
+{
+	m_Grouped = 0;
+	for (size_t i = m_First; i < m_Running; i++)
+	{
+		PC[i] = m_Pc;
+		Cycles[i] -= m_Spent;
+		Fetch(i);
+		m_Group[m_Grouped++] = i;
+	}
+	m_Converged = false;
+}
+
+// Steps lane position `i`; true when the lane stops, with its result recorded.
+bool CpuBatch::StepScalar(size_t i)
+{
+	size_t lane = m_Slot[i];
+	Memory& ram = m_Ram[lane];
+	CPU cpu = Get(lane);
+	u32 cycles = (u32)Cycles[i];
+	word pc = cpu.PC;
+
+	byte ins = dispatch::Fetch(cpu, ram);
+	dispatch::s_Table[ins](cpu, cycles, ram);
+	Load(lane, cpu);
+	Cycles[i] = (int)cycles;
+
+	return dispatch::s_Traits[ins].endsBlock && End(i, dispatch::EndOf(ins, pc, cpu.PC));
+}
+
+// Where the lanes in m_Group have ended a block with a Normal ending: the
+// ones that may stop go through End(), backwards, so those that do swap in
+// ones already done. The rest read ahead their next opcode.
+void CpuBatch::EndBlock()
+{
+	m_Stopping.clear();
+	for (size_t j = 0; j < m_Grouped; j++)
+	{
+		size_t i = m_Group[j];
+		if (dispatch::MayStop(dispatch::Ending::Normal, m_Ram[m_Slot[i]], (u32)Cycles[i]))
+		{
+			m_Stopping.push_back(i);
+		}
+		else
+		{
+			Fetch(i);
+		}
+	}
+	for (size_t j = m_Stopping.size(); j-- > 0;)
+	{
+		size_t i = m_Stopping[j];
+		if (End(i, dispatch::Ending::Normal))
+		{
+			Retire(i);
+		}
+		else
+		{
+			Fetch(i);
+		}
+	}
+}
+
+// Where lane position `i` ends a block: whether it stops, as in
+// dispatch::Stops, with its result recorded. This is the only place lanes
+// stop or take interrupts.
+bool CpuBatch::End(size_t i, dispatch::Ending ending)
+{
+	size_t lane = m_Slot[i];
+	Memory& ram = m_Ram[lane];
+	if (!dispatch::MayStop(ending, ram, (u32)Cycles[i]))
+	{
+		return false;
+	}
+
+	dispatch::Budget& budget = m_Budgets[lane];
+	CPU cpu = Get(lane);
+	budget.cycles = (u32)Cycles[i];
+	StopReason reason = StopReason::Budget;
+	bool stops = dispatch::Stop(ending, cpu, ram, budget, reason);
+	Load(lane, cpu);
+	Cycles[i] = (int)budget.cycles;
+	if (stops)
+	{
+		ram.Flush();
+		m_Results[lane] = { budget.Used(), reason };
+	}
+	return stops;
+}
+
+// Runs `opcode` for the lanes in m_Group, or the whole tile while converged,
+// through its lock-step kernel; false, having changed nothing, when it has
+// none.
+bool CpuBatch::StepUniform(byte opcode)
+{
+	switch (opcode)
+	{
+#define VM_KERNEL(op) case op: return m_Converged ? StepUniform<op, true>() : StepUniform<op, false>();
+		VM_FOR_EACH_OPCODE(VM_KERNEL)
+#undef VM_KERNEL
+	}
+	return false;
+}
+
+// One pass over the lanes with each lane's whole instruction in it. Each
+// kernel mirrors the dispatch.hpp handler its dispatch::Form names, memory
+// accesses in the same order.
+//
+// Per lane, the pass also moves PC past the instruction, charges its cycles
+// and reads ahead the next opcode. Converged, the operand is the same for
+// every lane and all of that is done once, for the tile.
+template <byte Opcode, bool Converged>
+bool CpuBatch::StepUniform()
+{
+	using dispatch::Operation;
+
+	constexpr dispatch::Form form = dispatch::s_Forms[Opcode];
+	constexpr dispatch::Addressing addressing = form.addressing;
+	constexpr u32 bytes = s_Opcodes[Opcode].length - 1u;
+	constexpr u32 cycles = s_Opcodes[Opcode].cycles;
+
+	if constexpr (Converged && (form.operation == Operation::JSR || form.operation == Operation::RTS))
+	{
+		// the lanes' stacks decide where they go
+		Diverge();
+		return StepUniform<Opcode, false>();
+	}
+
+	const Lanes lanes = { PC.data(), SP.data(), A.data(), X.data(), Y.data(), C.data(), I.data(), D.data(), V.data(),
+		ZN.data(), Cycles.data(), ReadPages.data(), WritePages.data(), Next.data(), Code.data(), m_Ram.data(), m_Slot.data(),
+		&m_Touched };
+	const size_t first = m_First;
+	const size_t running = m_Running;
+	const size_t* const group = m_Group.data();
+	const size_t count = m_Grouped;
+	word* const pcs = lanes.pc;
+	word* const zns = lanes.zn;
+	int64_t* const left = lanes.cycles;
+
+	word uniform = 0;
+	if constexpr (Converged && bytes == 1)
+	{
+		uniform = m_Code[1];
+	}
+	else if constexpr (Converged && bytes == 2)
+	{
+		uniform = (word)(m_Code[1] << 8 | m_Code[2]);
+	}
+	auto operand = [&](size_t i) -> word
+	{
+		if constexpr (Converged)
+		{
+			return uniform;
+		}
+		else
+		{
+			return lanes.Operand(i, bytes);
+		}
+	};
+	auto address = [&](size_t i) { return lanes.Address(i, addressing, operand(i)); };
+	// the byte an instruction reads
+	auto data = [&](size_t i) -> byte
+	{
+		if constexpr (addressing == dispatch::Addressing::Immediate)
+		{
+			return (byte)operand(i);
+		}
+		else
+		{
+			return lanes.Read(i, address(i));
+		}
+	};
+
+	// moves the converged tile to `target`, which it stays converged at
+	// while that is on the same page and no lane may have come apart
+	auto move = [&](word target)
+	{
+		word from = m_Pc;
+		m_Pc = target;
+		if (!m_Touched && target / Memory::PAGE_SIZE == from / Memory::PAGE_SIZE
+			&& target % Memory::PAGE_SIZE <= Memory::PAGE_SIZE - 3)
+		{
+			m_Code += target - from;
+		}
+		else
+		{
+			Diverge();
+		}
+	};
+	// runs `body` for each lane, then moves past the instruction
+	auto each = [&](auto body)
+	{
+		if constexpr (Converged)
+		{
+			for (size_t i = first; i < running; i++)
+			{
+				body(i);
+			}
+			m_Spent += cycles;
+			move((word)(m_Pc + bytes + 1));
+		}
+		else
+		{
+			for (size_t j = 0; j < count; j++)
+			{
+				size_t i = group[j];
+				body(i);
+				pcs[i] += bytes + 1;
+				left[i] -= cycles;
+				lanes.Fetch(i);
+			}
+		}
+		return true;
+	};
+	// where the lanes end a block; converged, the tile only has to look
+	// at them when one may be out of cycles
+	auto end = [&]()
+	{
+		if (m_Converged && m_Least - m_Spent > 0)
+		{
+			return true;
+		}
+		if (m_Converged)
+		{
+			Diverge();
+		}
+		EndBlock();
+		return true;
+	};
+
+	if constexpr (form.operation == Operation::Load)
+	{
+		byte* target = lanes.Register(form.reg);
+		return each([&](size_t i)
+		{
+			target[i] = data(i);
+			if constexpr (form.flags == dispatch::LoadFlags::Result)
+			{
+				zns[i] = target[i];
+			}
+		});
+	}
+	else if constexpr (form.operation == Operation::Store)
+	{
+		byte* source = lanes.Register(form.reg);
+		return each([&](size_t i) { lanes.Write(i, address(i), source[i]); });
+	}
+	else if constexpr (form.operation == Operation::ADC || form.operation == Operation::SBC)
+	{
+		constexpr alu::Operation operation = form.operation == Operation::ADC ? alu::ADC : alu::SBC;
+		byte* const as = lanes.a;
+		byte* const cs = lanes.c;
+		byte* const vs = lanes.v;
+		return each([&](size_t i)
+		{
+			byte value = data(i);
+			if (lanes.d[i])
+			{
+				alu::Entry entry = alu::Execute(operation, as[i], value, cs[i], lanes.d[i]);
+				as[i] = alu::Result(entry);
+				cs[i] = alu::Carry(entry);
+				vs[i] = alu::Overflow(entry);
+				zns[i] = alu::ZN(entry);
+				return;
+			}
+			// alu::Add in binary
+			if constexpr (operation == alu::SBC)
+			{
+				value = (byte)~value;
+			}
+			u32 sum = as[i] + value + cs[i];
+			vs[i] = ((as[i] ^ sum) & (value ^ sum) & 0x80) != 0;
+			cs[i] = sum > 0xFF;
+			as[i] = (byte)sum;
+			zns[i] = (byte)sum;
+		});
+	}
+	else if constexpr (form.operation == Operation::AND)
+	{
+		return each([&](size_t i) { lanes.a[i] &= data(i); zns[i] = lanes.a[i]; });
+	}
+	else if constexpr (form.operation == Operation::ORA)
+	{
+		return each([&](size_t i) { lanes.a[i] |= data(i); zns[i] = lanes.a[i]; });
+	}
+	else if constexpr (form.operation == Operation::EOR)
+	{
+		return each([&](size_t i) { lanes.a[i] ^= data(i); zns[i] = lanes.a[i]; });
+	}
+	else if constexpr (form.operation == Operation::Compare)
+	{
+		byte* source = lanes.Register(form.reg);
+		return each([&](size_t i)
+		{
+			byte value = data(i);
+			zns[i] = (byte)(value - source[i]);
+			lanes.c[i] = source[i] >= value;
+		});
+	}
+	else if constexpr (form.operation == Operation::INC || form.operation == Operation::DEC)
+	{
+		constexpr byte delta = form.operation == Operation::INC ? 1 : 0xFF;
+		return each([&](size_t i)
+		{
+			u32 target = address(i);
+			byte value = (byte)(lanes.Read(i, target) + delta);
+			zns[i] = value;
+			lanes.Write(i, target, value);
+		});
+	}
+	else if constexpr (form.operation == Operation::INX)
+	{
+		return each([&](size_t i) { lanes.x[i]++; });
+	}
+	else if constexpr (form.operation == Operation::INY)
+	{
+		return each([&](size_t i) { lanes.y[i]++; });
+	}
+	else if constexpr (form.operation == Operation::DEX)
+	{
+		return each([&](size_t i) { lanes.x[i]--; zns[i] = lanes.x[i]; });
+	}
+	else if constexpr (form.operation == Operation::DEY)
+	{
+		return each([&](size_t i) { lanes.y[i]--; zns[i] = lanes.y[i]; });
+	}
+	else if constexpr (form.operation == Operation::CLC)
+	{
+		return each([&](size_t i) { lanes.c[i] = 0; });
+	}
+	else if constexpr (form.operation == Operation::CLD)
+	{
+		return each([&](size_t i) { lanes.d[i] = 0; });
+	}
+	else if constexpr (form.operation == Operation::SED)
+	{
+		return each([&](size_t i) { lanes.d[i] = 1; });
+	}
+	else if constexpr (form.operation == Operation::CLV)
+	{
+		return each([&](size_t i) { lanes.v[i] = 0; });
+	}
+	else if constexpr (form.operation == Operation::CLI)
+	{
+		return each([&](size_t i) { lanes.i[i] = 0; });
+	}
+	else if constexpr (form.operation == Operation::SEI)
+	{
+		return each([&](size_t i) { lanes.i[i] = 1; });
+	}
+	else if constexpr (form.operation == Operation::NOP)
+	{
+		return each([](size_t) {});
+	}
+	// the rest end the block
+	else if constexpr (form.operation == Operation::Branch && Converged)
+	{
+		bool take = lanes.Taken(first, form.condition);
+		bool agree = true;
+		for (size_t i = first + 1; i < running; i++)
+		{
+			agree &= lanes.Taken(i, form.condition) == take;
+		}
+		if (!agree)
+		{
+			Diverge();
+			return StepUniform<Opcode, false>();
+		}
+		m_Spent += cycles + take;
+		move((word)(m_Pc + 2 + (take ? (byte)uniform : 0)));
+		return end();
+	}
+	else if constexpr (form.operation == Operation::Branch)
+	{
+		for (size_t j = 0; j < count; j++)
+		{
+			size_t i = group[j];
+			bool take = lanes.Taken(i, form.condition);
+			pcs[i] += 2 + (take ? (byte)operand(i) : 0);
+			left[i] -= cycles + take;
+		}
+		return end();
+	}
+	else if constexpr (form.operation == Operation::JMP && Converged)
+	{
+		// a halt is left to the lane's own step
+		if (uniform == m_Pc)
+		{
+			return false;
+		}
+		m_Spent += cycles;
+		move(uniform);
+		return end();
+	}
+	else if constexpr (form.operation == Operation::JMP)
+	{
+		for (size_t j = 0; j < count; j++)
+		{
+			if (operand(group[j]) == pcs[group[j]])
+			{
+				return false;
+			}
+		}
+		for (size_t j = 0; j < count; j++)
+		{
+			size_t i = group[j];
+			pcs[i] = operand(i);
+			left[i] -= cycles;
+		}
+		return end();
+	}
+	else if constexpr (form.operation == Operation::JSR)
+	{
+		// pushed before the operand is fetched, which may be over it
+		word* const sps = lanes.sp;
+		for (size_t j = 0; j < count; j++)
+		{
+			size_t i = group[j];
+			word pc = pcs[i];
+			sps[i] += 2;
+			lanes.Write(i, sps[i], (byte)(pc >> 8));
+			lanes.Write(i, sps[i] + 1u, (byte)pc);
+			pcs[i] = (word)(lanes.Read(i, (word)(pc + 1)) << 8 | lanes.Read(i, (word)(pc + 2)));
+			left[i] -= cycles;
+		}
+		return end();
+	}
+	else if constexpr (form.operation == Operation::RTS)
+	{
+		word* const sps = lanes.sp;
+		for (size_t j = 0; j < count; j++)
+		{
+			size_t i = group[j];
+			pcs[i] = (word)(lanes.Read(i, sps[i]) << 8 | lanes.Read(i, sps[i] + 1u));
+			sps[i] += 2;
+			left[i] -= cycles;
+		}
+		return end();
+	}
+	else
+	{
+		// the stack and interrupt operations step lane by lane
+		return false;
+	}
+}
+
+void CpuBatch::Swap(size_t i, size_t j)
+{
+	std::swap(PC[i], PC[j]);
+	std::swap(SP[i], SP[j]);
+	std::swap(A[i], A[j]);
+	std::swap(X[i], X[j]);
+	std::swap(Y[i], Y[j]);
+	std::swap(C[i], C[j]);
+	std::swap(I[i], I[j]);
+	std::swap(D[i], D[j]);
+	std::swap(B[i], B[j]);
+	std::swap(V[i], V[j]);
+	std::swap(ZN[i], ZN[j]);
+	std::swap(Cycles[i], Cycles[j]);
+	std::swap(ReadPages[i], ReadPages[j]);
+	std::swap(WritePages[i], WritePages[j]);
+	std::swap(Next[i], Next[j]);
+	std::swap(Code[i], Code[j]);
+	std::swap(m_Slot[i], m_Slot[j]);
+	m_Position[m_Slot[i]] = i;
+	m_Position[m_Slot[j]] = j;
+}
+
+void CpuBatch::Retire(size_t i)
+{
+	Swap(i, --m_Running);
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "dispatch.hpp"
+
+/// Runs many independent CPU/Memory pairs in lock-step.
+///
+/// Registers live in structure-of-arrays form, and the lanes run TILE at a
+/// time, each tile until all of its lanes stop. Each step runs the lanes at
+/// the next opcode of the one furthest behind, whatever address each is at;
+/// lanes that branched apart wait where their paths meet again. When the
+/// opcode has a lock-step kernel (see StepUniform) that is one pass over the
+/// lanes; otherwise each executes its instruction through the dispatch
+/// table.
+///
+/// While every lane of the tile is at the same address of one shared code
+/// page (forks of one program, see Memory), the tile is converged: the
+/// instruction is read once for all of them, PC and the cycles used are
+/// kept once for the tile, and the kernels are plain loops over the
+/// register arrays. Anything that may make a lane differ, from a branch
+/// the lanes disagree on to any access Memory has to handle itself, puts
+/// the tile back to per-lane steps until the lanes meet again.
+///
+/// The cycles left in each lane's slice are a plain array as well; the
+/// lane's dispatch::Budget only hears of them where a block ends and it may
+/// stop, and for the per-lane steps.
+///
+/// Lanes that stop are retired to the back of their tile, so the running
+/// ones always occupy [m_First, m_Running).
+struct CpuBatch
+{
+	explicit CpuBatch(size_t count);
+
+	size_t Size() const { return m_Slot.size(); }
+
+	/// Memory of lane `lane` (stable for the lifetime of the batch).
+	Memory& Ram(size_t lane) { return m_Ram[lane]; }
+
+	void Load(size_t lane, const CPU& cpu);
+	CPU Get(size_t lane) const;
+
+	/// Runs every lane as CPU::Execute would with a budget of `cycles`, each
+	/// stopping on its own.
+	void Execute(u64 cycles);
+	/// Same as above with a separate budget per lane.
+	void Execute(const std::vector<u64>& cycles);
+
+	/// How lane `lane` stopped during the last Execute.
+	const ExecResult& Result(size_t lane) const { return m_Results[lane]; }
+
+	/// Opcode of a lane whose next instruction is on a device page, which
+	/// is not read ahead.
+	static constexpr word UNREAD = 0x100;
+
+	static constexpr size_t TILE = 16;
+
+	/// Number of steps taken by a lock-step kernel vs. per lane during the
+	/// last Execute.
+	size_t m_UniformSteps = 0;
+	size_t m_DivergentSteps = 0;
+
+private:
+	void Run();
+	void Fetch(size_t i);
+	word Gather();
+	void Diverge();
+	void EndBlock();
+	bool StepUniform(byte opcode);
+	template <byte Opcode, bool Converged> bool StepUniform();
+	bool StepScalar(size_t i);
+	bool End(size_t i, dispatch::Ending ending);
+	void Swap(size_t i, size_t j);
+	void Retire(size_t i);
+
+	std::vector<Memory> m_Ram;
+	std::vector<dispatch::Budget> m_Budgets;	// by lane
+
+	// indexed by position, not by lane; PC and Cycles lag while converged
+	std::vector<word> PC, SP;
+	std::vector<byte> A, X, Y;
+	std::vector<byte> C, I, D, B, V;
+	std::vector<word> ZN;
+	std::vector<int64_t> Cycles;			// left in the lane's slice, Budget::cycles
+	std::vector<const byte* const*> ReadPages;	// Memory::ReadPages() of the lane
+	std::vector<byte* const*> WritePages;	// and WritePages()
+	std::vector<word> Next;				// opcode of the next instruction, read ahead, or UNREAD
+	std::vector<const byte*> Code;			// the next instruction, when its page holds all three bytes
+	std::vector<size_t> m_Slot;		// position -> lane
+	std::vector<size_t> m_Group;	// positions of the lanes the step runs, m_Grouped of them
+	std::vector<size_t> m_Stopping;	// and of those that may stop where it ends a block
+
+	std::vector<size_t> m_Position;	// lane -> position
+	std::vector<ExecResult> m_Results;	// by lane
+	size_t m_First = 0;		// of the tile running
+	size_t m_Running = 0;
+	size_t m_Grouped = 0;
+
+	// the tile while converged
+	bool m_Converged = false;
+	word m_Pc = 0;
+	const byte* m_Code = nullptr;	// the instruction at m_Pc
+	int64_t m_Spent = 0;			// cycles since the tile converged
+	int64_t m_Least = 0;			// the fewest any lane had left then
+	bool m_Touched = false;			// an access went to a lane's Memory
+};
@@ -0,0 +1,157 @@
+#include "block.hpp"
+
+ExecResult BlockCache::Execute(CPU& cpu, u64 cycles, Memory& ram)
+{
+	if (m_RamId != ram.Id())
+	{
+		Clear();
+		m_RamId = ram.Id();
+	}
+
+	dispatch::Budget budget(cycles, &ram);
+	StopReason reason = StopReason::Budget;
+	bool running = budget.Remaining();
+	while (running)
+	{
+		const Block* block = Lookup(cpu.PC, ram);
+		if (!block)
+		{
+			word pc = cpu.PC;
+			byte ins = dispatch::Fetch(cpu, ram);
+			dispatch::s_Table[ins](cpu, budget.cycles, ram);
+			if (dispatch::s_Traits[ins].endsBlock)
+			{
+				running = !dispatch::Stops(dispatch::EndOf(ins, pc, cpu.PC), cpu, ram, budget, reason);
+			}
+			continue;
+		}
+
+		u32 epoch = ram.CodeEpoch();
+		size_t count = block->ops.size();
+		size_t i = 0;
+		while (i < count)
+		{
+			const MicroOp& op = block->ops[i++];
+			cpu.PC = op.next;
+			op.run(cpu, op.operand, budget.cycles, ram);
+
+			// code may have been overwritten, so look the rest up again
+			if (ram.CodeEpoch() != epoch)
+			{
+				break;
+			}
+		}
+		m_Dispatched += i;
+
+		// stop where Execute() would
+		if (i == count && block->endsBlock)
+		{
+			running = !dispatch::Stops(block->ending, cpu, ram, budget, reason);
+		}
+	}
+	ram.Flush();
+	return { budget.Used(), reason };
+}
+
+void BlockCache::Clear()
+{
+	for (auto& page : m_Pages)
+	{
+		page.reset();
+	}
+	m_RamId = 0;
+}
+
+const BlockCache::Block* BlockCache::Lookup(word pc, Memory& ram)
+{
+	std::unique_ptr<BlockPage>& page = m_Pages[pc / Memory::PAGE_SIZE];
+	if (!page)
+	{
+		page = std::make_unique<BlockPage>();
+	}
+
+	Block& block = (*page)[pc % Memory::PAGE_SIZE];
+	if (block.ops.empty() || !IsCurrent(block, ram))
+	{
+		Decode(block, pc, ram);
+	}
+	return block.ops.empty() ? nullptr : &block;
+}
+
+void BlockCache::Decode(Block& block, word pc, Memory& ram)
+{
+	block.ops.clear();
+	block.endsBlock = false;
+	block.firstPage = block.lastPage = (byte)(pc / Memory::PAGE_SIZE);
+
+	// a block spans at most two pages, neither of them a device page
+	auto decodable = [&](u32 address)
+	{
+		u32 page = address / Memory::PAGE_SIZE;
+		return address < Memory::MAX_MEM && page <= block.firstPage + 1u && !ram.HasDevice(page);
+	};
+
+	u32 address = pc;
+	byte previous = 0;
+	bool fusible = false;		// the last op is a lone instruction, `previous`
+	while (decodable(address))
+	{
+		byte opcode = ram.Read(address);
+		const dispatch::Decoding& decoding = dispatch::s_Decoding[opcode];
+		u32 last = address + decoding.length - 1;
+		if (!decodable(last))
+		{
+			break;
+		}
+
+		MicroOp op;
+		op.run = decoding.run;
+		op.operand = 0;
+		for (u32 i = 1; i < decoding.length; i++)
+		{
+			op.operand = (word)(op.operand << 8) | ram.Read(address + i);
+		}
+		op.next = (word)(address + decoding.length);
+
+		dispatch::DecodedHandler fused = m_Fuse && fusible ? dispatch::Fused(previous, opcode) : nullptr;
+		if (fused)
+		{
+			MicroOp& pair = block.ops.back();
+			pair.run = fused;
+			pair.operand = (word)(pair.operand << (8 * (decoding.length - 1)) | op.operand);
+			pair.next = op.next;
+			fusible = false;
+		}
+		else
+		{
+			block.ops.push_back(op);
+			previous = opcode;
+			fusible = true;
+		}
+
+		block.lastPage = (byte)(last / Memory::PAGE_SIZE);
+		if (decoding.endsBlock)
+		{
+			// only a JMP's ending depends on where it goes, which is its operand
+			block.endsBlock = true;
+			block.ending = dispatch::EndOf(opcode, (word)address, op.operand);
+			break;
+		}
+		address += decoding.length;
+	}
+
+	if (!block.ops.empty())
+	{
+		ram.WatchCode(block.firstPage);
+		ram.WatchCode(block.lastPage);
+		block.versions[0] = ram.CodeVersion(block.firstPage);
+		block.versions[1] = ram.CodeVersion(block.lastPage);
+		m_Decoded++;
+	}
+}
+
+bool BlockCache::IsCurrent(const Block& block, const Memory& ram) const
+{
+	return ram.CodeVersion(block.firstPage) == block.versions[0]
+		&& ram.CodeVersion(block.lastPage) == block.versions[1];
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <array>
+#include <memory>
+#include <vector>
+#include "dispatch.hpp"
+
+/// Decoded basic-block cache, an alternative to CPU::Execute for code that
+/// loops.
+///
+/// A block is the straight run of instructions starting at some PC, up to and
+/// including the first branch, JMP, JSR, RTS, BRK, RTI or invalid opcode. It is
+/// decoded once into MicroOps that carry their operand already assembled and
+/// is replayed from there until one of the (at most two) pages it was decoded
+/// from changes, which Memory reports through WatchCode()/CodeVersion().
+/// Instructions on device pages are never decoded; they are fetched and run
+/// through the handler table as in CPU::Execute.
+///
+/// Pairs listed in dispatch::FUSIONS are decoded into a single MicroOp, one
+/// dispatch instead of two, unless m_Fuse is cleared.
+///
+/// A cache serves one Memory at a time; handing it another drops every block.
+struct BlockCache
+{
+	struct MicroOp
+	{
+		dispatch::DecodedHandler run;
+		word operand;	// both operands, for a fused pair
+		word next;		// PC after the instruction's bytes
+	};
+
+	struct Block
+	{
+		std::vector<MicroOp> ops;	// empty until decoded, and for code that can't be
+		byte firstPage = 0;
+		byte lastPage = 0;
+		u32 versions[2] = {};		// CodeVersion() of firstPage and lastPage
+		bool endsBlock = false;		// the last op ends a block, rather than a page limit
+		dispatch::Ending ending = dispatch::Ending::Normal;		// and how
+	};
+
+	/// Same contract as CPU::Execute, without breakpoints.
+	ExecResult Execute(CPU& cpu, u64 cycles, Memory& ram);
+
+	void Clear();
+
+	bool m_Fuse = true;			// decode dispatch::FUSIONS as one MicroOp; Clear() to redecode
+	u64 m_Decoded = 0;			// blocks decoded so far, including re-decodes
+	u64 m_Dispatched = 0;		// MicroOps run, a fused pair counting once
+
+private:
+	const Block* Lookup(word pc, Memory& ram);
+	void Decode(Block& block, word pc, Memory& ram);
+	bool IsCurrent(const Block& block, const Memory& ram) const;
+
+	using BlockPage = std::array<Block, Memory::PAGE_SIZE>;
+
+	std::unique_ptr<BlockPage> m_Pages[Memory::PAGE_COUNT];
+	u64 m_RamId = 0;			// Memory::Id() the blocks were decoded from, 0 for none
+};
@@ -1,8 +1,948 @@
 #include "compiler.hpp"
+#include <algorithm>
+#include <bitset>
+#include <cstdio>
+#include <iterator>
+#include <unordered_map>
+#include <utility>
+#include "cpu.hpp"
+#include "opcodes.hpp"
 
-std::vector<std::string> compile(std::string source)
+namespace
 {
-	std::vector<std::string> compiled;
+	using Mode = AddressMode;
 
-	return compiled;
-}
\ No newline at end of file
+	constexpr size_t MODE_COUNT = ADDRESS_MODE_COUNT;
+
+	// other names instructions are written with, besides their s_Opcodes mnemonic
+	struct Alias
+	{
+		char name[4];
+		char mnemonic[4];
+	};
+
+	constexpr Alias ALIASES[] =
+	{
+		{ "STA", "SDA" },
+		{ "STX", "SDX" },
+	};
+
+	char Upper(char c)
+	{
+		return c >= 'a' && c <= 'z' ? c - 'a' + 'A' : c;
+	}
+
+	bool SameName(std::string_view a, std::string_view b)
+	{
+		if (a.size() != b.size())
+		{
+			return false;
+		}
+		for (size_t i = 0; i < a.size(); i++)
+		{
+			if (Upper(a[i]) != Upper(b[i]))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// three letters packed into an int, upper-cased; 0 for anything else
+	u32 MnemonicKey(std::string_view name)
+	{
+		if (name.size() != 3)
+		{
+			return 0;
+		}
+		return Upper(name[0]) << 16 | Upper(name[1]) << 8 | Upper(name[2]);
+	}
+
+	struct Mnemonic
+	{
+		u32 key;
+		short opcodes[MODE_COUNT];	// by Mode, -1 where there is none
+
+		bool Has(Mode mode) const { return opcodes[(size_t)mode] >= 0; }
+	};
+
+	const Mnemonic* FindMnemonic(std::string_view name)
+	{
+		static const std::vector<Mnemonic> table = []
+		{
+			std::vector<Mnemonic> table;
+			auto add = [&table](std::string_view name, Mode mode, byte opcode)
+			{
+				u32 key = MnemonicKey(name);
+				auto it = std::find_if(table.begin(), table.end(), [key](const Mnemonic& m) { return m.key == key; });
+				if (it == table.end())
+				{
+					Mnemonic mnemonic{ key, {} };
+					std::fill(std::begin(mnemonic.opcodes), std::end(mnemonic.opcodes), -1);
+					it = table.insert(table.end(), mnemonic);
+				}
+				it->opcodes[(size_t)mode] = opcode;
+			};
+			for (u32 opcode = 0; opcode < 256; opcode++)
+			{
+				const OpcodeInfo& info = s_Opcodes[opcode];
+				if (!info.Valid())
+				{
+					continue;
+				}
+				add(info.mnemonic, info.mode, (byte)opcode);
+				for (const Alias& alias : ALIASES)
+				{
+					if (std::string_view(alias.mnemonic) == info.mnemonic)
+					{
+						add(alias.name, info.mode, (byte)opcode);
+					}
+				}
+			}
+			std::sort(table.begin(), table.end(), [](const Mnemonic& a, const Mnemonic& b) { return a.key < b.key; });
+			return table;
+		}();
+
+		u32 key = MnemonicKey(name);
+		auto it = std::lower_bound(table.begin(), table.end(), key, [](const Mnemonic& m, u32 key) { return m.key < key; });
+		return it != table.end() && it->key == key ? &*it : nullptr;
+	}
+
+	/* LEXER */
+
+	enum class Kind : byte
+	{
+		End,
+		Newline,
+		Identifier,
+		Directive,		// `.name`, text includes the dot
+		Number,			// also 'c'haracters
+		String,			// text is between the quotes, escapes not yet decoded
+		Operator,		// punctuation, text is one or two characters
+		Invalid,		// stands in for the rest of a line the lexer gave up on
+	};
+
+	struct Token
+	{
+		Kind kind;
+		u32 line;
+		long long value;
+		std::string_view text;
+
+		bool Is(std::string_view op) const { return kind == Kind::Operator && text == op; }
+	};
+
+	bool IsIdentifierStart(char c)
+	{
+		return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+	}
+
+	bool IsIdentifierChar(char c)
+	{
+		return IsIdentifierStart(c) || (c >= '0' && c <= '9');
+	}
+
+	int DigitValue(char c)
+	{
+		if (c >= '0' && c <= '9') return c - '0';
+		if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+		if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+		return 99;
+	}
+
+	// Decodes the character at source[i] (after a backslash if there is one)
+	// and advances past it; -1 for an unknown escape.
+	int Character(std::string_view source, size_t& i)
+	{
+		char c = source[i++];
+		if (c != '\\' || i == source.size())
+		{
+			return (byte)c;
+		}
+		switch (source[i++])
+		{
+			case 'n':	return '\n';
+			case 'r':	return '\r';
+			case 't':	return '\t';
+			case '0':	return 0;
+			case '\\':	return '\\';
+			case '\'':	return '\'';
+			case '"':	return '"';
+			default:	return -1;
+		}
+	}
+
+	struct Error
+	{
+		u32 line;
+		std::string message;
+	};
+
+	std::vector<Token> Tokenize(std::string_view source, std::vector<Error>& errors)
+	{
+		std::vector<Token> tokens;
+		tokens.reserve(source.size() / 3 + 1);
+
+		u32 line = 1;
+		size_t i = 0;
+		auto push = [&](Kind kind, size_t begin, long long value = 0)
+		{
+			tokens.push_back({ kind, line, value, source.substr(begin, i - begin) });
+		};
+		auto fail = [&](std::string message)
+		{
+			errors.push_back({ line, std::move(message) });
+			size_t begin = i;
+			while (i < source.size() && source[i] != '\n')
+			{
+				i++;
+			}
+			push(Kind::Invalid, begin);
+		};
+		auto number = [&](size_t begin, int base)
+		{
+			long long value = 0;
+			size_t digits = i;
+			while (i < source.size() && DigitValue(source[i]) < base)
+			{
+				value = std::min(value * base + DigitValue(source[i]), 0x7FFFFFFFLL);
+				i++;
+			}
+			if (i == digits || (i < source.size() && IsIdentifierChar(source[i])))
+			{
+				fail("malformed number");
+				return;
+			}
+			push(Kind::Number, begin, value);
+		};
+
+		// `%` after a value is the remainder operator, elsewhere it starts a binary number
+		auto afterValue = [&]
+		{
+			size_t n = tokens.size();
+			if (n == 0)
+			{
+				return false;
+			}
+			const Token& last = tokens[n - 1];
+			if (last.kind == Kind::Number || last.Is(")"))
+			{
+				return true;
+			}
+			// the first name on a line is a label or mnemonic
+			return last.kind == Kind::Identifier && n >= 2 && tokens[n - 2].kind != Kind::Newline && !tokens[n - 2].Is(":");
+		};
+
+		while (i < source.size())
+		{
+			size_t begin = i;
+			char c = source[i];
+
+			if (c == '\n')
+			{
+				i++;
+				push(Kind::Newline, begin);
+				line++;
+			}
+			else if (c == ' ' || c == '\t' || c == '\r')
+			{
+				i++;
+			}
+			else if (c == ';')
+			{
+				while (i < source.size() && source[i] != '\n')
+				{
+					i++;
+				}
+			}
+			else if (IsIdentifierStart(c) || (c == '.' && i + 1 < source.size() && IsIdentifierStart(source[i + 1])))
+			{
+				i++;
+				while (i < source.size() && IsIdentifierChar(source[i]))
+				{
+					i++;
+				}
+				push(c == '.' ? Kind::Directive : Kind::Identifier, begin);
+			}
+			else if (c == '0' && i + 1 < source.size() && (source[i + 1] == 'x' || source[i + 1] == 'X'))
+			{
+				i += 2;
+				number(begin, 16);
+			}
+			else if (c >= '0' && c <= '9')
+			{
+				number(begin, 10);
+			}
+			else if (c == '$')
+			{
+				i++;
+				number(begin, 16);
+			}
+			else if (c == '%' && i + 1 < source.size() && (source[i + 1] == '0' || source[i + 1] == '1') && !afterValue())
+			{
+				i++;
+				number(begin, 2);
+			}
+			else if (c == '\'')
+			{
+				i++;
+				int value = i < source.size() && source[i] != '\n' ? Character(source, i) : -1;
+				if (value < 0 || i >= source.size() || source[i] != '\'')
+				{
+					fail("malformed character");
+					continue;
+				}
+				i++;
+				push(Kind::Number, begin, value);
+			}
+			else if (c == '"')
+			{
+				i++;
+				bool valid = true;
+				while (i < source.size() && source[i] != '"' && source[i] != '\n')
+				{
+					valid &= Character(source, i) >= 0;
+				}
+				if (!valid || i >= source.size() || source[i] != '"')
+				{
+					fail(valid ? "unterminated string" : "unknown escape in string");
+					continue;
+				}
+				tokens.push_back({ Kind::String, line, 0, source.substr(begin + 1, i - begin - 1) });
+				i++;
+			}
+			else if ((c == '<' || c == '>') && i + 1 < source.size() && source[i + 1] == c)
+			{
+				i += 2;
+				push(Kind::Operator, begin);
+			}
+			else if (std::string_view("#,()+-*/%&|^~<>=:").find(c) != std::string_view::npos)
+			{
+				i++;
+				push(Kind::Operator, begin);
+			}
+			else
+			{
+				i++;
+				fail(std::string("unexpected character '") + c + "'");
+			}
+		}
+
+		size_t end = i;
+		push(Kind::End, end);
+		return tokens;
+	}
+
+	/* ASSEMBLER */
+
+	struct Value
+	{
+		long long value = 0;
+		bool known = true;		// false for symbols not defined yet on the first pass
+	};
+
+	struct Definition
+	{
+		long long value;
+		bool label;
+	};
+
+	std::string Hex(long long value)
+	{
+		char text[24];
+		std::snprintf(text, sizeof(text), value < 0 ? "-$%llX" : "$%04llX", value < 0 ? -value : value);
+		return text;
+	}
+
+	struct Assembler
+	{
+		explicit Assembler(std::string_view source)
+			: m_Tokens(Tokenize(source, m_Errors)), m_Modes(m_Tokens.size()), m_Image(Memory::MAX_MEM)
+		{
+			size_t definitions = 0;
+			for (size_t i = 0; i + 1 < m_Tokens.size(); i++)
+			{
+				definitions += m_Tokens[i].kind == Kind::Identifier && (m_Tokens[i + 1].Is(":") || m_Tokens[i + 1].Is("="));
+			}
+			m_Symbols.reserve(definitions);
+		}
+
+		Assembly Run()
+		{
+			for (m_Pass = 1; m_Pass <= 2; m_Pass++)
+			{
+				m_Next = 0;
+				m_PC = 0;
+				while (Peek().kind != Kind::End)
+				{
+					Statement();
+				}
+			}
+			return Result();
+		}
+
+	private:
+		const Token& Peek(size_t ahead = 0) const
+		{
+			return m_Tokens[std::min(m_Next + ahead, m_Tokens.size() - 1)];
+		}
+
+		const Token& Next()
+		{
+			const Token& token = Peek();
+			if (token.kind != Kind::End)
+			{
+				m_Next++;
+			}
+			return token;
+		}
+
+		bool AtEndOfLine() const
+		{
+			return Peek().kind == Kind::Newline || Peek().kind == Kind::End;
+		}
+
+		// Records an error found on the second pass, or on either pass when
+		// `always` (for those the second pass can no longer see). Only the first
+		// error on a line is kept, and none on a line the lexer rejected.
+		void Report(const Token& at, std::string message, bool always = false)
+		{
+			if (!m_Reported && at.kind != Kind::Invalid && (m_Pass == 2 || always))
+			{
+				m_Errors.push_back({ at.line, std::move(message) });
+			}
+			m_Reported = true;
+		}
+
+		// Reports a syntax error: the rest of the line is skipped.
+		void Fail(const Token& at, std::string message, bool always = false)
+		{
+			Report(at, std::move(message), always);
+			m_Failed = true;
+		}
+
+		void Statement()
+		{
+			m_Failed = false;
+			m_Reported = false;
+
+			if (Peek().kind == Kind::Identifier && Peek(1).Is(":"))
+			{
+				Define(Next(), { (long long)m_PC }, true);
+				Next();
+			}
+
+			if (Peek().kind == Kind::Identifier && Peek(1).Is("="))
+			{
+				const Token& name = Next();
+				Next();
+				Value value = Expression();
+				if (!m_Failed)
+				{
+					Define(name, value, false);
+				}
+			}
+			else if (Peek().kind == Kind::Directive)
+			{
+				Directive();
+			}
+			else if (Peek().kind == Kind::Identifier)
+			{
+				Instruction();
+			}
+
+			if (!m_Failed && !AtEndOfLine())
+			{
+				Fail(Peek(), "unexpected '" + std::string(Peek().text) + "'");
+			}
+			while (!AtEndOfLine())
+			{
+				Next();
+			}
+			Next();
+		}
+
+		void Define(const Token& name, Value value, bool label)
+		{
+			if (!value.known)
+			{
+				return;		// a constant built from later labels, defined on the second pass
+			}
+
+			// the second pass meets every name again; only a clash on the first one is an error
+			auto [it, added] = m_Symbols.try_emplace(name.text, Definition{ value.value, label });
+			if (!added && m_Pass == 1)
+			{
+				m_Errors.push_back({ name.line, "'" + std::string(name.text) + "' is already defined" });
+			}
+			else if (!added && it->second.label == label)
+			{
+				it->second.value = value.value;
+			}
+		}
+
+		/* EXPRESSIONS */
+
+		static int Precedence(const Token& token)
+		{
+			if (token.kind != Kind::Operator)
+			{
+				return 0;
+			}
+			switch (token.text[0])
+			{
+				case '|':	return 1;
+				case '^':	return 2;
+				case '&':	return 3;
+				case '<':
+				case '>':	return token.text.size() == 2 ? 4 : 0;
+				case '+':
+				case '-':	return 5;
+				case '*':
+				case '/':
+				case '%':	return 6;
+				default:	return 0;
+			}
+		}
+
+		Value Expression(int minimum = 1)
+		{
+			Value left = Unary();
+			while (!m_Failed)
+			{
+				const Token& op = Peek();
+				int precedence = Precedence(op);
+				if (precedence < minimum)
+				{
+					break;
+				}
+				Next();
+				Value right = Expression(precedence + 1);
+				left = Apply(op, left, right);
+			}
+			return left;
+		}
+
+		Value Apply(const Token& op, Value left, Value right)
+		{
+			Value result{ 0, left.known && right.known };
+			if (!result.known)
+			{
+				return result;
+			}
+
+			long long a = left.value;
+			long long b = right.value;
+			switch (op.text[0])
+			{
+				case '|':	result.value = a | b; break;
+				case '^':	result.value = a ^ b; break;
+				case '&':	result.value = a & b; break;
+				case '<':	result.value = b < 32 && b >= 0 ? a << b : 0; break;
+				case '>':	result.value = b < 32 && b >= 0 ? a >> b : 0; break;
+				case '+':	result.value = a + b; break;
+				case '-':	result.value = a - b; break;
+				case '*':	result.value = a * b; break;
+				case '/':
+				case '%':
+					if (b == 0)
+					{
+						Report(op, "division by zero");
+						break;
+					}
+					result.value = op.text[0] == '/' ? a / b : a % b;
+					break;
+			}
+			result.value = std::clamp(result.value, -0x7FFFFFFFLL, 0x7FFFFFFFLL);
+			return result;
+		}
+
+		Value Unary()
+		{
+			const Token& token = Peek();
+			switch (token.kind)
+			{
+				case Kind::Number:
+					Next();
+					return { token.value };
+
+				case Kind::Identifier:
+				{
+					Next();
+					auto it = m_Symbols.find(token.text);
+					if (it != m_Symbols.end())
+					{
+						return { it->second.value };
+					}
+					if (m_Pass == 1)
+					{
+						return { 0, false };
+					}
+					Report(token, "undefined symbol '" + std::string(token.text) + "'");
+					return {};
+				}
+
+				case Kind::Operator:
+				{
+					if (std::string_view("*(-~<>").find(token.text) == std::string_view::npos)
+					{
+						break;
+					}
+					Next();
+					if (token.Is("*"))
+					{
+						return { (long long)m_PC };
+					}
+					if (token.Is("("))
+					{
+						Value value = Expression();
+						if (!m_Failed && !Next().Is(")"))
+						{
+							Fail(token, "missing ')'");
+						}
+						return value;
+					}
+
+					Value value = Unary();
+					switch (token.text[0])
+					{
+						case '-':	value.value = -value.value; break;
+						case '~':	value.value = ~value.value; break;
+						case '<':	value.value = value.value & 0xFF; break;
+						case '>':	value.value = (value.value >> 8) & 0xFF; break;
+					}
+					return value;
+				}
+
+				default:
+					break;
+			}
+
+			Fail(token, token.kind == Kind::Newline || token.kind == Kind::End ? "expected a value" :
+				"expected a value, found '" + std::string(token.text) + "'");
+			return {};
+		}
+
+		/* OUTPUT */
+
+		void Emit(const Token& at, byte data)
+		{
+			if (m_PC >= Memory::MAX_MEM)
+			{
+				Report(at, "output runs past $FFFF");
+				return;
+			}
+			if (m_Pass == 2)
+			{
+				if (m_Written[m_PC])
+				{
+					Report(at, "overwrites " + Hex(m_PC));
+				}
+				m_Image[m_PC] = data;
+				m_Written[m_PC] = true;
+			}
+			m_PC++;
+		}
+
+		void EmitByte(const Token& at, Value value)
+		{
+			if (value.known && (value.value < -0x80 || value.value > 0xFF))
+			{
+				Report(at, Hex(value.value) + " does not fit in a byte");
+			}
+			Emit(at, (byte)value.value);
+		}
+
+		// high byte first, the order CPU::ReadWord expects
+		void EmitWord(const Token& at, Value value)
+		{
+			if (value.known && (value.value < -0x8000 || value.value > 0xFFFF))
+			{
+				Report(at, Hex(value.value) + " does not fit in a word");
+			}
+			Emit(at, (byte)(value.value >> 8));
+			Emit(at, (byte)value.value);
+		}
+
+		/* STATEMENTS */
+
+		void Directive()
+		{
+			const Token& directive = Next();
+			std::string_view name = directive.text;
+
+			if (SameName(name, ".org"))
+			{
+				Value address = Expression();
+				if (m_Failed)
+				{
+					return;
+				}
+				if (!address.known)
+				{
+					Fail(directive, ".org needs an address known on the first pass", true);
+				}
+				else if (address.value < 0 || address.value > 0xFFFF)
+				{
+					Report(directive, Hex(address.value) + " is not an address");
+				}
+				else
+				{
+					m_PC = (u32)address.value;
+				}
+			}
+			else if (SameName(name, ".byte") || SameName(name, ".word"))
+			{
+				bool words = SameName(name, ".word");
+				while (!m_Failed)
+				{
+					const Token& at = Peek();
+					if (at.kind == Kind::String && !words)
+					{
+						Next();
+						for (size_t i = 0; i < at.text.size(); )
+						{
+							Emit(at, (byte)Character(at.text, i));
+						}
+					}
+					else
+					{
+						Value value = Expression();
+						if (m_Failed)
+						{
+							return;
+						}
+						words ? EmitWord(at, value) : EmitByte(at, value);
+					}
+
+					if (!Peek().Is(","))
+					{
+						break;
+					}
+					Next();
+				}
+			}
+			else
+			{
+				Fail(directive, "unknown directive '" + std::string(name) + "'");
+			}
+		}
+
+		void Instruction()
+		{
+			size_t index = m_Next;
+			const Token& name = Next();
+			const Mnemonic* mnemonic = FindMnemonic(name.text);
+			if (!mnemonic)
+			{
+				Fail(name, "unknown instruction '" + std::string(name.text) + "'");
+				return;
+			}
+
+			Mode mode = Mode::Implied;
+			Value operand;
+			if (Peek().Is("#"))
+			{
+				Next();
+				operand = Expression();
+				mode = Mode::Immediate;
+			}
+			else if (!AtEndOfLine())
+			{
+				operand = Expression();
+				mode = Mode::Absolute;
+
+				if (!m_Failed && Peek().Is(","))
+				{
+					Next();
+					const Token& reg = Peek();
+					if (reg.kind == Kind::Identifier && SameName(reg.text, "X"))
+					{
+						Next();
+						mode = Mode::AbsoluteX;
+					}
+					else if (reg.kind == Kind::Identifier && SameName(reg.text, "Y"))
+					{
+						Next();
+						mode = Mode::AbsoluteY;
+					}
+					else
+					{
+						Fail(reg, "expected X or Y after ','");
+					}
+				}
+			}
+			if (m_Failed)
+			{
+				return;
+			}
+
+			if (mode == Mode::Absolute && mnemonic->Has(Mode::Relative))
+			{
+				mode = Mode::Relative;
+			}
+			else if (mode >= Mode::Absolute && mode <= Mode::AbsoluteY)
+			{
+				// the first pass picks between zero page and absolute, the second sticks to it
+				if (m_Pass == 1)
+				{
+					Mode zeroPage = mode == Mode::AbsoluteX ? Mode::ZeroPageX :
+						mode == Mode::AbsoluteY ? Mode::ZeroPageY : Mode::ZeroPage;
+					bool fits = operand.known && operand.value >= 0 && operand.value <= 0xFF;
+					if (mnemonic->Has(zeroPage) && (fits || !mnemonic->Has(mode)))
+					{
+						mode = zeroPage;
+					}
+					m_Modes[index] = mode;
+				}
+				mode = m_Modes[index];
+			}
+
+			if (!mnemonic->Has(mode))
+			{
+				static constexpr const char* NAMES[MODE_COUNT] =
+				{
+					"without an operand", "with an immediate operand", "with an address", "with an address,X",
+					"with an address,Y", "with an address", "with an address,X", "with an address,Y", "",
+				};
+				Fail(name, std::string(name.text) + " cannot be used " + NAMES[(size_t)mode]);
+				return;
+			}
+
+			Emit(name, (byte)mnemonic->opcodes[(size_t)mode]);
+			switch (mode)
+			{
+				case Mode::Implied:
+					break;
+
+				case Mode::Immediate:
+					EmitByte(name, operand);
+					break;
+
+				case Mode::ZeroPage:
+				case Mode::ZeroPageX:
+				case Mode::ZeroPageY:
+					if (operand.known && (operand.value < 0 || operand.value > 0xFF))
+					{
+						Report(name, Hex(operand.value) + " is not in the zero page");
+					}
+					Emit(name, (byte)operand.value);
+					break;
+
+				case Mode::Absolute:
+				case Mode::AbsoluteX:
+				case Mode::AbsoluteY:
+					if (operand.known && (operand.value < 0 || operand.value > 0xFFFF))
+					{
+						Report(name, Hex(operand.value) + " is not an address");
+					}
+					EmitWord(name, operand);
+					break;
+
+				case Mode::Relative:
+				{
+					// the offset is added to the address of the next instruction and never negative
+					long long offset = (operand.value - (long long)(m_PC + 1)) & 0xFFFF;
+					if (operand.known && (operand.value < 0 || operand.value > 0xFFFF || offset > 0xFF))
+					{
+						Report(name, "branch target " + Hex(operand.value) + " is not within 255 bytes after the branch");
+					}
+					Emit(name, (byte)offset);
+					break;
+				}
+			}
+		}
+
+		Assembly Result()
+		{
+			Assembly result;
+
+			u32 first = 0;
+			while (first < Memory::MAX_MEM && !m_Written[first])
+			{
+				first++;
+			}
+			u32 last = Memory::MAX_MEM;
+			while (last > first && !m_Written[last - 1])
+			{
+				last--;
+			}
+
+			result.origin = (word)first;
+			result.binary.assign(m_Image.begin() + first, m_Image.begin() + last);
+			for (u32 address = first; address < last; )
+			{
+				u32 end = address;
+				while (end < last && m_Written[end])
+				{
+					end++;
+				}
+				if (end > address)
+				{
+					result.spans.push_back({ (word)address, end - address });
+				}
+				address = end + 1;
+			}
+
+			result.symbols.reserve(m_Symbols.size());
+			for (const auto& [name, definition] : m_Symbols)
+			{
+				result.symbols.push_back({ std::string(name), (word)definition.value, definition.label });
+			}
+			std::sort(result.symbols.begin(), result.symbols.end(),
+				[](const Symbol& a, const Symbol& b) { return a.name < b.name; });
+
+			std::stable_sort(m_Errors.begin(), m_Errors.end(), [](const Error& a, const Error& b) { return a.line < b.line; });
+			result.errors.reserve(m_Errors.size());
+			for (Error& error : m_Errors)
+			{
+				result.errors.push_back("line " + std::to_string(error.line) + ": " + std::move(error.message));
+			}
+			return result;
+		}
+
+		std::vector<Error> m_Errors;
+		std::vector<Token> m_Tokens;
+		std::vector<Mode> m_Modes;		// by the token index of each instruction's mnemonic
+		std::unordered_map<std::string_view, Definition> m_Symbols;
+
+		std::vector<byte> m_Image;
+		std::bitset<Memory::MAX_MEM> m_Written;
+
+		int m_Pass = 1;
+		size_t m_Next = 0;
+		u32 m_PC = 0;			// MAX_MEM once output has reached the end of memory
+		bool m_Failed = false;		// the current line has a syntax error
+		bool m_Reported = false;	// the current line has an error
+	};
+}
+
+const Symbol* Assembly::Find(std::string_view name) const
+{
+	auto it = std::lower_bound(symbols.begin(), symbols.end(), name,
+		[](const Symbol& symbol, std::string_view name) { return symbol.name < name; });
+	return it != symbols.end() && it->name == name ? &*it : nullptr;
+}
+
+std::vector<Symbol> Assembly::Labels() const
+{
+	std::vector<Symbol> labels;
+	std::copy_if(symbols.begin(), symbols.end(), std::back_inserter(labels), [](const Symbol& symbol) { return symbol.label; });
+	return labels;
+}
+
+void Assembly::Load(Memory& ram) const
+{
+	for (const Span& span : spans)
+	{
+		for (u32 i = 0; i < span.size; i++)
+		{
+			ram[span.address + i] = binary[span.address - origin + i];
+		}
+	}
+}
+
+Assembly compile(std::string_view source)
+{
+	return Assembler(source).Run();
+}
@@ -1,5 +1,68 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <vector>
+#include "memory.hpp"
 
-std::vector<std::string> compile(std::string source);
\ No newline at end of file
+/// A label or `name = value` constant from an assembled source.
+struct Symbol
+{
+	std::string name;
+	word value = 0;
+	bool label = true;		// false for constants
+};
+
+/// An address range compile() wrote to.
+struct Span
+{
+	word address = 0;
+	u32 size = 0;
+};
+
+struct Assembly
+{
+	word origin = 0;					// address of binary[0]
+	std::vector<byte> binary;			// lowest to highest address written, gaps zeroed
+	std::vector<Span> spans;			// the parts of binary that were written, in address order
+	std::vector<Symbol> symbols;		// sorted by name
+	std::vector<std::string> errors;	// "line N: message", binary is incomplete when not empty
+
+	bool Ok() const { return errors.empty(); }
+
+	/// Looks `name` up in symbols; nullptr if it was never defined.
+	const Symbol* Find(std::string_view name) const;
+
+	/// The symbols that are labels, for naming code addresses (constants
+	/// such as I/O ports would claim the code that follows them).
+	std::vector<Symbol> Labels() const;
+
+	/// Writes the spans into `ram` host-side (see Memory::operator[]), so
+	/// gaps keep whatever `ram` held and devices are not triggered.
+	void Load(Memory& ram) const;
+};
+
+/// Two-pass assembler for the instructions CPU implements.
+///
+/// One statement per line, `;` starts a comment:
+///
+///		label:	MNEMONIC operand	; any of the parts may be left out
+///		name = expression
+///		.org expression				; continue at this address
+///		.byte expression|"string", ...
+///		.word expression, ...		; high byte first, like the CPU reads them
+///
+/// Mnemonics use the names in CPU (SDA, SDX; STA and STX are accepted too)
+/// and are case-insensitive. Operands are `#value` for immediate, `address`,
+/// `address,X` or `address,Y`; the zero page form is used when the address
+/// is known to fit by the time the first pass reaches it and the absolute
+/// form otherwise. Branches take the target address and, like the CPU, only
+/// reach forward up to 255 bytes past the next instruction.
+///
+/// Numbers are decimal, `$hex`, `0xhex`, `%binary` or 'c'haracters, and `*`
+/// is the address of the current statement. Expressions have C precedence
+/// over + - * / % & | ^ << >> and parentheses, plus unary - ~ and < / > for
+/// the low / high byte.
+///
+/// The source is tokenized once, without copying, and both passes walk the
+/// tokens; names are only copied into the returned symbol table.
+Assembly compile(std::string_view source);
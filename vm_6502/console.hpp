@@ -0,0 +1,71 @@
+#pragma once
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <span>
+#include "memory.hpp"
+
+/// Character output port, mapped at 0xFFFF by convention.
+///
+/// Bytes are collected in a fixed buffer and handed to the sink in one piece
+/// when the buffer fills up, when the CPU stops executing (Memory::Flush) or
+/// when the host calls Flush(). The span passed to the sink points straight
+/// into the buffer and is only valid during the call. Pending() lets the host
+/// look at output that has not been flushed yet without copying it.
+struct Console : Device
+{
+	static constexpr u32 ADDRESS = 0xFFFF;
+	static constexpr size_t DEFAULT_CAPACITY = 4096;
+
+	using Sink = std::function<void(std::span<const byte>)>;
+
+	/// Writes to stdout, bypassing iostreams.
+	static void WriteStdout(std::span<const byte> data)
+	{
+		std::fwrite(data.data(), 1, data.size(), stdout);
+		std::fflush(stdout);
+	}
+
+	explicit Console(Sink sink = WriteStdout, size_t capacity = DEFAULT_CAPACITY)
+		: m_Sink(std::move(sink)), m_Buffer(std::make_unique<byte[]>(capacity)), m_Capacity(capacity)
+	{
+		assert(capacity > 0);
+	}
+
+	~Console() override
+	{
+		Flush();
+	}
+
+	/// Also flush after every '\n', like a terminal.
+	bool m_LineBuffered = false;
+
+	void Write(u32, byte data) override
+	{
+		m_Buffer[m_Size++] = data;
+		if (m_Size == m_Capacity || (m_LineBuffered && data == '\n'))
+		{
+			Flush();
+		}
+	}
+
+	void Flush() override
+	{
+		if (m_Size > 0)
+		{
+			m_Sink(Pending());
+			m_Size = 0;
+		}
+	}
+
+	std::span<const byte> Pending() const
+	{
+		return { m_Buffer.get(), m_Size };
+	}
+
+private:
+	Sink m_Sink;
+	std::unique_ptr<byte[]> m_Buffer;
+	size_t m_Capacity;
+	size_t m_Size = 0;
+};
@@ -0,0 +1,779 @@
+#include "cpu.hpp"
+
+void CPU::ExecuteSwitch(u32 cycles, Memory& ram)
+{
+	while (cycles > 0)
+	{
+		byte ins = FetchByte(cycles, ram);
+		switch (ins)
+		{
+			case INS_ADC_IM:
+			{
+				byte data = FetchByte(cycles, ram);
+				AddWithCarry(data);
+			} break;
+
+			case INS_ADC_ZP:
+			{
+				byte address = FetchByte(cycles, ram);
+				byte data = ReadByte(cycles, ram, address);
+				AddWithCarry(data);
+			} break;
+
+			case INS_ADC_ZPX:
+			{
+				word address = FetchByte(cycles, ram);
+				byte data = ReadByte(cycles, ram, address + X);
+				AddWithCarry(data);
+				cycles--;
+			} break;
+
+			case INS_ADC_ABS:
+			{
+				word address = FetchWord(cycles, ram);
+				byte data = ReadByte(cycles, ram, address);
+				AddWithCarry(data);
+			} break;
+
+			case INS_ADC_ABSX:
+			{
+				word address = FetchWord(cycles, ram);
+				byte data = ReadByte(cycles, ram, address + X);
+				AddWithCarry(data);
+			} break;
+
+			case INS_ADC_ABSY:
+			{
+				word address = FetchWord(cycles, ram);
+				byte data = ReadByte(cycles, ram, address + Y);
+				AddWithCarry(data);
+			} break;
+
+			case INS_SBC_IM:
+			{
+				byte data = FetchByte(cycles, ram);
+				SubtractWithBorrow(data);
+			} break;
+
+			case INS_SBC_ZP:
+			{
+				byte address = FetchByte(cycles, ram);
+				byte data = ReadByte(cycles, ram, address);
+				SubtractWithBorrow(data);
+			} break;
+
+			case INS_SBC_ZPX:
+			{
+				word address = FetchByte(cycles, ram);
+				byte data = ReadByte(cycles, ram, address + X);
+				SubtractWithBorrow(data);
+				cycles--;
+			} break;
+
+			case INS_SBC_ABS:
+			{
+				word address = FetchWord(cycles, ram);
+				byte data = ReadByte(cycles, ram, address);
+				SubtractWithBorrow(data);
+			} break;
+
+			case INS_SBC_ABSX:
+			{
+				word address = FetchWord(cycles, ram);
+				byte data = ReadByte(cycles, ram, address + X);
+				SubtractWithBorrow(data);
+			} break;
+
+			case INS_SBC_ABSY:
+			{
+				word address = FetchWord(cycles, ram);
+				byte data = ReadByte(cycles, ram, address + Y);
+				SubtractWithBorrow(data);
+			} break;
+
+			case INS_CLC_IM:
+			{
+				C = 0;
+				cycles--;
+			} break;
+
+			case INS_CLD_IM:
+			{
+				D = 0;
+				cycles--;
+			} break;
+
+			case INS_SED_IM:
+			{
+				D = 1;
+				cycles--;
+			} break;
+
+			case INS_CLV_IM:
+			{
+				V = 0;
+				cycles--;
+			} break;
+
+			case INS_EOR_IM:
+			{
+				byte data = FetchByte(cycles, ram);
+				A = A ^ data;
+				SetZN(A);
+			} break;
+
+			case INS_EOR_ZP:
+			{
+				byte address = FetchByte(cycles, ram);
+				byte data = ReadByte(cycles, ram, address);
+				A = A ^ data;
+				SetZN(A);
+			} break;
+
+			case INS_EOR_ZPX:
+			{
+				word address = FetchByte(cycles, ram);
+				byte data = ReadByte(cycles, ram, address + X);
+				A = A ^ data;
+				SetZN(A);
+				cycles--;
+			} break;
+
+			case INS_EOR_ABS:
+			{
+				word address = FetchWord(cycles, ram);
+				byte data = ReadByte(cycles, ram, address);
+				A = A ^ data;
+				SetZN(A);
+			} break;
+
+			case INS_EOR_ABSX:
+			{
+				word address = FetchWord(cycles, ram);
+				byte data = ReadByte(cycles, ram, address + X);
+				A = A ^ data;
+				SetZN(A);
+				cycles--;
+			} break;
+
+			case INS_EOR_ABSY:
+			{
+				word address = FetchWord(cycles, ram);
+				byte data = ReadByte(cycles, ram, address + Y);
+				A = A ^ data;
+				SetZN(A);
+				cycles--;
+			} break;
+
+			case INS_ORA_IM:
+			{
+				byte data = FetchByte(cycles, ram);
+				A = A | data;
+				SetZN(A);
+			} break;
+
+			case INS_ORA_ZP:
+			{
+				byte address = FetchByte(cycles, ram);
+				byte data = ReadByte(cycles, ram, address);
+				A = A | data;
+				SetZN(A);
+			} break;
+
+			case INS_ORA_ZPX:
+			{
+				word address = FetchByte(cycles, ram);
+				byte data = ReadByte(cycles, ram, address + X);
+				A = A | data;
+				SetZN(A);
+				cycles--;
+			} break;
+
+			case INS_ORA_ABS:
+			{
+				word address = FetchWord(cycles, ram);
+				byte data = ReadByte(cycles, ram, address);
+				A = A | data;
+				SetZN(A);
+			} break;
+
+			case INS_ORA_ABSX:
+			{
+				word address = FetchWord(cycles, ram);
+				byte data = ReadByte(cycles, ram, address + X);
+				A = A | data;
+				SetZN(A);
+				cycles--;
+			} break;
+
+			case INS_ORA_ABSY:
+			{
+				word address = FetchWord(cycles, ram);
+				byte data = ReadByte(cycles, ram, address + Y);
+				A = A | data;
+				SetZN(A);
+				cycles--;
+			} break;
+
+			case INS_BCC_RL:
+			{
+				cycles --;
+				byte offset = FetchByte(cycles, ram);
+
+				if (!C)
+				{
+					PC += offset;
+					cycles--;
+				}
+
+			} break;
+
+			case INS_BCS_RL:
+			{
+				cycles --;
+				byte offset = FetchByte(cycles, ram);
+
+				if (C)
+				{
+					PC += offset;
+					cycles--;
+				}
+			} break;
+
+			case INS_BEQ_RL:
+			{
+				cycles--;
+				byte offset = FetchByte(cycles, ram);
+
+				if (Z())
+				{
+					PC += offset;
+					cycles--;
+				}
+			} break;
+
+			case INS_BNE_RL:
+			{
+				cycles--;
+				byte offset = FetchByte(cycles, ram);
+
+				if (!Z())
+				{
+					PC += offset;
+					cycles--;
+				}
+			} break;
+
+			case INS_BPL_RL:
+			{
+				cycles--;
+				byte offset = FetchByte(cycles, ram);
+
+				if (!N())
+				{
+					PC += offset;
+					cycles--;
+				}
+			} break;
+
+			case INS_BVC_RL:
+			{
+				cycles--;
+				byte offset = FetchByte(cycles, ram);
+
+				if (!V)
+				{
+					PC += offset;
+					cycles--;
+				}
+			} break;
+
+			case INS_BVS_RL:
+			{
+				cycles--;
+				byte offset = FetchByte(cycles, ram);
+
+				if (V)
+				{
+					PC += offset;
+					cycles--;
+				}
+			} break;
+
+			case INS_AND_IM:
+			{
+				byte data = FetchByte(cycles, ram);
+				A = A & data;
+				SetZN(A);
+			} break;
+
+			case INS_AND_ZP:
+			{
+				byte address = FetchByte(cycles, ram);
+				byte data = ReadByte(cycles, ram, address);
+				A = A & data;
+				SetZN(A);
+			} break;
+
+			case INS_AND_ZPX:
+			{
+				word address = FetchByte(cycles, ram);
+				byte data = ReadByte(cycles, ram, address + X);
+				A = A & data;
+				SetZN(A);
+			} break;
+
+			case INS_AND_ABS:
+			{
+				word address = FetchWord(cycles, ram);
+				byte data = ReadByte(cycles, ram, address);
+				A = A & data;
+				SetZN(A);
+			} break;
+
+			case INS_AND_ABSX:
+			{
+				word address = FetchWord(cycles, ram);
+				byte data = ReadByte(cycles, ram, address + X);
+				A = A & data;
+				SetZN(A);
+			} break;
+
+			case INS_AND_ABSY:
+			{
+				word address = FetchWord(cycles, ram);
+				byte data = ReadByte(cycles, ram, address + Y);
+				A = A & data;
+				SetZN(A);
+			} break;
+
+			case INS_LDA_IM:
+			{
+				byte value = FetchByte(cycles, ram);
+				A = value;
+				SetZN(A);
+			} break;
+
+			case INS_LDA_ZP:
+			{
+				byte zero_page_address = FetchByte(cycles, ram);
+				A = ReadByte(cycles, ram, zero_page_address);
+			} break;
+
+			case INS_LDA_ZPX:
+			{
+				word zero_page_address = FetchByte(cycles, ram);
+				zero_page_address += X;
+				cycles--;
+				A = ReadByte(cycles, ram, zero_page_address);
+			} break;
+			
+			case INS_LDX_IM:
+			{
+				byte value = FetchByte(cycles, ram);
+				X = value;
+				SetZN(X);
+			} break;
+
+			case INS_LDX_ZP:
+			{
+				byte zero_page_address = FetchByte(cycles, ram);
+				X = ReadByte(cycles, ram, zero_page_address);
+			} break;
+
+			case INS_LDX_ZPY:
+			{
+				byte zero_page_address = FetchByte(cycles, ram);
+				zero_page_address += Y;
+				cycles--;
+				X = ReadByte(cycles, ram, zero_page_address);
+			} break;
+
+			case INS_LDY_IM:
+			{
+				byte value = FetchByte(cycles, ram);
+				Y = value;
+				SetZN(Y);
+			} break;
+
+			case INS_LDY_ZP:
+			{
+				byte zero_page_address = FetchByte(cycles, ram);
+				Y = ReadByte(cycles, ram, zero_page_address);
+			} break;
+
+			case INS_LDY_ZPX:
+			{
+				word zero_page_address = FetchByte(cycles, ram);
+				zero_page_address += X;
+				cycles--;
+				Y = ReadByte(cycles, ram, zero_page_address);
+			} break;
+
+			case INS_JMP_ABS:
+			{
+				word address = FetchWord(cycles, ram);
+				PC = address;
+			} break;
+
+			case INS_JSR_ABS:
+			{
+				SP += 2;
+				WriteWord(cycles, ram, SP, PC - 1);
+
+				word sub_rutine = FetchWord(cycles, ram);
+				PC = sub_rutine;
+				cycles--;
+			} break;
+
+			case INS_RTS_ABS:
+			{
+				word return_address = ReadWord(cycles, ram, SP);
+				SP += 2;
+
+				PC = return_address;
+				cycles -= 3;
+			} break;
+
+			case INS_CMP_IM:
+			{
+				byte data = FetchByte(cycles, ram);
+				byte result = data - A;
+				C = (A >= data);
+				SetZN(result);
+			} break;
+
+			case INS_CMP_ZP:
+			{
+				byte address = FetchByte(cycles, ram);
+				byte data = ReadByte(cycles, ram, address);
+				byte result = data - A;
+				C = (A >= data);
+				SetZN(result);
+			} break;
+
+			case INS_CMP_ZPX:
+			{
+				word address = FetchByte(cycles, ram);
+				byte data = ReadByte(cycles, ram, address + X);
+				byte result = data - A;
+				C = (A >= data);
+				SetZN(result);
+			} break;
+
+			case INS_CMP_ABS:
+			{
+				word address = FetchWord(cycles, ram);
+				byte data = ReadByte(cycles, ram, address);
+				byte result = data - A;
+				C = (A >= data);
+				SetZN(result);
+			} break;
+
+			case INS_CMP_ABSX:
+			{
+				word address = FetchWord(cycles, ram);
+				byte data = ReadByte(cycles, ram, address + X);
+				byte result = data - A;
+				C = (A >= data);
+				SetZN(result);
+			} break;
+
+			case INS_CMP_ABSY:
+			{
+				word address = FetchWord(cycles, ram);
+				byte data = ReadByte(cycles, ram, address + Y);
+				byte result = data - A;
+				C = (A >= data);
+				SetZN(result);
+			} break;
+
+			case INS_CPX_IM:
+			{
+				byte data = FetchByte(cycles, ram);
+				byte result = data - X;
+				C = (X >= data);
+				SetZN(result);
+			} break;
+
+			case INS_CPX_ZP:
+			{
+				byte address = FetchByte(cycles, ram);
+				byte data = ReadByte(cycles, ram, address);
+				byte result = data - X;
+				C = (X >= data);
+				SetZN(result);
+			} break;
+
+			case INS_CPX_ABS:
+			{
+				word address = FetchWord(cycles, ram);
+				byte data = ReadByte(cycles, ram, address);
+				byte result = data - X;
+				C = (X >= data);
+				SetZN(result);
+			} break;
+
+			case INS_CPY_IM:
+			{
+				byte data = FetchByte(cycles, ram);
+				byte result = data - Y;
+				C = (Y >= data);
+				SetZN(result);
+			} break;
+
+			case INS_CPY_ZP:
+			{
+				byte address = FetchByte(cycles, ram);
+				byte data = ReadByte(cycles, ram, address);
+				byte result = data - Y;
+				C = (Y >= data);
+				SetZN(result);
+			} break;
+
+			case INS_CPY_ABS:
+			{
+				word address = FetchWord(cycles, ram);
+				byte data = ReadByte(cycles, ram, address);
+				byte result = data - Y;
+				C = (Y >= data);
+				SetZN(result);
+			} break;
+
+			case INS_DEC_ZP:
+			{
+				byte address = FetchByte(cycles, ram);
+				byte data = ReadByte(cycles, ram, address);
+
+				data--;
+				SetZN(data);
+				WriteByte(cycles, ram, address, data);
+				cycles--;
+			} break;
+
+			case INS_DEC_ZPX:
+			{
+				word address = FetchByte(cycles, ram);
+				byte data = ReadByte(cycles, ram, address + X);
+
+				data--;
+				SetZN(data);
+				WriteByte(cycles, ram, address + X, data);
+				cycles -= 2;
+			} break;
+
+			case INS_DEC_ABS:
+			{
+				word address = FetchWord(cycles, ram);
+				byte data = ReadByte(cycles, ram, address);
+
+				data--;
+				SetZN(data);
+				WriteByte(cycles, ram, address, data);
+				cycles--;
+			} break;
+
+			case INS_DEC_ABSX:
+			{
+				word address = FetchWord(cycles, ram);
+				byte data = ReadByte(cycles, ram, address);
+
+				data--;
+				SetZN(data);
+				WriteByte(cycles, ram, address, data);
+				cycles -= 2;
+			} break;
+
+			case INS_DEX_IM:
+			{
+				X--;
+				SetZN(X);
+				cycles--;
+			} break;
+
+			case INS_DEY_IM:
+			{
+				Y--;
+				SetZN(Y);
+				cycles--;
+			} break;
+
+			case INS_INC_ZP:
+			{
+				byte address = FetchByte(cycles, ram);
+				byte data = ReadByte(cycles, ram, address);
+				data++;
+				SetZN(data);
+				WriteByte(cycles, ram, address, data);
+				cycles--;
+			} break;
+
+			case INS_INC_ZPX:
+			{
+				word address = FetchByte(cycles, ram);
+				byte data = ReadByte(cycles, ram, address + X);
+				data++;
+				SetZN(data);
+				WriteByte(cycles, ram, address + X, data);
+				cycles -= 2;
+			} break;
+
+			case INS_INC_ABS:
+			{
+				word address = FetchWord(cycles, ram);
+				byte data = ReadByte(cycles, ram, address);
+				data++;
+				SetZN(data);
+				WriteByte(cycles, ram, address, data);
+				cycles--;
+			} break;
+
+			case INS_INC_ABSX:
+			{
+				word address = FetchWord(cycles, ram);
+				byte data = ReadByte(cycles, ram, address + X);
+				data++;
+				SetZN(data);
+				WriteByte(cycles, ram, address + X, data);
+			} break;
+
+			case INS_INX_IM:
+			{
+				X++;
+				cycles--;
+			} break;
+
+			case INS_INY_IM:
+			{
+				Y++;
+				cycles--;
+			} break;
+
+			case INS_PHA_IM:
+			{
+				SP -= 2;
+				WriteWord(cycles, ram, SP, A);
+			} break;
+
+			case INS_PHP_IM:
+			{ /* order: C Z I D B V N */ 
+				PushProgramState(cycles, ram);
+			} break;
+
+			case INS_PLA_IM:
+			{
+				word value = ReadWord(cycles, ram, SP);
+				A = value;
+				SetZN(A);
+				SP += 2;
+			} break;
+
+			case INS_PLP_IM:
+			{ /* order: C Z I D B V N */ 
+				PullProgramState(cycles, ram);
+			} break;
+
+			case INS_SDA_ZP:
+			{
+				byte address = FetchByte(cycles, ram);
+				WriteByte(cycles, ram, address, A);
+			} break;
+
+			case INS_SDA_ZPX:
+			{
+				word address = FetchByte(cycles, ram);
+				WriteByte(cycles, ram, address + X, A);
+				cycles--;
+			} break;
+
+			case INS_SDA_ABS:
+			{
+				word address = FetchWord(cycles, ram);
+				WriteByte(cycles, ram, address, A);
+			} break;
+
+			case INS_SDA_ABSX:
+			{
+				word address = FetchWord(cycles, ram);
+				WriteByte(cycles, ram, address + X, A);
+				cycles--;
+			} break;
+
+			case INS_SDA_ABSY:
+			{
+				word address = FetchWord(cycles, ram);
+				WriteByte(cycles, ram, address + Y, A);
+				cycles--;
+			} break;
+
+			case INS_SDX_ZP:
+			{
+				byte address = FetchByte(cycles, ram);
+				WriteByte(cycles, ram, address, X);
+			} break;
+
+			case INS_SDX_ZPY:
+			{
+				word address = FetchByte(cycles, ram);
+				WriteByte(cycles, ram, address + Y, X);
+				cycles--;
+			} break;
+
+			case INS_SDX_ABS:
+			{
+				word address = FetchWord(cycles, ram);
+				WriteByte(cycles, ram, address, X);
+			} break;
+
+			case INS_CLI_IM:
+			{
+				I = 0;
+				cycles--;
+			} break; 
+			
+			case INS_SEI_IM:
+			{
+				I = 1;
+				cycles--;
+			} break;
+
+			case INS_NOP_IM:
+			{
+				cycles--;
+			} break;
+
+			case INS_BRK_IM:
+			{
+				SP -= 2;
+				WriteWord(cycles, ram, SP, PC - 1);
+				PushProgramState(cycles, ram);
+				B = 1;
+
+				// 0xFDFB address of ISR table (up to 256 as it ends before 0xFFFC execution address)
+				word ISRHandlerAddress = ReadWord(cycles, ram, 0xFDFC + ((word)A * 2)); 
+				PC = ISRHandlerAddress;
+			} break;
+
+			case INS_RTI_IM:
+			{
+				PullProgramState(cycles, ram);
+				word callerAddress = ReadWord(cycles, ram, SP);
+				PC = callerAddress + 1;
+				SP += 2;
+				cycles--;
+			} break;
+
+			default:
+			{
+				SP -= 2;
+				WriteWord(cycles, ram, SP, PC);
+				PushProgramState(cycles, ram);
+				A = 0x06;						// Invlid Opcode exception
+				X = ins;
+				word ISRHandlerAddress = ReadWord(cycles, ram, 0xFDFC + (5 * 2));
+				PC = ISRHandlerAddress;
+			} break;
+		}
+	}
+	ram.Flush();
+}
@@ -0,0 +1,334 @@
+#pragma once
+#include <bitset>
+#include "alu.hpp"
+#include "memory.hpp"
+
+/// Why CPU::Execute returned.
+enum class StopReason : byte
+{
+	Budget,			// the cycles asked for have been used up
+	Halt,			// PC is on a JMP to itself, and no event is scheduled
+	Idle,			// the guest is going round a loop that writes nothing and
+					// ends where it started, and no event is scheduled
+	Breakpoint,		// PC reached one of the Breakpoints
+	InvalidOpcode,	// an invalid opcode raised ISR 5; PC is in its handler
+	IoWait,			// a device asked to wait (Memory::WaitForIo)
+};
+
+struct ExecResult
+{
+	u64 cycles = 0;		// cycles used, including any overshoot of the last block
+	StopReason reason = StopReason::Budget;
+};
+
+/// Addresses CPU::Execute stops at, before running the instruction there.
+struct Breakpoints
+{
+	void Set(word address) { m_Set.set(address); }
+	void Clear(word address) { m_Set.reset(address); }
+	bool Has(word address) const { return m_Set.test(address); }
+
+private:
+	std::bitset<Memory::MAX_MEM> m_Set;
+};
+
+struct CPU
+{
+
+	word PC;
+	word SP;
+	
+	byte A, X, Y;
+
+	// Flags are whole bytes holding 0 or 1, so setting one is a plain store.
+	byte C;
+	byte I;
+	byte D;
+	byte B;
+	byte V;
+
+	// Z and N are evaluated lazily: ZN keeps the last value that set them
+	// (see SetZN) and Z() / N() derive the bits when someone asks. Z is set
+	// when the low byte is 0, N when bit 7 or bit 8 is; bit 8 lets SetZN(bool,
+	// bool) express Z and N both set.
+	word ZN;
+
+	bool Z() const { return (ZN & 0x0FF) == 0; }
+	bool N() const { return (ZN & 0x180) != 0; }
+
+	bool operator==(const CPU&) const = default;
+
+	void Reset(Memory& ram)
+	{
+		SoftReset();
+		ram.Init();
+	}
+	/// Resets registers and restores memory from `pristine` (see Memory::Restore).
+	void Reset(Memory& ram, const Memory& pristine)
+	{
+		SoftReset();
+		ram.Restore(pristine);
+	}
+	/// Resets registers only and leaves memory alone.
+	void SoftReset()
+	{
+		PC = 0xFFFC;
+		SP = 0x00FF;
+		C = I = D = B = V = 0;
+		SetZN(false, false);
+		A = X = Y = 0;
+	}
+	byte FetchByte(u32& cycles, Memory& ram)
+	{
+		byte data = ram.Read(PC);
+		PC++;
+		cycles--;
+		return data;
+	}
+	word FetchWord(u32& cycles, Memory& ram)
+	{
+		byte high = FetchByte(cycles, ram);
+		byte low = FetchByte(cycles, ram);
+
+		word data = (high << 8) | low;
+		return data;
+	}
+	byte ReadByte(u32& cycles, Memory& ram, u32 address)
+	{
+		byte data = ram.Read(address);
+		cycles--;
+		return data;
+	}
+	word ReadWord(u32& cycles, Memory& ram, u32 address)
+	{
+		byte high = ReadByte(cycles, ram, address);
+		byte low = ReadByte(cycles, ram, address + 1);
+
+		word data = (high << 8) | low;
+		return data;
+	}
+	void WriteByte(u32& cycles, Memory& ram, u32 address, byte data)
+	{
+		ram.Write(address, data);
+		cycles--;
+	}
+	void WriteWord(u32& cycles, Memory& ram, u32 address, word data)
+	{
+		byte wordh = (data >> 8) & 0x00FF;
+		byte wordl = data & 0x00FF;
+
+		WriteByte(cycles, ram, address, wordh);
+		WriteByte(cycles, ram, address + 1, wordl);
+	}
+	/// C Z I D B V N from bit 0 up, as PHP pushes them.
+	byte Status() const
+	{
+		return (byte)(C | Z() << 1 | I << 2 | D << 3 | B << 4 | V << 5 | N() << 6);
+	}
+	void SetStatus(byte status)
+	{
+		C = status & 1;
+		I = (status >> 2) & 1;
+		D = (status >> 3) & 1;
+		B = (status >> 4) & 1;
+		V = (status >> 5) & 1;
+		SetZN((status >> 1) & 1, (status >> 6) & 1);
+	}
+	void PushProgramState(u32& cycles, Memory& ram)
+	{
+		word pState = Status();
+		SP -= 2;
+		WriteWord(cycles, ram, SP, pState);
+	}
+	void PullProgramState(u32& cycles, Memory& ram)
+	{
+		word pState = ReadWord(cycles, ram, SP);
+
+		SetStatus((byte)pState);
+		SP += 2;
+	}
+
+	// ISR table entries of the interrupt lines (see Memory::SetIrq, Memory::Nmi)
+	static constexpr byte ISR_NMI = 2;
+	static constexpr byte ISR_IRQ = 3;
+
+	static constexpr byte INS_ADC_IM	= 0x69; // implemented
+	static constexpr byte INS_ADC_ZP	= 0x65; // implemented
+	static constexpr byte INS_ADC_ZPX	= 0x75; // implemented
+	static constexpr byte INS_ADC_ABS	= 0x6D; // implemented
+	static constexpr byte INS_ADC_ABSX	= 0x7D; // implemented
+	static constexpr byte INS_ADC_ABSY	= 0x79; // implemented
+
+	static constexpr byte INS_SBC_IM	= 0xE9; // implemented
+	static constexpr byte INS_SBC_ZP	= 0xE5; // implemented
+	static constexpr byte INS_SBC_ZPX	= 0xF5; // implemented
+	static constexpr byte INS_SBC_ABS	= 0xED; // implemented
+	static constexpr byte INS_SBC_ABSX	= 0xFD; // implemented
+	static constexpr byte INS_SBC_ABSY	= 0xF9; // implemented
+
+	static constexpr byte INS_CLC_IM	= 0x18; // implemented
+	static constexpr byte INS_CLD_IM	= 0xD8; // implemented
+	static constexpr byte INS_SED_IM	= 0xF8; // implemented
+	static constexpr byte INS_CLV_IM	= 0xB8; // implemented
+
+	static constexpr byte INS_EOR_IM	= 0x49; // implemented
+	static constexpr byte INS_EOR_ZP	= 0x45; // implemented
+	static constexpr byte INS_EOR_ZPX	= 0x55; // implemented
+	static constexpr byte INS_EOR_ABS	= 0x4D; // implemented
+	static constexpr byte INS_EOR_ABSX	= 0x5D; // implemented
+	static constexpr byte INS_EOR_ABSY	= 0x59; // implemented
+
+	static constexpr byte INS_AND_IM	= 0x29; // implemented
+	static constexpr byte INS_AND_ZP	= 0x25; // implemented
+	static constexpr byte INS_AND_ZPX	= 0x35; // implemented
+	static constexpr byte INS_AND_ABS	= 0x2D; // implemented
+	static constexpr byte INS_AND_ABSX	= 0x3D; // implemented
+	static constexpr byte INS_AND_ABSY	= 0x39; // implemented
+
+	static constexpr byte INS_ORA_IM	= 0x09; // implemented
+	static constexpr byte INS_ORA_ZP	= 0x05; // implemented
+	static constexpr byte INS_ORA_ZPX	= 0x15; // implemented
+	static constexpr byte INS_ORA_ABS	= 0x0D; // implemented
+	static constexpr byte INS_ORA_ABSX	= 0x1D; // implemented
+	static constexpr byte INS_ORA_ABSY	= 0x19; // implemented
+
+	static constexpr byte INS_BCC_RL	= 0x90; // implemented
+	static constexpr byte INS_BCS_RL	= 0xB0; // implemented
+	static constexpr byte INS_BEQ_RL	= 0xF0; // implemented
+	static constexpr byte INS_BMI_RL	= 0x30; // implemented
+	static constexpr byte INS_BNE_RL	= 0xD0; // implemented
+	static constexpr byte INS_BPL_RL	= 0x10; // implemented
+	static constexpr byte INS_BVC_RL	= 0x50; // implemented
+	static constexpr byte INS_BVS_RL	= 0x70; // implemented
+
+	static constexpr byte INS_LDA_IM	= 0xA9; // implemented
+	static constexpr byte INS_LDA_ZP	= 0xA5; // implemented
+	static constexpr byte INS_LDA_ZPX	= 0xB5; // implemented	
+
+	static constexpr byte INS_LDY_IM	= 0xA0; // implemented
+	static constexpr byte INS_LDY_ZP	= 0xA4; // implemented
+	static constexpr byte INS_LDY_ZPX	= 0xB4; // implemented
+
+	static constexpr byte INS_LDX_IM	= 0xA2; // implemented
+	static constexpr byte INS_LDX_ZP	= 0xA6; // implemented
+	static constexpr byte INS_LDX_ZPY	= 0xB6; // implemented
+
+	static constexpr byte INS_JMP_ABS	= 0x4C; // implemented
+	static constexpr byte INS_JSR_ABS	= 0x20; // implemented
+
+	static constexpr byte INS_RTS_ABS	= 0x60; // implemented
+
+	static constexpr byte INS_CMP_IM	= 0xC9; // implemented
+	static constexpr byte INS_CMP_ZP	= 0xC5;	// implemented
+	static constexpr byte INS_CMP_ZPX	= 0xD5; // implemented
+	static constexpr byte INS_CMP_ABS	= 0xCD; // implemented
+	static constexpr byte INS_CMP_ABSX	= 0xDD; // implemented
+	static constexpr byte INS_CMP_ABSY	= 0xD9; // implemented
+
+	static constexpr byte INS_CPX_IM	= 0xE0; // implemented
+	static constexpr byte INS_CPX_ZP	= 0xE4; // implemented
+	static constexpr byte INS_CPX_ABS	= 0xEC; // implemented
+
+	static constexpr byte INS_CPY_IM	= 0xC0; // implemented
+	static constexpr byte INS_CPY_ZP	= 0xC4; // implemented
+	static constexpr byte INS_CPY_ABS	= 0xCC; // implemented
+
+	static constexpr byte INS_DEC_ZP	= 0xC6; // implemented
+	static constexpr byte INS_DEC_ZPX	= 0xD6; // implemented
+	static constexpr byte INS_DEC_ABS	= 0xCE; // implemented
+	static constexpr byte INS_DEC_ABSX	= 0xDE; // implemented
+
+	static constexpr byte INS_DEX_IM	= 0xCA; // implemented
+
+	static constexpr byte INS_DEY_IM	= 0x88; // implemented
+
+	static constexpr byte INS_INC_ZP	= 0xE6; // implemented
+	static constexpr byte INS_INC_ZPX	= 0xF6; // implemented
+	static constexpr byte INS_INC_ABS	= 0xEE; // implemented
+	static constexpr byte INS_INC_ABSX	= 0xFE; // implemented
+
+	static constexpr byte INS_INX_IM	= 0xE8; // implemented
+
+	static constexpr byte INS_INY_IM	= 0xC8; // implemented
+
+	static constexpr byte INS_PHA_IM	= 0x48; // implemented
+	static constexpr byte INS_PHP_IM	= 0x08; // implemented
+
+	static constexpr byte INS_PLA_IM	= 0x68; // implemented
+	static constexpr byte INS_PLP_IM	= 0x28; // implemented
+
+	static constexpr byte INS_SDA_ZP	= 0x85; // implemented
+	static constexpr byte INS_SDA_ZPX	= 0x95; // implemented
+	static constexpr byte INS_SDA_ABS	= 0x8D; // implemented
+	static constexpr byte INS_SDA_ABSX	= 0x9D; // implemented
+	static constexpr byte INS_SDA_ABSY	= 0x99; // implemented
+
+	static constexpr byte INS_SDX_ZP	= 0x86; // implemented
+	static constexpr byte INS_SDX_ZPY	= 0x96; // implemented
+	static constexpr byte INS_SDX_ABS	= 0x8E; // implemented
+
+	static constexpr byte INS_TAX_IM	= 0xAA;
+	static constexpr byte INS_TAY_IM	= 0xA8;
+	static constexpr byte INS_TSX_IM	= 0xBA;
+
+	static constexpr byte INS_CLI_IM	= 0x58; // implemented
+	static constexpr byte INS_SEI_IM	= 0x78; // implemented
+	static constexpr byte INS_NOP_IM	= 0xEA; // implemented
+	static constexpr byte INS_BRK_IM	= 0x00; // implemented
+	static constexpr byte INS_RTI_IM	= 0x40; // implemented
+
+	/// Z and N from `value`, as most instructions set them.
+	byte SetZN(byte value)
+	{
+		ZN = value;
+		return value;
+	}
+	void SetZN(bool zero, bool negative)
+	{
+		ZN = (zero ? 0x000 : 0x001) | (negative ? 0x100 : 0x000);
+	}
+
+	/// ADC: A + data + C into A, in decimal when D is set (see alu.hpp).
+	void AddWithCarry(byte data)
+	{
+		Apply(alu::Execute(alu::ADC, A, data, C, D));
+	}
+	/// SBC: A - data - !C into A, in decimal when D is set (see alu.hpp).
+	void SubtractWithBorrow(byte data)
+	{
+		Apply(alu::Execute(alu::SBC, A, data, C, D));
+	}
+	void Apply(alu::Entry entry)
+	{
+		A = alu::Result(entry);
+		C = alu::Carry(entry);
+		V = alu::Overflow(entry);
+		ZN = alu::ZN(entry);
+	}
+
+	/// Interpreter (see dispatch.hpp). Runs for `cycles` cycles, or until it
+	/// halts, idles (see dispatch::Budget), hits an invalid opcode, a device
+	/// asks to wait or PC reaches one of `breakpoints`.
+	///
+	/// All but the breakpoints are checked where a basic block ends, after a
+	/// branch, JMP, JSR, RTS, BRK, RTI or invalid opcode, so the budget is
+	/// overshot by up to a block and every engine stops at the same place.
+	/// Breakpoints are checked before every instruction but the first, so
+	/// calling Execute again resumes from one.
+	///
+	/// Runs ExecuteThreaded, the faster of the two loops, and ExecuteTable
+	/// when there are breakpoints.
+	ExecResult Execute(u64 cycles, Memory& ram, const Breakpoints* breakpoints = nullptr);
+	/// Execute's loop over the handler table, which also takes breakpoints.
+	ExecResult ExecuteTable(u64 cycles, Memory& ram, const Breakpoints* breakpoints = nullptr);
+	/// The same handlers dispatched through computed goto where the compiler
+	/// supports it (GCC/Clang); the stop checks are only compiled into the
+	/// instructions that end a block. No breakpoints. Falls back to
+	/// ExecuteTable otherwise.
+	ExecResult ExecuteThreaded(u64 cycles, Memory& ram);
+	/// Reference interpreter: the original hand-written switch. Runs until
+	/// `cycles` reaches exactly zero.
+	void ExecuteSwitch(u32 cycles, Memory& ram);
+	/// Executes a single instruction and returns the number of cycles it took.
+	u32 Step(Memory& ram);
+};
@@ -0,0 +1,54 @@
+#include "disassembler.hpp"
+#include <cstdio>
+#include "opcodes.hpp"
+
+Disassembly Disassemble(const Memory& ram, word address)
+{
+	byte opcode = ram[address];
+	const OpcodeInfo& info = s_Opcodes[opcode];
+	char text[24];
+	if (!info.Valid())
+	{
+		std::snprintf(text, sizeof(text), ".byte $%02X", opcode);
+		return { 1, text };
+	}
+
+	word operand = 0;
+	for (u32 i = 1; i < info.length; i++)
+	{
+		operand = (word)(operand << 8 | ram[(word)(address + i)]);
+	}
+
+	switch (info.mode)
+	{
+		case AddressMode::Implied:
+			std::snprintf(text, sizeof(text), "%s", info.mnemonic);
+			break;
+		case AddressMode::Immediate:
+			std::snprintf(text, sizeof(text), "%s #$%02X", info.mnemonic, operand);
+			break;
+		case AddressMode::ZeroPage:
+			std::snprintf(text, sizeof(text), "%s $%02X", info.mnemonic, operand);
+			break;
+		case AddressMode::ZeroPageX:
+			std::snprintf(text, sizeof(text), "%s $%02X,X", info.mnemonic, operand);
+			break;
+		case AddressMode::ZeroPageY:
+			std::snprintf(text, sizeof(text), "%s $%02X,Y", info.mnemonic, operand);
+			break;
+		case AddressMode::Absolute:
+			std::snprintf(text, sizeof(text), "%s $%04X", info.mnemonic, operand);
+			break;
+		case AddressMode::AbsoluteX:
+			std::snprintf(text, sizeof(text), "%s $%04X,X", info.mnemonic, operand);
+			break;
+		case AddressMode::AbsoluteY:
+			std::snprintf(text, sizeof(text), "%s $%04X,Y", info.mnemonic, operand);
+			break;
+		case AddressMode::Relative:
+			// forward only: the offset is unsigned
+			std::snprintf(text, sizeof(text), "%s $%04X", info.mnemonic, (word)(address + info.length + operand));
+			break;
+	}
+	return { info.length, text };
+}
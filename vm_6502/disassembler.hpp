@@ -0,0 +1,16 @@
+#pragma once
+#include <string>
+#include "memory.hpp"
+
+/// One instruction, written the way compile() reads it.
+struct Disassembly
+{
+	byte length = 1;		// bytes it takes, opcode included
+	std::string text;		// e.g. "ADC $10,X", or ".byte $FF" for an invalid opcode
+};
+
+/// Disassembles the instruction at `address` from s_Opcodes (opcodes.hpp).
+/// `ram` is read host-side (see Memory::operator[]), so devices are not
+/// triggered. Branches show the address they go to, as they are written;
+/// zero page and absolute addresses are told apart by their digits.
+Disassembly Disassemble(const Memory& ram, word address);
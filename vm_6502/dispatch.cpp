@@ -0,0 +1,111 @@
+#include "dispatch.hpp"
+
+ExecResult CPU::Execute(u64 cycles, Memory& ram, const Breakpoints* breakpoints)
+{
+	return breakpoints ? ExecuteTable(cycles, ram, breakpoints) : ExecuteThreaded(cycles, ram);
+}
+
+ExecResult CPU::ExecuteTable(u64 cycles, Memory& ram, const Breakpoints* breakpoints)
+{
+	dispatch::NoProbe probe;
+	return dispatch::Run(*this, cycles, ram, probe, breakpoints);
+}
+
+u32 CPU::Step(Memory& ram)
+{
+	u32 cycles = 0;
+	byte ins = dispatch::Fetch(*this, ram);
+	dispatch::s_Table[ins](*this, cycles, ram);
+	return 0 - cycles;
+}
+
+bool dispatch::Budget::Idle(const CPU& cpu, Memory& ram)
+{
+	if (m_Probes == 0)
+	{
+		// at most once a SLICE, however short events make the slices
+		u64 used = Used();
+		if (used >= m_NextWatch && used < m_Total)
+		{
+			m_Start = cpu;
+			m_Probes = IDLE_PROBES;
+			m_NextWatch = used + SLICE;
+			ram.WatchWrites();
+		}
+		return false;
+	}
+	if (ram.Written())
+	{
+		m_Probes = 0;
+		return false;
+	}
+	if (cpu == m_Start)
+	{
+		return true;
+	}
+	m_Probes--;
+	return false;
+}
+
+namespace
+{
+	// Takes a triggered NMI, or the IRQ if it is asserted and not masked.
+	bool TakeInterrupt(CPU& cpu, Memory& ram, dispatch::Budget& budget)
+	{
+		byte isr;
+		if (ram.TakeNmi())
+		{
+			isr = CPU::ISR_NMI;
+		}
+		else if (ram.Irq() && !cpu.I)
+		{
+			isr = CPU::ISR_IRQ;
+		}
+		else
+		{
+			return false;
+		}
+		dispatch::Interrupt::Run(cpu, budget.cycles, ram, isr);
+		return true;
+	}
+}
+
+bool dispatch::Stop(Ending ending, CPU& cpu, Memory& ram, Budget& budget, StopReason& reason)
+{
+	budget.Sync();
+	if (ending == Ending::Invalid)
+	{
+		reason = StopReason::InvalidOpcode;
+		return true;
+	}
+	if (ram.TakeIoWait())
+	{
+		reason = StopReason::IoWait;
+		return true;
+	}
+
+	// a stuck guest waits for an interrupt, with nothing to run until the
+	// next event might raise one
+	bool stuck = ending == Ending::Halt || ((int)budget.cycles <= 0 && budget.Idle(cpu, ram));
+	while (!TakeInterrupt(cpu, ram, budget) && stuck)
+	{
+		if (!ram.HasEvents())
+		{
+			reason = ending == Ending::Halt ? StopReason::Halt : StopReason::Idle;
+			return true;
+		}
+		if (!budget.Skip())
+		{
+			break;
+		}
+	}
+
+	budget.Poll(ram.Irq() && cpu.I);
+	budget.Fit();
+	if (!budget.Remaining())
+	{
+		reason = StopReason::Budget;
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,1148 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include "cpu.hpp"
+#include "opcodes.hpp"
+
+/// Table-driven instruction dispatch.
+///
+/// Every opcode is described once as an addressing mode combined with an
+/// operation (e.g. `Read<ZeroPageX, OpADC>`). `Instruction<opcode>` maps an
+/// opcode to that behaviour, and s_Opcodes (opcodes.hpp) to its length and
+/// cycles; `Handle<opcode>` puts the two together, charging the cycles with
+/// a single subtraction. The 256-entry `s_Table` and the computed-goto loop
+/// in threaded.cpp are both generated from it, as is `s_Decoding`, the same
+/// instructions with their operands fetched up front, which the block cache
+/// (block.hpp) runs from, and `s_Forms`, which names each opcode's operation
+/// for the engines that generate their own code. MakeTable() checks at
+/// compile time that both agree on every opcode's operand bytes and validity.
+///
+/// The handlers reproduce CPU::ExecuteSwitch exactly, quirks included.
+namespace dispatch
+{
+	using Handler = void (*)(CPU& cpu, u32& cycles, Memory& ram);
+
+	/* FORMS */
+
+	// What an opcode does, read off its Instruction<> into s_Forms for the
+	// engines that emit their own code for it rather than call the handler
+	// (the JIT, the batch kernels, the recompiler). Length and cycles stay in
+	// s_Opcodes.
+
+	// as executed, which for DEC abs,X and LDX zp,Y is not as written
+	enum class Addressing : byte
+	{
+		Implied, Immediate, ZeroPage, ZeroPageX, ZeroPageY, ZeroPageYWrapped,
+		Absolute, AbsoluteX, AbsoluteY, Relative,
+	};
+
+	enum class Operation : byte
+	{
+		Invalid, ADC, SBC, AND, ORA, EOR, Load, Compare, DEC, INC, Store, Branch,
+		CLC, CLD, SED, CLV, CLI, SEI, NOP, DEX, DEY, INX, INY,
+		JMP, JSR, RTS, PHA, PLA, PHP, PLP, BRK, RTI,
+	};
+
+	enum class Register : byte { A, X, Y };
+
+	enum class Condition : byte { CarryClear, CarrySet, ZeroSet, ZeroClear, NegativeClear, OverflowClear, OverflowSet };
+
+	enum class LoadFlags : byte { None, Result };
+
+	struct Form
+	{
+		Operation operation = Operation::Invalid;
+		Addressing addressing = Addressing::Implied;
+		Register reg = Register::A;				// of a Load, Compare or Store
+		LoadFlags flags = LoadFlags::None;		// of a Load
+		Condition condition = Condition::CarryClear;	// of a Branch
+	};
+
+	/* ADDRESSING MODES */
+
+	// OPERAND is the number of operand bytes after the opcode; Resolve() turns
+	// the fetched operand into the effective address. ADDRESSING names it in
+	// a Form.
+
+	struct Immediate
+	{
+		static constexpr u32 OPERAND = 1;
+		static constexpr Addressing ADDRESSING = Addressing::Immediate;
+	};
+
+	struct ZeroPage
+	{
+		static constexpr u32 OPERAND = 1;
+		static constexpr Addressing ADDRESSING = Addressing::ZeroPage;
+		static u32 Resolve(const CPU&, word operand) { return operand; }
+	};
+
+	// zero page + register, NOT wrapped to the zero page
+	struct ZeroPageX
+	{
+		static constexpr u32 OPERAND = 1;
+		static constexpr Addressing ADDRESSING = Addressing::ZeroPageX;
+		static u32 Resolve(const CPU& cpu, word operand) { return operand + cpu.X; }
+	};
+
+	struct ZeroPageY
+	{
+		static constexpr u32 OPERAND = 1;
+		static constexpr Addressing ADDRESSING = Addressing::ZeroPageY;
+		static u32 Resolve(const CPU& cpu, word operand) { return operand + cpu.Y; }
+	};
+
+	// zero page + Y, wrapped to the zero page (INS_LDX_ZPY)
+	struct ZeroPageYWrapped
+	{
+		static constexpr u32 OPERAND = 1;
+		static constexpr Addressing ADDRESSING = Addressing::ZeroPageYWrapped;
+		static u32 Resolve(const CPU& cpu, word operand) { return (byte)(operand + cpu.Y); }
+	};
+
+	struct Absolute
+	{
+		static constexpr u32 OPERAND = 2;
+		static constexpr Addressing ADDRESSING = Addressing::Absolute;
+		static u32 Resolve(const CPU&, word operand) { return operand; }
+	};
+
+	struct AbsoluteX
+	{
+		static constexpr u32 OPERAND = 2;
+		static constexpr Addressing ADDRESSING = Addressing::AbsoluteX;
+		static u32 Resolve(const CPU& cpu, word operand) { return operand + cpu.X; }
+	};
+
+	struct AbsoluteY
+	{
+		static constexpr u32 OPERAND = 2;
+		static constexpr Addressing ADDRESSING = Addressing::AbsoluteY;
+		static u32 Resolve(const CPU& cpu, word operand) { return operand + cpu.Y; }
+	};
+
+	/* MEMORY ACCESS */
+
+	// CPU::FetchByte and friends without the counting: an instruction's
+	// cycles are charged in one go, from s_Opcodes (see Handle).
+
+	VM_ALWAYS_INLINE byte Fetch(CPU& cpu, Memory& ram)
+	{
+		return ram.Read(cpu.PC++);
+	}
+
+	VM_ALWAYS_INLINE word FetchWord(CPU& cpu, Memory& ram)
+	{
+		byte high = Fetch(cpu, ram);
+		byte low = Fetch(cpu, ram);
+		return (word)(high << 8 | low);
+	}
+
+	VM_ALWAYS_INLINE word ReadWord(Memory& ram, u32 address)
+	{
+		byte high = ram.Read(address);
+		byte low = ram.Read(address + 1);
+		return (word)(high << 8 | low);
+	}
+
+	VM_ALWAYS_INLINE void WriteWord(Memory& ram, u32 address, word data)
+	{
+		ram.Write(address, (byte)(data >> 8));
+		ram.Write(address + 1, (byte)data);
+	}
+
+	VM_ALWAYS_INLINE void PushProgramState(CPU& cpu, Memory& ram)
+	{
+		cpu.SP -= 2;
+		WriteWord(ram, cpu.SP, cpu.Status());
+	}
+
+	VM_ALWAYS_INLINE void PullProgramState(CPU& cpu, Memory& ram)
+	{
+		cpu.SetStatus((byte)ReadWord(ram, cpu.SP));
+		cpu.SP += 2;
+	}
+
+	template <typename Mode>
+	inline word FetchOperand(CPU& cpu, Memory& ram)
+	{
+		if constexpr (Mode::OPERAND == 1)
+		{
+			return Fetch(cpu, ram);
+		}
+		else
+		{
+			return FetchWord(cpu, ram);
+		}
+	}
+
+	template <typename Mode>
+	inline u32 Address(CPU& cpu, Memory& ram)
+	{
+		return Mode::Resolve(cpu, FetchOperand<Mode>(cpu, ram));
+	}
+
+	// `operand` was fetched already, e.g. by the block decoder
+	template <typename Mode>
+	inline byte Operand(CPU& cpu, word operand, Memory& ram)
+	{
+		if constexpr (std::is_same_v<Mode, Immediate>)
+		{
+			return (byte)operand;
+		}
+		else
+		{
+			return ram.Read(Mode::Resolve(cpu, operand));
+		}
+	}
+
+	template <typename Mode>
+	inline byte Operand(CPU& cpu, Memory& ram)
+	{
+		return Operand<Mode>(cpu, FetchOperand<Mode>(cpu, ram), ram);
+	}
+
+	/* OPERATIONS */
+
+	inline void OpADC(CPU& cpu, byte data) { cpu.AddWithCarry(data); }
+	inline void OpSBC(CPU& cpu, byte data) { cpu.SubtractWithBorrow(data); }
+
+	inline void OpAND(CPU& cpu, byte data) { cpu.SetZN(cpu.A &= data); }
+	inline void OpORA(CPU& cpu, byte data) { cpu.SetZN(cpu.A |= data); }
+	inline void OpEOR(CPU& cpu, byte data) { cpu.SetZN(cpu.A ^= data); }
+
+	template <byte CPU::* Reg, LoadFlags Flags>
+	inline void OpLoad(CPU& cpu, byte data)
+	{
+		cpu.*Reg = data;
+		if constexpr (Flags == LoadFlags::Result)
+		{
+			cpu.SetZN(data);
+		}
+	}
+
+	template <byte CPU::* Reg>
+	inline void OpCompare(CPU& cpu, byte data)
+	{
+		byte reg = cpu.*Reg;
+		byte result = data - reg;
+		cpu.C = (reg >= data);
+		cpu.SetZN(result);
+	}
+
+	inline byte OpDEC(CPU& cpu, byte data) { return cpu.SetZN(data - 1); }
+	inline byte OpINC(CPU& cpu, byte data) { return cpu.SetZN(data + 1); }
+
+	inline bool IfCarryClear(const CPU& cpu)	{ return !cpu.C; }
+	inline bool IfCarrySet(const CPU& cpu)		{ return cpu.C; }
+	inline bool IfZeroSet(const CPU& cpu)		{ return cpu.Z(); }
+	inline bool IfZeroClear(const CPU& cpu)		{ return !cpu.Z(); }
+	inline bool IfNegativeClear(const CPU& cpu)	{ return !cpu.N(); }
+	inline bool IfOverflowClear(const CPU& cpu)	{ return !cpu.V; }
+	inline bool IfOverflowSet(const CPU& cpu)	{ return cpu.V; }
+
+	inline void OpCLC(CPU& cpu) { cpu.C = 0; }
+	inline void OpCLD(CPU& cpu) { cpu.D = 0; }
+	inline void OpSED(CPU& cpu) { cpu.D = 1; }
+	inline void OpCLV(CPU& cpu) { cpu.V = 0; }
+	inline void OpCLI(CPU& cpu) { cpu.I = 0; }
+	inline void OpSEI(CPU& cpu) { cpu.I = 1; }
+	inline void OpNOP(CPU&) {}
+	inline void OpDEX(CPU& cpu) { cpu.SetZN(--cpu.X); }
+	inline void OpDEY(CPU& cpu) { cpu.SetZN(--cpu.Y); }
+	inline void OpINX(CPU& cpu) { cpu.X++; }
+	inline void OpINY(CPU& cpu) { cpu.Y++; }
+
+	// The Form of each operation above, without its addressing.
+
+	constexpr Form OpForm(void (*op)(CPU&, byte))
+	{
+		if (op == &OpADC) return { Operation::ADC };
+		if (op == &OpSBC) return { Operation::SBC };
+		if (op == &OpAND) return { Operation::AND };
+		if (op == &OpORA) return { Operation::ORA };
+		if (op == &OpEOR) return { Operation::EOR };
+		if (op == &OpLoad<&CPU::A, LoadFlags::None>) return { Operation::Load, Addressing::Implied, Register::A, LoadFlags::None };
+		if (op == &OpLoad<&CPU::X, LoadFlags::None>) return { Operation::Load, Addressing::Implied, Register::X, LoadFlags::None };
+		if (op == &OpLoad<&CPU::Y, LoadFlags::None>) return { Operation::Load, Addressing::Implied, Register::Y, LoadFlags::None };
+		if (op == &OpLoad<&CPU::A, LoadFlags::Result>) return { Operation::Load, Addressing::Implied, Register::A, LoadFlags::Result };
+		if (op == &OpLoad<&CPU::X, LoadFlags::Result>) return { Operation::Load, Addressing::Implied, Register::X, LoadFlags::Result };
+		if (op == &OpLoad<&CPU::Y, LoadFlags::Result>) return { Operation::Load, Addressing::Implied, Register::Y, LoadFlags::Result };
+		if (op == &OpCompare<&CPU::A>) return { Operation::Compare, Addressing::Implied, Register::A };
+		if (op == &OpCompare<&CPU::X>) return { Operation::Compare, Addressing::Implied, Register::X };
+		if (op == &OpCompare<&CPU::Y>) return { Operation::Compare, Addressing::Implied, Register::Y };
+		return {};
+	}
+
+	constexpr Form OpForm(byte (*op)(CPU&, byte))
+	{
+		if (op == &OpDEC) return { Operation::DEC };
+		if (op == &OpINC) return { Operation::INC };
+		return {};
+	}
+
+	constexpr Form OpForm(bool (*condition)(const CPU&))
+	{
+		Form form{ Operation::Branch, Addressing::Relative };
+		if (condition == &IfCarryClear) form.condition = Condition::CarryClear;
+		if (condition == &IfCarrySet) form.condition = Condition::CarrySet;
+		if (condition == &IfZeroSet) form.condition = Condition::ZeroSet;
+		if (condition == &IfZeroClear) form.condition = Condition::ZeroClear;
+		if (condition == &IfNegativeClear) form.condition = Condition::NegativeClear;
+		if (condition == &IfOverflowClear) form.condition = Condition::OverflowClear;
+		if (condition == &IfOverflowSet) form.condition = Condition::OverflowSet;
+		return form;
+	}
+
+	constexpr Form OpForm(void (*op)(CPU&))
+	{
+		if (op == &OpCLC) return { Operation::CLC };
+		if (op == &OpCLD) return { Operation::CLD };
+		if (op == &OpSED) return { Operation::SED };
+		if (op == &OpCLV) return { Operation::CLV };
+		if (op == &OpCLI) return { Operation::CLI };
+		if (op == &OpSEI) return { Operation::SEI };
+		if (op == &OpNOP) return { Operation::NOP };
+		if (op == &OpDEX) return { Operation::DEX };
+		if (op == &OpDEY) return { Operation::DEY };
+		if (op == &OpINX) return { Operation::INX };
+		if (op == &OpINY) return { Operation::INY };
+		return {};
+	}
+
+	constexpr Form At(Form form, Addressing addressing)
+	{
+		form.addressing = addressing;
+		return form;
+	}
+
+	/* INSTRUCTION SHAPES */
+
+	// Run() executes an instruction whose opcode has been fetched, RunDecoded()
+	// one whose operand has been as well, with PC past it. Neither charges
+	// the base cycles, which Handle takes from s_Opcodes; OPERAND is the
+	// number of operand bytes they expect, checked against the table. WRITES
+	// marks the ones that do not end a block but may write memory, after which
+	// code run from a decoded form has to see whether it changed (see
+	// HandleFused).
+
+	template <typename Mode, void (*Op)(CPU&, byte)>
+	struct Read
+	{
+		static constexpr u32 OPERAND = Mode::OPERAND;
+		static constexpr Form FORM = At(OpForm(Op), Mode::ADDRESSING);
+
+		static void Run(CPU& cpu, u32&, Memory& ram)
+		{
+			Op(cpu, Operand<Mode>(cpu, ram));
+		}
+
+		static void RunDecoded(CPU& cpu, word operand, u32&, Memory& ram)
+		{
+			Op(cpu, Operand<Mode>(cpu, operand, ram));
+		}
+	};
+
+	template <typename Mode, byte (*Op)(CPU&, byte)>
+	struct Modify
+	{
+		static constexpr u32 OPERAND = Mode::OPERAND;
+		static constexpr Form FORM = At(OpForm(Op), Mode::ADDRESSING);
+		static constexpr bool WRITES = true;
+
+		static void Run(CPU& cpu, u32&, Memory& ram)
+		{
+			RunAt(cpu, Address<Mode>(cpu, ram), ram);
+		}
+
+		static void RunDecoded(CPU& cpu, word operand, u32&, Memory& ram)
+		{
+			RunAt(cpu, Mode::Resolve(cpu, operand), ram);
+		}
+
+		static void RunAt(CPU& cpu, u32 address, Memory& ram)
+		{
+			ram.Write(address, Op(cpu, ram.Read(address)));
+		}
+	};
+
+	template <typename Mode, byte CPU::* Reg>
+	struct Store
+	{
+		static constexpr u32 OPERAND = Mode::OPERAND;
+		static constexpr Form FORM = { Operation::Store, Mode::ADDRESSING, Reg == &CPU::A ? Register::A : Reg == &CPU::X ? Register::X : Register::Y };
+		static constexpr bool WRITES = true;
+
+		static void Run(CPU& cpu, u32&, Memory& ram)
+		{
+			ram.Write(Address<Mode>(cpu, ram), cpu.*Reg);
+		}
+
+		static void RunDecoded(CPU& cpu, word operand, u32&, Memory& ram)
+		{
+			ram.Write(Mode::Resolve(cpu, operand), cpu.*Reg);
+		}
+	};
+
+	template <bool (*Cond)(const CPU&)>
+	struct Branch
+	{
+		static constexpr u32 OPERAND = 1;
+		static constexpr Form FORM = OpForm(Cond);
+		static constexpr bool ENDS_BLOCK = true;
+
+		static void Run(CPU& cpu, u32& cycles, Memory& ram)
+		{
+			RunDecoded(cpu, Fetch(cpu, ram), cycles, ram);
+		}
+
+		// one cycle on top of the base when taken
+		static void RunDecoded(CPU& cpu, word offset, u32& cycles, Memory&)
+		{
+			if (Cond(cpu))
+			{
+				cpu.PC += (byte)offset;
+				cycles--;
+			}
+		}
+	};
+
+	template <void (*Op)(CPU&)>
+	struct Implied
+	{
+		static constexpr Form FORM = OpForm(Op);
+
+		static void Run(CPU& cpu, u32&, Memory&)
+		{
+			Op(cpu);
+		}
+	};
+
+	struct JumpAbsolute
+	{
+		static constexpr u32 OPERAND = 2;
+		static constexpr Form FORM = { Operation::JMP, Addressing::Absolute };
+		static constexpr bool ENDS_BLOCK = true;
+
+		static void Run(CPU& cpu, u32&, Memory& ram)
+		{
+			cpu.PC = FetchWord(cpu, ram);
+		}
+
+		static void RunDecoded(CPU& cpu, word target, u32&, Memory&)
+		{
+			cpu.PC = target;
+		}
+	};
+
+	struct JumpSubroutine
+	{
+		static constexpr u32 OPERAND = 2;
+		static constexpr Form FORM = { Operation::JSR, Addressing::Absolute };
+		static constexpr bool ENDS_BLOCK = true;
+
+		static void Run(CPU& cpu, u32&, Memory& ram)
+		{
+			cpu.SP += 2;
+			WriteWord(ram, cpu.SP, cpu.PC - 1);
+			cpu.PC = FetchWord(cpu, ram);
+		}
+
+		// PC is already past the operand; the pushed address is still the opcode's.
+		// Run() pushes before it fetches, so a push over the operand changes
+		// where it goes, and the operand is read again.
+		static void RunDecoded(CPU& cpu, word target, u32&, Memory& ram)
+		{
+			word operand = cpu.PC - 2;
+			cpu.SP += 2;
+			WriteWord(ram, cpu.SP, cpu.PC - 3);
+			if ((word)(cpu.SP - operand + 1) <= 2)
+			{
+				target = (word)(ram.Read(operand) << 8 | ram.Read((word)(operand + 1)));
+			}
+			cpu.PC = target;
+		}
+	};
+
+	struct ReturnSubroutine
+	{
+		static constexpr bool ENDS_BLOCK = true;
+		static constexpr Form FORM = { Operation::RTS };
+
+		static void Run(CPU& cpu, u32&, Memory& ram)
+		{
+			word returnAddress = ReadWord(ram, cpu.SP);
+			cpu.SP += 2;
+			cpu.PC = returnAddress;
+		}
+	};
+
+	struct PushA
+	{
+		static constexpr bool WRITES = true;
+		static constexpr Form FORM = { Operation::PHA };
+
+		static void Run(CPU& cpu, u32&, Memory& ram)
+		{
+			cpu.SP -= 2;
+			WriteWord(ram, cpu.SP, cpu.A);
+		}
+	};
+
+	struct PullA
+	{
+		static constexpr Form FORM = { Operation::PLA };
+
+		static void Run(CPU& cpu, u32&, Memory& ram)
+		{
+			cpu.A = (byte)ReadWord(ram, cpu.SP);
+			cpu.SetZN(cpu.A);
+			cpu.SP += 2;
+		}
+	};
+
+	struct PushStatus
+	{
+		static constexpr bool WRITES = true;
+		static constexpr Form FORM = { Operation::PHP };
+
+		static void Run(CPU& cpu, u32&, Memory& ram) { PushProgramState(cpu, ram); }
+	};
+
+	struct PullStatus
+	{
+		static constexpr Form FORM = { Operation::PLP };
+
+		static void Run(CPU& cpu, u32&, Memory& ram) { PullProgramState(cpu, ram); }
+	};
+
+	struct Break
+	{
+		static constexpr bool ENDS_BLOCK = true;
+		static constexpr Form FORM = { Operation::BRK };
+
+		static void Run(CPU& cpu, u32&, Memory& ram)
+		{
+			cpu.SP -= 2;
+			WriteWord(ram, cpu.SP, cpu.PC - 1);
+			PushProgramState(cpu, ram);
+			cpu.B = 1;
+			cpu.PC = ReadWord(ram, 0xFDFC + ((word)cpu.A * 2));
+		}
+	};
+
+	struct ReturnInterrupt
+	{
+		static constexpr bool ENDS_BLOCK = true;
+		static constexpr Form FORM = { Operation::RTI };
+
+		static void Run(CPU& cpu, u32&, Memory& ram)
+		{
+			PullProgramState(cpu, ram);
+			word callerAddress = ReadWord(ram, cpu.SP);
+			cpu.PC = callerAddress + 1;
+			cpu.SP += 2;
+		}
+	};
+
+	// raises ISR 5 with the offending opcode in X
+	template <byte Opcode>
+	struct Invalid
+	{
+		static constexpr bool ENDS_BLOCK = true;
+		static constexpr bool INVALID = true;
+
+		static void Run(CPU& cpu, u32&, Memory& ram)
+		{
+			cpu.SP -= 2;
+			WriteWord(ram, cpu.SP, cpu.PC);
+			PushProgramState(cpu, ram);
+			cpu.A = 0x06;
+			cpu.X = Opcode;
+			cpu.PC = ReadWord(ram, 0xFDFC + (5 * 2));
+		}
+	};
+
+	// An IRQ or NMI, taken between two blocks rather than run as an
+	// instruction. Like BRK, but RTI comes back to PC itself and IRQs are
+	// masked until then.
+	struct Interrupt
+	{
+		static constexpr u32 CYCLES = 7;
+
+		static void Run(CPU& cpu, u32& cycles, Memory& ram, byte isr)
+		{
+			cycles -= CYCLES;
+			Enter(cpu, ram);
+			cpu.PC = ReadWord(ram, 0xFDFC + ((word)isr * 2));
+		}
+
+		// everything but the jump to the handler, for ReplayTrace()
+		static void Enter(CPU& cpu, Memory& ram)
+		{
+			cpu.SP -= 2;
+			WriteWord(ram, cpu.SP, cpu.PC - 1);
+			PushProgramState(cpu, ram);
+			cpu.I = 1;
+		}
+	};
+
+	/* OPCODE MAP */
+
+	template <byte Opcode>
+	struct Instruction : Invalid<Opcode> {};
+
+#define VM_INSTRUCTION(opcode, ...) \
+	template <> struct Instruction<CPU::opcode> : __VA_ARGS__ {}
+
+	VM_INSTRUCTION(INS_ADC_IM,		Read<Immediate, OpADC>);
+	VM_INSTRUCTION(INS_ADC_ZP,		Read<ZeroPage, OpADC>);
+	VM_INSTRUCTION(INS_ADC_ZPX,		Read<ZeroPageX, OpADC>);
+	VM_INSTRUCTION(INS_ADC_ABS,		Read<Absolute, OpADC>);
+	VM_INSTRUCTION(INS_ADC_ABSX,	Read<AbsoluteX, OpADC>);
+	VM_INSTRUCTION(INS_ADC_ABSY,	Read<AbsoluteY, OpADC>);
+
+	VM_INSTRUCTION(INS_SBC_IM,		Read<Immediate, OpSBC>);
+	VM_INSTRUCTION(INS_SBC_ZP,		Read<ZeroPage, OpSBC>);
+	VM_INSTRUCTION(INS_SBC_ZPX,		Read<ZeroPageX, OpSBC>);
+	VM_INSTRUCTION(INS_SBC_ABS,		Read<Absolute, OpSBC>);
+	VM_INSTRUCTION(INS_SBC_ABSX,	Read<AbsoluteX, OpSBC>);
+	VM_INSTRUCTION(INS_SBC_ABSY,	Read<AbsoluteY, OpSBC>);
+
+	VM_INSTRUCTION(INS_CLC_IM,		Implied<OpCLC>);
+	VM_INSTRUCTION(INS_CLD_IM,		Implied<OpCLD>);
+	VM_INSTRUCTION(INS_SED_IM,		Implied<OpSED>);
+	VM_INSTRUCTION(INS_CLV_IM,		Implied<OpCLV>);
+
+	VM_INSTRUCTION(INS_EOR_IM,		Read<Immediate, OpEOR>);
+	VM_INSTRUCTION(INS_EOR_ZP,		Read<ZeroPage, OpEOR>);
+	VM_INSTRUCTION(INS_EOR_ZPX,		Read<ZeroPageX, OpEOR>);
+	VM_INSTRUCTION(INS_EOR_ABS,		Read<Absolute, OpEOR>);
+	VM_INSTRUCTION(INS_EOR_ABSX,	Read<AbsoluteX, OpEOR>);
+	VM_INSTRUCTION(INS_EOR_ABSY,	Read<AbsoluteY, OpEOR>);
+
+	VM_INSTRUCTION(INS_AND_IM,		Read<Immediate, OpAND>);
+	VM_INSTRUCTION(INS_AND_ZP,		Read<ZeroPage, OpAND>);
+	VM_INSTRUCTION(INS_AND_ZPX,		Read<ZeroPageX, OpAND>);
+	VM_INSTRUCTION(INS_AND_ABS,		Read<Absolute, OpAND>);
+	VM_INSTRUCTION(INS_AND_ABSX,	Read<AbsoluteX, OpAND>);
+	VM_INSTRUCTION(INS_AND_ABSY,	Read<AbsoluteY, OpAND>);
+
+	VM_INSTRUCTION(INS_ORA_IM,		Read<Immediate, OpORA>);
+	VM_INSTRUCTION(INS_ORA_ZP,		Read<ZeroPage, OpORA>);
+	VM_INSTRUCTION(INS_ORA_ZPX,		Read<ZeroPageX, OpORA>);
+	VM_INSTRUCTION(INS_ORA_ABS,		Read<Absolute, OpORA>);
+	VM_INSTRUCTION(INS_ORA_ABSX,	Read<AbsoluteX, OpORA>);
+	VM_INSTRUCTION(INS_ORA_ABSY,	Read<AbsoluteY, OpORA>);
+
+	VM_INSTRUCTION(INS_BCC_RL,		Branch<IfCarryClear>);
+	VM_INSTRUCTION(INS_BCS_RL,		Branch<IfCarrySet>);
+	VM_INSTRUCTION(INS_BEQ_RL,		Branch<IfZeroSet>);
+	VM_INSTRUCTION(INS_BNE_RL,		Branch<IfZeroClear>);
+	VM_INSTRUCTION(INS_BPL_RL,		Branch<IfNegativeClear>);
+	VM_INSTRUCTION(INS_BVC_RL,		Branch<IfOverflowClear>);
+	VM_INSTRUCTION(INS_BVS_RL,		Branch<IfOverflowSet>);
+
+	VM_INSTRUCTION(INS_LDA_IM,		Read<Immediate, OpLoad<&CPU::A, LoadFlags::Result>>);
+	VM_INSTRUCTION(INS_LDA_ZP,		Read<ZeroPage, OpLoad<&CPU::A, LoadFlags::None>>);
+	VM_INSTRUCTION(INS_LDA_ZPX,		Read<ZeroPageX, OpLoad<&CPU::A, LoadFlags::None>>);
+
+	VM_INSTRUCTION(INS_LDX_IM,		Read<Immediate, OpLoad<&CPU::X, LoadFlags::Result>>);
+	VM_INSTRUCTION(INS_LDX_ZP,		Read<ZeroPage, OpLoad<&CPU::X, LoadFlags::None>>);
+	VM_INSTRUCTION(INS_LDX_ZPY,		Read<ZeroPageYWrapped, OpLoad<&CPU::X, LoadFlags::None>>);
+
+	VM_INSTRUCTION(INS_LDY_IM,		Read<Immediate, OpLoad<&CPU::Y, LoadFlags::Result>>);
+	VM_INSTRUCTION(INS_LDY_ZP,		Read<ZeroPage, OpLoad<&CPU::Y, LoadFlags::None>>);
+	VM_INSTRUCTION(INS_LDY_ZPX,		Read<ZeroPageX, OpLoad<&CPU::Y, LoadFlags::None>>);
+
+	VM_INSTRUCTION(INS_JMP_ABS,		JumpAbsolute);
+	VM_INSTRUCTION(INS_JSR_ABS,		JumpSubroutine);
+	VM_INSTRUCTION(INS_RTS_ABS,		ReturnSubroutine);
+
+	VM_INSTRUCTION(INS_CMP_IM,		Read<Immediate, OpCompare<&CPU::A>>);
+	VM_INSTRUCTION(INS_CMP_ZP,		Read<ZeroPage, OpCompare<&CPU::A>>);
+	VM_INSTRUCTION(INS_CMP_ZPX,		Read<ZeroPageX, OpCompare<&CPU::A>>);
+	VM_INSTRUCTION(INS_CMP_ABS,		Read<Absolute, OpCompare<&CPU::A>>);
+	VM_INSTRUCTION(INS_CMP_ABSX,	Read<AbsoluteX, OpCompare<&CPU::A>>);
+	VM_INSTRUCTION(INS_CMP_ABSY,	Read<AbsoluteY, OpCompare<&CPU::A>>);
+
+	VM_INSTRUCTION(INS_CPX_IM,		Read<Immediate, OpCompare<&CPU::X>>);
+	VM_INSTRUCTION(INS_CPX_ZP,		Read<ZeroPage, OpCompare<&CPU::X>>);
+	VM_INSTRUCTION(INS_CPX_ABS,		Read<Absolute, OpCompare<&CPU::X>>);
+
+	VM_INSTRUCTION(INS_CPY_IM,		Read<Immediate, OpCompare<&CPU::Y>>);
+	VM_INSTRUCTION(INS_CPY_ZP,		Read<ZeroPage, OpCompare<&CPU::Y>>);
+	VM_INSTRUCTION(INS_CPY_ABS,		Read<Absolute, OpCompare<&CPU::Y>>);
+
+	VM_INSTRUCTION(INS_DEC_ZP,		Modify<ZeroPage, OpDEC>);
+	VM_INSTRUCTION(INS_DEC_ZPX,		Modify<ZeroPageX, OpDEC>);
+	VM_INSTRUCTION(INS_DEC_ABS,		Modify<Absolute, OpDEC>);
+	VM_INSTRUCTION(INS_DEC_ABSX,	Modify<Absolute, OpDEC>);	// X is not applied, as in ExecuteSwitch
+
+	VM_INSTRUCTION(INS_DEX_IM,		Implied<OpDEX>);
+	VM_INSTRUCTION(INS_DEY_IM,		Implied<OpDEY>);
+
+	VM_INSTRUCTION(INS_INC_ZP,		Modify<ZeroPage, OpINC>);
+	VM_INSTRUCTION(INS_INC_ZPX,		Modify<ZeroPageX, OpINC>);
+	VM_INSTRUCTION(INS_INC_ABS,		Modify<Absolute, OpINC>);
+	VM_INSTRUCTION(INS_INC_ABSX,	Modify<AbsoluteX, OpINC>);
+
+	VM_INSTRUCTION(INS_INX_IM,		Implied<OpINX>);
+	VM_INSTRUCTION(INS_INY_IM,		Implied<OpINY>);
+
+	VM_INSTRUCTION(INS_PHA_IM,		PushA);
+	VM_INSTRUCTION(INS_PHP_IM,		PushStatus);
+	VM_INSTRUCTION(INS_PLA_IM,		PullA);
+	VM_INSTRUCTION(INS_PLP_IM,		PullStatus);
+
+	VM_INSTRUCTION(INS_SDA_ZP,		Store<ZeroPage, &CPU::A>);
+	VM_INSTRUCTION(INS_SDA_ZPX,		Store<ZeroPageX, &CPU::A>);
+	VM_INSTRUCTION(INS_SDA_ABS,		Store<Absolute, &CPU::A>);
+	VM_INSTRUCTION(INS_SDA_ABSX,	Store<AbsoluteX, &CPU::A>);
+	VM_INSTRUCTION(INS_SDA_ABSY,	Store<AbsoluteY, &CPU::A>);
+
+	VM_INSTRUCTION(INS_SDX_ZP,		Store<ZeroPage, &CPU::X>);
+	VM_INSTRUCTION(INS_SDX_ZPY,		Store<ZeroPageY, &CPU::X>);
+	VM_INSTRUCTION(INS_SDX_ABS,		Store<Absolute, &CPU::X>);
+
+	VM_INSTRUCTION(INS_CLI_IM,		Implied<OpCLI>);
+	VM_INSTRUCTION(INS_SEI_IM,		Implied<OpSEI>);
+	VM_INSTRUCTION(INS_NOP_IM,		Implied<OpNOP>);
+	VM_INSTRUCTION(INS_BRK_IM,		Break);
+	VM_INSTRUCTION(INS_RTI_IM,		ReturnInterrupt);
+
+#undef VM_INSTRUCTION
+
+	// Runs `Opcode`, fetched already, charging the cycles s_Opcodes gives it
+	// in one go; only a taken branch adds to them.
+	template <byte Opcode>
+	void Handle(CPU& cpu, u32& cycles, Memory& ram)
+	{
+		cycles -= s_Opcodes[Opcode].cycles;
+		Instruction<Opcode>::Run(cpu, cycles, ram);
+	}
+
+	// Whether Instruction<Opcode> fetches the operand bytes s_Opcodes says it
+	// has, and is invalid where the table has no mnemonic.
+	template <byte Opcode>
+	constexpr bool Agrees()
+	{
+		using Ins = Instruction<Opcode>;
+		u32 operand = 0;
+		if constexpr (requires { Ins::OPERAND; })
+		{
+			operand = Ins::OPERAND;
+		}
+		bool invalid = std::is_base_of_v<Invalid<Opcode>, Ins>;
+		return s_Opcodes[Opcode].length == 1 + operand && s_Opcodes[Opcode].Valid() != invalid;
+	}
+
+	template <std::size_t... Opcodes>
+	constexpr std::array<Handler, 256> MakeTable(std::index_sequence<Opcodes...>)
+	{
+		static_assert((Agrees<Opcodes>() && ...), "an Instruction<> disagrees with s_Opcodes");
+		return { { &Handle<Opcodes>... } };
+	}
+
+	inline constexpr std::array<Handler, 256> s_Table = MakeTable(std::make_index_sequence<256>{});
+
+	// What the execution loops need to know about an opcode besides its
+	// handler; apart from s_Decoding so that they don't instantiate its
+	// handlers as well.
+	struct Traits
+	{
+		bool endsBlock;		// may jump (see Decoding)
+		bool invalid;		// raises ISR 5
+		bool writes;		// may write memory without ending a block (WRITES)
+	};
+
+	template <byte Opcode>
+	constexpr Traits TraitsOf()
+	{
+		using Ins = Instruction<Opcode>;
+		Traits traits{ false, !s_Opcodes[Opcode].Valid(), false };
+		if constexpr (requires { Ins::ENDS_BLOCK; })
+		{
+			traits.endsBlock = Ins::ENDS_BLOCK;
+		}
+		if constexpr (requires { Ins::WRITES; })
+		{
+			traits.writes = Ins::WRITES;
+		}
+		return traits;
+	}
+
+	template <std::size_t... Opcodes>
+	constexpr std::array<Traits, 256> MakeTraitsTable(std::index_sequence<Opcodes...>)
+	{
+		return { { TraitsOf<Opcodes>()... } };
+	}
+
+	inline constexpr std::array<Traits, 256> s_Traits = MakeTraitsTable(std::make_index_sequence<256>{});
+
+	template <byte Opcode>
+	constexpr Form FormOf()
+	{
+		if constexpr (requires { Instruction<Opcode>::FORM; })
+		{
+			return Instruction<Opcode>::FORM;
+		}
+		return {};
+	}
+
+	template <std::size_t... Opcodes>
+	constexpr std::array<Form, 256> MakeFormTable(std::index_sequence<Opcodes...>)
+	{
+		static_assert((((FormOf<Opcodes>().operation == Operation::Invalid) == !s_Opcodes[Opcodes].Valid()) && ...),
+			"an Instruction<> has no Form");
+		return { { FormOf<Opcodes>()... } };
+	}
+
+	inline constexpr std::array<Form, 256> s_Forms = MakeFormTable(std::make_index_sequence<256>{});
+
+	/* PRE-DECODED FORM (see BlockCache) */
+
+	// Runs an instruction whose opcode and operand have been fetched already,
+	// with PC pointing past them, charging its cycles as Handle does.
+	using DecodedHandler = void (*)(CPU& cpu, word operand, u32& cycles, Memory& ram);
+
+	struct Decoding
+	{
+		DecodedHandler run;
+		byte length;		// opcode + operand bytes
+		byte cycles;		// for a branch, when not taken
+		bool endsBlock;		// may jump, so nothing after it is decoded
+	};
+
+	template <byte Opcode>
+	void HandleDecoded(CPU& cpu, word operand, u32& cycles, Memory& ram)
+	{
+		using Ins = Instruction<Opcode>;
+		cycles -= s_Opcodes[Opcode].cycles;
+		if constexpr (requires { Ins::RunDecoded; })
+		{
+			Ins::RunDecoded(cpu, operand, cycles, ram);
+		}
+		else
+		{
+			// single-byte instructions have nothing left to fetch
+			Ins::Run(cpu, cycles, ram);
+		}
+	}
+
+	template <byte Opcode>
+	constexpr Decoding Describe()
+	{
+		const OpcodeInfo& info = s_Opcodes[Opcode];
+		return { &HandleDecoded<Opcode>, info.length, info.cycles, TraitsOf<Opcode>().endsBlock };
+	}
+
+	template <std::size_t... Opcodes>
+	constexpr std::array<Decoding, 256> MakeDecodingTable(std::index_sequence<Opcodes...>)
+	{
+		return { { Describe<Opcodes>()... } };
+	}
+
+	inline constexpr std::array<Decoding, 256> s_Decoding = MakeDecodingTable(std::make_index_sequence<256>{});
+
+	/* FUSED PAIRS (see BlockCache) */
+
+	// Pairs common enough to be decoded as one MicroOp, a superinstruction:
+	// HELLO_WORLD is mostly LDA # / SDA zp, and its loops INY / LDX zp,Y and
+	// CPY # / BEQ, and PHA / LDA # builds strings on the stack.
+	struct Fusion
+	{
+		byte first;
+		byte second;
+	};
+
+	inline constexpr Fusion FUSIONS[] =
+	{
+		{ CPU::INS_LDA_IM, CPU::INS_SDA_ZP },
+		{ CPU::INS_CPY_IM, CPU::INS_BEQ_RL },
+		{ CPU::INS_INY_IM, CPU::INS_LDX_ZPY },
+		{ CPU::INS_PHA_IM, CPU::INS_LDA_IM },
+	};
+
+	// Runs `First` and then `Second`, decoded together: `operand` holds their
+	// operand bytes one after the other and PC points past both, which the
+	// first, not being one that ends a block, never looks at. Each is charged
+	// its own cycles, so state after the pair is exactly that of running them
+	// apart. Should a first that writes memory rewrite code, it stops between
+	// them, with PC at the second, for that to be decoded again.
+	template <byte First, byte Second>
+	void HandleFused(CPU& cpu, word operand, u32& cycles, Memory& ram)
+	{
+		constexpr u32 SECOND_LENGTH = s_Opcodes[Second].length;
+		constexpr u32 SECOND_BITS = (SECOND_LENGTH - 1) * 8;
+		static_assert(s_Opcodes[First].length + SECOND_LENGTH <= 4, "a fused pair's operands must fit a word");
+		static_assert(!TraitsOf<First>().endsBlock, "only the second of a fused pair may end a block");
+
+		if constexpr (TraitsOf<First>().writes)
+		{
+			u32 epoch = ram.CodeEpoch();
+			HandleDecoded<First>(cpu, (word)(operand >> SECOND_BITS), cycles, ram);
+			if (ram.CodeEpoch() != epoch)
+			{
+				cpu.PC -= SECOND_LENGTH;
+				return;
+			}
+		}
+		else
+		{
+			HandleDecoded<First>(cpu, (word)(operand >> SECOND_BITS), cycles, ram);
+		}
+		HandleDecoded<Second>(cpu, (word)(operand & ((1u << SECOND_BITS) - 1)), cycles, ram);
+	}
+
+	template <std::size_t... I>
+	constexpr std::array<DecodedHandler, sizeof...(I)> MakeFusedTable(std::index_sequence<I...>)
+	{
+		return { { &HandleFused<FUSIONS[I].first, FUSIONS[I].second>... } };
+	}
+
+	inline constexpr auto s_Fused = MakeFusedTable(std::make_index_sequence<std::size(FUSIONS)>{});
+
+	// The handler running `first` and `second` as one, if they are a pair.
+	inline DecodedHandler Fused(byte first, byte second)
+	{
+		for (std::size_t i = 0; i < std::size(FUSIONS); i++)
+		{
+			if (FUSIONS[i].first == first && FUSIONS[i].second == second)
+			{
+				return s_Fused[i];
+			}
+		}
+		return nullptr;
+	}
+
+	/* EXECUTION LOOP */
+
+	// An Execute() budget, counted down in the u32 the handlers take, a slice
+	// of at most 2^20 cycles at a time. The counter is read as signed, so the
+	// block that takes it past zero leaves it negative instead of wrapping.
+	//
+	// Slices also end at the next event of the memory's clock (see
+	// Memory::Schedule), so Stop() can run it where that block ends, and
+	// shrink to one cycle while an IRQ waits for the I flag to clear, so
+	// Stop() sees every block end until it can be taken.
+	//
+	// Where a slice runs out, Idle() notes the CPU and has the next few
+	// blocks run in 1-cycle slices, so Stop() sees each of their ends. A guest
+	// that comes back to exactly the state it was in without having written
+	// anything would go round the same way forever: it is spinning on a loop
+	// only a device can get it out of, and there is no point burning the
+	// rest of the budget on it.
+	struct Budget
+	{
+		static constexpr u32 SLICE = 1u << 20;
+		static constexpr u32 IDLE_PROBES = 64;		// block ends watched for a loop
+
+		// `ram` is the memory whose clock the budget keeps, if any.
+		explicit Budget(u64 total = 0, Memory* ram = nullptr)
+			: m_Total(total), m_Ram(ram)
+		{
+			Sync();
+			Refill();
+		}
+
+		// Whether any of the budget is left; asked where blocks end.
+		bool Remaining()
+		{
+			if ((int)cycles > 0)
+			{
+				return true;
+			}
+			Refill();
+			return (int)cycles > 0;
+		}
+
+		// Cycles used so far, overshoot included.
+		u64 Used() const { return m_Used + (u32)(m_Slice - cycles); }
+
+		// Asked where a block ends with the slice used up: whether the guest
+		// is back where Idle() started watching, without having written a
+		// byte since.
+		bool Idle(const CPU& cpu, Memory& ram);
+
+		// Brings the memory's clock up to the cycles used and runs the events
+		// that came due.
+		void Sync()
+		{
+			if (m_Ram)
+			{
+				u64 used = Used();
+				m_Ram->Advance(used - m_Synced);
+				m_Synced = used;
+			}
+		}
+
+		// Passes the time up to the next event, or to the end of the budget if
+		// that comes first; false then.
+		bool Skip()
+		{
+			u64 used = Used();
+			u64 left = used < m_Total ? m_Total - used : 0;
+			u64 until = m_Ram ? m_Ram->UntilEvent() : ~0ull;
+			m_Used = used + std::min(left, until);
+			m_Slice = cycles = 0;
+			Sync();
+			Refill();
+			return until <= left;
+		}
+
+		// Has every block end come to Stop(), or not any more.
+		void Poll(bool poll)
+		{
+			m_Polling = poll;
+		}
+
+		// Ends the slice early if events or polling want a shorter one.
+		void Fit()
+		{
+			if ((int)cycles > (int)Limit())
+			{
+				Refill();
+			}
+		}
+
+		u32 cycles = 0;
+
+	private:
+		u32 Limit() const
+		{
+			u32 limit = m_Probes > 0 || m_Polling ? 1 : SLICE;
+			return m_Ram ? (u32)std::clamp<u64>(m_Ram->UntilEvent(), 1, limit) : limit;
+		}
+
+		void Refill()
+		{
+			m_Used = Used();
+			m_Slice = cycles = m_Used < m_Total ? (u32)std::min<u64>(m_Total - m_Used, Limit()) : 0;
+		}
+
+		u64 m_Total;
+		Memory* m_Ram;
+		u64 m_Used = 0;
+		u64 m_Synced = 0;	// Used() as of the last Sync()
+		u32 m_Slice = 0;
+		u32 m_Probes = 0;	// block ends left to watch
+		u64 m_NextWatch = 0;	// Used() before which Idle() does not start watching again
+		CPU m_Start;		// the state they are compared with
+		bool m_Polling = false;
+	};
+
+	// How the instruction that ended a block did, as far as Stops() cares.
+	enum class Ending : byte
+	{
+		Normal,
+		Halt,		// a JMP to itself, which only an interrupt can leave
+		Invalid,
+	};
+
+	// The ending of `opcode`, run at `pc` and leaving PC at `next`.
+	inline Ending EndOf(byte opcode, word pc, word next)
+	{
+		if (s_Traits[opcode].invalid)
+		{
+			return Ending::Invalid;
+		}
+		return opcode == CPU::INS_JMP_ABS && next == pc ? Ending::Halt : Ending::Normal;
+	}
+
+	// Whether Execute() returns where a block ends, and why. Every engine
+	// stops through here; the common case of carrying on is kept inline.
+	// Also where the clock catches up with the budget and interrupts are
+	// taken, so `cpu` may come back in a handler; a halted or idle guest has
+	// its time passed up to the next event in one go.
+	bool Stop(Ending ending, CPU& cpu, Memory& ram, Budget& budget, StopReason& reason);
+
+	// Whether Stop() has anything to decide with `cycles` left in the
+	// budget, for engines that have to put the CPU or the budget together
+	// first.
+	inline bool MayStop(Ending ending, const Memory& ram, u32 cycles)
+	{
+		return ending != Ending::Normal || (int)cycles <= 0 || ram.Requested();
+	}
+
+	inline bool Stops(Ending ending, CPU& cpu, Memory& ram, Budget& budget, StopReason& reason)
+	{
+		return MayStop(ending, ram, budget.cycles) && Stop(ending, cpu, ram, budget, reason);
+	}
+
+	// Sees every instruction Run() retires: where it started, its opcode and
+	// the cycles it took, with `cpu` already past it, and every interrupt
+	// taken, with `cpu` in the handler. NoProbe's empty hooks compile away,
+	// so CPU::Execute pays nothing for them; see Profiler for one that
+	// records.
+	struct NoProbe
+	{
+		void Retired(const CPU&, word, byte, u32) {}
+		void Interrupted(const CPU&) {}
+	};
+
+	// CPU::ExecuteTable's loop. Without `breakpoints` their test is one
+	// predictable branch per instruction; a second instantiation to drop it
+	// would cost more, by crowding the inlining budget of dispatch.cpp.
+	template <typename Probe>
+	inline ExecResult Run(CPU& cpu, u64 cycles, Memory& ram, Probe& probe, const Breakpoints* breakpoints = nullptr)
+	{
+		Budget budget(cycles, &ram);
+		StopReason reason = StopReason::Budget;
+		if (budget.Remaining())
+		{
+			// counted down in a local, which stays in a register across the
+			// handlers, and written back to the budget only to stop
+			u32 left = budget.cycles;
+			for (;;)
+			{
+				word pc = cpu.PC;
+				u32 before = left;
+				byte ins = Fetch(cpu, ram);
+				s_Table[ins](cpu, left, ram);
+				probe.Retired(cpu, pc, ins, before - left);
+
+				if (s_Traits[ins].endsBlock)
+				{
+					Ending ending = EndOf(ins, pc, cpu.PC);
+					if (MayStop(ending, ram, left))
+					{
+						word sp = cpu.SP;
+						budget.cycles = left;
+						if (Stop(ending, cpu, ram, budget, reason))
+						{
+							break;
+						}
+						left = budget.cycles;
+						if (cpu.SP != sp)
+						{
+							probe.Interrupted(cpu);
+						}
+					}
+				}
+				if (breakpoints && breakpoints->Has(cpu.PC))
+				{
+					budget.cycles = left;
+					budget.Sync();
+					reason = StopReason::Breakpoint;
+					break;
+				}
+			}
+		}
+		ram.Flush();
+		return { budget.Used(), reason };
+	}
+}
+
+/// Expands M(0x00) M(0x01) ... M(0xFF), used to emit one label per opcode.
+#define VM_OPCODE_ROW(M, h) \
+	M(0x##h##0) M(0x##h##1) M(0x##h##2) M(0x##h##3) M(0x##h##4) M(0x##h##5) M(0x##h##6) M(0x##h##7) \
+	M(0x##h##8) M(0x##h##9) M(0x##h##A) M(0x##h##B) M(0x##h##C) M(0x##h##D) M(0x##h##E) M(0x##h##F)
+#define VM_FOR_EACH_OPCODE(M) \
+	VM_OPCODE_ROW(M, 0) VM_OPCODE_ROW(M, 1) VM_OPCODE_ROW(M, 2) VM_OPCODE_ROW(M, 3) \
+	VM_OPCODE_ROW(M, 4) VM_OPCODE_ROW(M, 5) VM_OPCODE_ROW(M, 6) VM_OPCODE_ROW(M, 7) \
+	VM_OPCODE_ROW(M, 8) VM_OPCODE_ROW(M, 9) VM_OPCODE_ROW(M, A) VM_OPCODE_ROW(M, B) \
+	VM_OPCODE_ROW(M, C) VM_OPCODE_ROW(M, D) VM_OPCODE_ROW(M, E) VM_OPCODE_ROW(M, F)
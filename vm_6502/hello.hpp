@@ -0,0 +1,138 @@
+#pragma once
+
+/// The program vm_6502 boots without an image. It prints "Hello World!" one
+/// character at a time through ISR 1; as written it then misses its halt and
+/// keeps printing memory, so it never stops by itself. Laid out as
+///
+/// 0x0000 - 0x00FF: Stack + ZeroPage
+/// 0x0100 - 0xF0FF: Free to use	(not hardcoded)	Basically both free to use
+/// 0xF100 - 0xFDFA: ISR Handlering	(not hardcoded)
+/// 0xFDFC - 0xFFFB: ISR table
+/// 0xFFFC - 0xFFFE: Startup code
+/// 0xFFFF		   : Output char
+inline constexpr const char* HELLO_WORLD = R"(
+CONSOLE = $FFFF
+ISR_TABLE = $FDFC
+
+; DATA SEGMENT
+
+		.org $0000
+		.byte 0
+
+; ISR HANDLERS
+
+		.org $F100
+
+; interrupt 0 (ISR)
+; Sets A to 0x69
+isr0:	LDA #$69
+		RTI
+
+; interrupt 1 (ISR)
+; Prints char
+isr1:	SDX CONSOLE
+		RTI
+
+; interrupt 255 (ISR)
+; Halts CPU (by jumping)
+isr255:	JMP isr1
+		RTI						; just in case
+
+; interrupt 5 (ISR)
+; prints invalid opcode
+;
+; push message to the stack
+isr5:	PHA
+		LDA #'I'
+		PHA
+		LDA #'n'
+		PHA
+		LDA #'v'
+		PHA
+		LDA #'a'
+		PHA
+		LDA #'l'
+		PHA
+		LDA #'i'
+		PHA
+		LDA #'d'
+		PHA
+		LDA #' '
+		PHA
+		LDA #'o'
+		PHA
+		LDA #'p'
+		PHA
+		LDA #'c'
+		PHA
+		LDA #'o'
+		PHA
+		LDA #'d'
+		PHA
+		LDA #'e'
+		PHA
+		LDA #'\n'
+		PHA
+; print message 13
+print:	INY
+		PLA
+		SDA CONSOLE
+		CPY #15
+		BEQ * + 6				; one past the RTI
+		JMP print
+		RTI
+
+; ISR TABLE
+
+		.org ISR_TABLE + 0 * 2
+		.word isr0				; ISR = 0
+		.word isr1				; ISR = 1
+		.org ISR_TABLE + 5 * 2
+		.word isr5				; ISR = 5 (invalid opcode)
+		.org ISR_TABLE + 255 * 2
+		.word isr255			; ISR = 256
+
+; STARTUP
+
+		.org $FFFC
+reset:	JMP start				; Startup jump to address 0x0100
+
+; PROGRAM GOES HERE
+
+		.org $0100
+start:	LDA #'H'
+		SDA $00
+		LDA #'e'
+		SDA $01
+		LDA #'l'
+		SDA $02
+		LDA #'l'
+		SDA $03
+		LDA #'o'
+		SDA $04
+		LDA #' '
+		SDA $05
+		LDA #'W'
+		SDA $06
+		LDA #'o'
+		SDA $07
+		LDA #'r'
+		SDA $08
+		LDA #'l'
+		SDA $09
+		LDA #'d'
+		SDA $0A
+		LDA #'!'
+		SDA $0B
+		LDA #'\n'
+		SDA $0C
+
+		LDA #$01				; load interrupt number to A: interrupt 1 (printing char in 0xFFFF)
+		INY						; increment Y (string loop counter)
+		LDX $02,Y				; load sysmbol from ZP:Y (zp -> Y offset) to X
+		BRK						; call interrupt
+		CPY #$0D				; compare Y to value
+		BEQ halt				; jump if equal
+		JMP $0102				; if previous doesn't executes, jump to the beging;
+halt:	JMP $010D				; will jump to here (loop uses as halt)
+)";
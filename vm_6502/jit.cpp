@@ -0,0 +1,1074 @@
+#include "jit.hpp"
+#include "dispatch.hpp"
+
+#if VM_JIT_X64
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+/// Guest state while the JIT runs, laid out so generated code can address
+/// every field with an 8-bit displacement from one register.
+struct JitState
+{
+	Memory* ram;
+	const byte* const* readPages;
+	byte* const* writePages;
+	u32 cycles;
+	u32 zn;			// CPU::ZN
+	u32 epoch;		// ram->CodeEpoch() when native code was entered
+	u32 scratch;
+	word PC, SP;
+	byte A, X, Y;
+	byte C, I, D, B, V;
+	byte stale;		// a store changed a watched code page
+	byte open;		// native code left before the end of a block
+	byte halted;	// native code left on a JMP to itself
+	byte wait;		// a device wants Execute() to look (Memory::Requested)
+
+	void Load(const CPU& cpu)
+	{
+		PC = cpu.PC;
+		SP = cpu.SP;
+		A = cpu.A;
+		X = cpu.X;
+		Y = cpu.Y;
+		C = cpu.C;
+		I = cpu.I;
+		D = cpu.D;
+		B = cpu.B;
+		V = cpu.V;
+		zn = cpu.ZN;
+	}
+
+	void Store(CPU& cpu) const
+	{
+		cpu.PC = PC;
+		cpu.SP = SP;
+		cpu.A = A;
+		cpu.X = X;
+		cpu.Y = Y;
+		cpu.C = C;
+		cpu.I = I;
+		cpu.D = D;
+		cpu.B = B;
+		cpu.V = V;
+		cpu.ZN = (word)zn;
+	}
+};
+
+namespace
+{
+	constexpr size_t CODE_SIZE = 4 * 1024 * 1024;
+
+	/* SLOW PATHS, CALLED FROM GENERATED CODE */
+
+	u32 ReadSlow(JitState* state, u32 address)
+	{
+		byte data = state->ram->Read(address);
+		state->wait |= state->ram->Requested();
+		return data;
+	}
+
+	void WriteSlow(JitState* state, u32 address, u32 data)
+	{
+		state->ram->Write(address, (byte)data);
+		if (state->ram->CodeEpoch() != state->epoch)
+		{
+			state->stale = 1;
+		}
+		state->wait |= state->ram->Requested();
+	}
+
+	/* EMITTER */
+
+	enum Reg : byte { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+
+	enum Cond : byte { CC_B = 0x2, CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5, CC_A = 0x7, CC_LE = 0xE };
+
+	// guest registers live in callee-saved registers, so slow-path calls keep them
+	constexpr Reg REG_STATE = RBX;
+	constexpr Reg REG_ZN = RBP;
+	constexpr Reg REG_A = R12;
+	constexpr Reg REG_X = R13;
+	constexpr Reg REG_Y = R14;
+	constexpr Reg REG_CYCLES = R15;
+
+#if defined(_WIN32)
+	constexpr Reg ARG0 = RCX, ARG1 = RDX, ARG2 = R8;
+	constexpr byte FRAME = 40;		// shadow space, keeps rsp 16-byte aligned
+#else
+	constexpr Reg ARG0 = RDI, ARG1 = RSI, ARG2 = RDX;
+	constexpr byte FRAME = 8;		// keeps rsp 16-byte aligned
+#endif
+
+	constexpr Reg SAVED[] = { RBX, RBP, R12, R13, R14, R15 };
+
+	constexpr byte FIELD(size_t offset)
+	{
+		return offset < 0x80 ? (byte)offset : throw "JitState field out of disp8 range";
+	}
+
+	constexpr byte F_CYCLES = FIELD(offsetof(JitState, cycles));
+	constexpr byte F_ZN = FIELD(offsetof(JitState, zn));
+	constexpr byte F_SCRATCH = FIELD(offsetof(JitState, scratch));
+	constexpr byte F_PC = FIELD(offsetof(JitState, PC));
+	constexpr byte F_SP = FIELD(offsetof(JitState, SP));
+	constexpr byte F_A = FIELD(offsetof(JitState, A));
+	constexpr byte F_X = FIELD(offsetof(JitState, X));
+	constexpr byte F_Y = FIELD(offsetof(JitState, Y));
+	constexpr byte F_C = FIELD(offsetof(JitState, C));
+	constexpr byte F_I = FIELD(offsetof(JitState, I));
+	constexpr byte F_D = FIELD(offsetof(JitState, D));
+	constexpr byte F_V = FIELD(offsetof(JitState, V));
+	constexpr byte F_STALE = FIELD(offsetof(JitState, stale));
+	constexpr byte F_OPEN = FIELD(offsetof(JitState, open));
+	constexpr byte F_HALTED = FIELD(offsetof(JitState, halted));
+	constexpr byte F_WAIT = FIELD(offsetof(JitState, wait));
+	constexpr byte F_READ_PAGES = FIELD(offsetof(JitState, readPages));
+	constexpr byte F_WRITE_PAGES = FIELD(offsetof(JitState, writePages));
+
+	struct Label
+	{
+		size_t position = SIZE_MAX;
+		std::vector<size_t> uses;	// rel32 fields that jump here
+	};
+
+	// Just the handful of x86-64 instructions the translator needs. Register
+	// arguments are full registers; the operand size is in the method name.
+	struct Emitter
+	{
+		std::vector<byte> code;
+
+		void Byte(u32 value) { code.push_back((byte)value); }
+		void Dword(u32 value)
+		{
+			for (int i = 0; i < 4; i++)
+			{
+				Byte(value >> (i * 8));
+			}
+		}
+		void Qword(u64 value)
+		{
+			Dword((u32)value);
+			Dword((u32)(value >> 32));
+		}
+
+		// `force` also emits an empty REX, so that byte registers 4-7 mean spl..dil
+		void Rex(bool wide, u32 reg, u32 index, u32 base, bool force = false)
+		{
+			byte rex = 0x40 | (wide << 3) | ((reg >> 3) << 2) | ((index >> 3) << 1) | (base >> 3);
+			if (rex != 0x40 || force)
+			{
+				Byte(rex);
+			}
+		}
+		void Direct(u32 reg, u32 rm) { Byte(0xC0 | ((reg & 7) << 3) | (rm & 7)); }
+		// [rbx + disp8]
+		void Field(u32 reg, byte offset)
+		{
+			Byte(0x40 | ((reg & 7) << 3) | REG_STATE);
+			Byte(offset);
+		}
+		// [base + index * scale], base is never rbp/r13
+		void Indexed(u32 reg, Reg base, Reg index, u32 scaleLog2)
+		{
+			Byte(0x04 | ((reg & 7) << 3));
+			Byte((scaleLog2 << 6) | ((index & 7) << 3) | (base & 7));
+		}
+
+		// add 01, or 09, and 21, sub 29, xor 31, cmp 39, mov 89: dst op= src
+		void Op32(byte opcode, Reg dst, Reg src) { Rex(false, src, 0, dst); Byte(opcode); Direct(src, dst); }
+		void Mov64(Reg dst, Reg src) { Rex(true, src, 0, dst); Byte(0x89); Direct(src, dst); }
+		// add /0, or /1, and /4, sub /5, xor /6, cmp /7
+		void OpImm32(byte ext, Reg dst, u32 imm) { Rex(false, 0, 0, dst); Byte(0x81); Direct(ext, dst); Dword(imm); }
+		void MovImm32(Reg dst, u32 imm) { Rex(false, 0, 0, dst); Byte(0xB8 + (dst & 7)); Dword(imm); }
+		void MovImm64(Reg dst, u64 imm) { Rex(true, 0, 0, dst); Byte(0xB8 + (dst & 7)); Qword(imm); }
+		void Movzx8(Reg dst, Reg src) { Rex(false, dst, 0, src, true); Byte(0x0F); Byte(0xB6); Direct(dst, src); }
+		void Inc8(Reg reg) { Rex(false, 0, 0, reg, true); Byte(0xFE); Direct(0, reg); }
+		void Dec8(Reg reg) { Rex(false, 0, 0, reg, true); Byte(0xFE); Direct(1, reg); }
+		void Shr32(Reg reg, byte count) { Rex(false, 0, 0, reg); Byte(0xC1); Direct(5, reg); Byte(count); }
+		void Shl32(Reg reg, byte count) { Rex(false, 0, 0, reg); Byte(0xC1); Direct(4, reg); Byte(count); }
+		void Test32(Reg a, Reg b) { Rex(false, b, 0, a); Byte(0x85); Direct(b, a); }
+		void Test64(Reg a, Reg b) { Rex(true, b, 0, a); Byte(0x85); Direct(b, a); }
+		// dst = [src], src is never rsp/rbp/r12/r13
+		void LoadIndirect64(Reg dst, Reg src) { Rex(true, dst, 0, src); Byte(0x8B); Byte(((dst & 7) << 3) | (src & 7)); }
+		void TestImm32(Reg reg, u32 imm) { Rex(false, 0, 0, reg); Byte(0xF7); Direct(0, reg); Dword(imm); }
+
+		void Load8(Reg dst, byte field) { Rex(false, dst, 0, REG_STATE); Byte(0x0F); Byte(0xB6); Field(dst, field); }
+		void Load16(Reg dst, byte field) { Rex(false, dst, 0, REG_STATE); Byte(0x0F); Byte(0xB7); Field(dst, field); }
+		void Load32(Reg dst, byte field) { Rex(false, dst, 0, REG_STATE); Byte(0x8B); Field(dst, field); }
+		void Load64(Reg dst, byte field) { Rex(true, dst, 0, REG_STATE); Byte(0x8B); Field(dst, field); }
+		void Store8(byte field, Reg src) { Rex(false, src, 0, REG_STATE, true); Byte(0x88); Field(src, field); }
+		void Store16(byte field, Reg src) { Byte(0x66); Rex(false, src, 0, REG_STATE); Byte(0x89); Field(src, field); }
+		void Store32(byte field, Reg src) { Rex(false, src, 0, REG_STATE); Byte(0x89); Field(src, field); }
+		void StoreImm8(byte field, byte imm) { Byte(0xC6); Field(0, field); Byte(imm); }
+		void StoreImm16(byte field, word imm) { Byte(0x66); Byte(0xC7); Field(0, field); Byte(imm); Byte(imm >> 8); }
+		void CmpImm8(byte field, byte imm) { Byte(0x80); Field(7, field); Byte(imm); }
+		void Set(Cond cond, byte field) { Byte(0x0F); Byte(0x90 | cond); Field(0, field); }
+
+		// dst = [base + index * 8]
+		void LoadTable(Reg dst, Reg base, Reg index) { Rex(true, dst, index, base); Byte(0x8B); Indexed(dst, base, index, 3); }
+		// dst = dword [base + index * 4]
+		void LoadTable32(Reg dst, Reg base, Reg index) { Rex(false, dst, index, base); Byte(0x8B); Indexed(dst, base, index, 2); }
+		// dst = byte [base + index]
+		void LoadIndexed8(Reg dst, Reg base, Reg index) { Rex(false, dst, index, base); Byte(0x0F); Byte(0xB6); Indexed(dst, base, index, 0); }
+		// byte [base + index] = src
+		void StoreIndexed8(Reg base, Reg index, Reg src) { Rex(false, src, index, base, true); Byte(0x88); Indexed(src, base, index, 0); }
+
+		void Push(Reg reg) { Rex(false, 0, 0, reg); Byte(0x50 + (reg & 7)); }
+		void Pop(Reg reg) { Rex(false, 0, 0, reg); Byte(0x58 + (reg & 7)); }
+		void AddRsp(byte imm) { Byte(0x48); Byte(0x83); Direct(0, RSP); Byte(imm); }
+		void SubRsp(byte imm) { Byte(0x48); Byte(0x83); Direct(5, RSP); Byte(imm); }
+		void Call(const void* function)
+		{
+			Byte(0x48); Byte(0xB8); Qword((u64)function);		// mov rax, imm64
+			Byte(0xFF); Byte(0xD0);								// call rax
+		}
+		void Ret() { Byte(0xC3); }
+		void JumpIndirect(Reg reg) { Rex(false, 0, 0, reg); Byte(0xFF); Direct(4, reg); }
+
+		void Jump(Label& label) { Byte(0xE9); Target(label); }
+		void Jump(Cond cond, Label& label) { Byte(0x0F); Byte(0x80 | cond); Target(label); }
+		void Target(Label& label)
+		{
+			if (label.position != SIZE_MAX)
+			{
+				Dword((u32)(label.position - (code.size() + 4)));
+				return;
+			}
+			label.uses.push_back(code.size());
+			Dword(0);
+		}
+		void Bind(Label& label)
+		{
+			label.position = code.size();
+			for (size_t use : label.uses)
+			{
+				u32 rel = (u32)(label.position - (use + 4));
+				std::memcpy(&code[use], &rel, 4);
+			}
+		}
+	};
+
+	/* INSTRUCTION FORMS */
+
+	using dispatch::Addressing;
+	using dispatch::Condition;
+	using dispatch::Form;
+	using dispatch::LoadFlags;
+	using dispatch::Operation;
+
+	// Where the translation keeps the guest register a Form names.
+	Reg Host(dispatch::Register reg)
+	{
+		return reg == dispatch::Register::A ? REG_A : reg == dispatch::Register::X ? REG_X : REG_Y;
+	}
+
+	// Whether the translator has code for `form`; the rest are left to the
+	// interpreter.
+	bool Translates(const Form& form)
+	{
+		switch (form.operation)
+		{
+			case Operation::Invalid:
+			case Operation::PHP:
+			case Operation::PLP:
+			case Operation::BRK:
+			case Operation::RTI:
+				return false;
+			default:
+				return true;
+		}
+	}
+
+	/* TRANSLATOR */
+
+	// Where an exit goes on in another block's translation, rather than back
+	// to Execute(): `slot` is that block's Entry::chain.
+	struct ChainExit
+	{
+		Label label;
+		word pc;
+		const byte* const* slot;
+	};
+
+	struct Translator
+	{
+		Emitter e;
+		word start;
+		Label body;
+		Label epilogue;
+		std::deque<std::pair<Label, word>> exits;	// stubs that leave with PC = second
+		std::deque<std::pair<Label, word>> openExits;	// the same, before the block has ended
+		std::deque<ChainExit> chains;
+		std::function<const byte* const*(word pc)> slotOf;
+		bool loops = false;		// goes back to its own start
+
+		void Prologue()
+		{
+			for (Reg reg : SAVED)
+			{
+				e.Push(reg);
+			}
+			e.SubRsp(FRAME);
+			e.Mov64(REG_STATE, ARG0);
+			e.Load8(REG_A, F_A);
+			e.Load8(REG_X, F_X);
+			e.Load8(REG_Y, F_Y);
+			e.Load32(REG_CYCLES, F_CYCLES);
+			e.Load32(REG_ZN, F_ZN);
+			e.Bind(body);
+		}
+
+		void Epilogue()
+		{
+			// on into the next block under the same checks as a loop back
+			// (see Continue), when it is translated
+			for (ChainExit& chain : chains)
+			{
+				Label& exit = Exit(chain.pc);
+				e.Bind(chain.label);
+				e.Test32(REG_CYCLES, REG_CYCLES);
+				e.Jump(CC_LE, exit);
+				e.CmpImm8(F_WAIT, 0);
+				e.Jump(CC_NE, exit);
+				e.MovImm64(RAX, (u64)chain.slot);
+				e.LoadIndirect64(RAX, RAX);
+				e.Test64(RAX, RAX);
+				e.Jump(CC_E, exit);
+				e.JumpIndirect(RAX);
+			}
+			for (auto& [label, pc] : exits)
+			{
+				e.Bind(label);
+				e.StoreImm16(F_PC, pc);
+				e.Jump(epilogue);
+			}
+			for (auto& [label, pc] : openExits)
+			{
+				e.Bind(label);
+				e.StoreImm8(F_OPEN, 1);
+				e.StoreImm16(F_PC, pc);
+				e.Jump(epilogue);
+			}
+
+			e.Bind(epilogue);
+			e.Store8(F_A, REG_A);
+			e.Store8(F_X, REG_X);
+			e.Store8(F_Y, REG_Y);
+			e.Store32(F_CYCLES, REG_CYCLES);
+			e.Store32(F_ZN, REG_ZN);
+			e.AddRsp(FRAME);
+			for (size_t i = std::size(SAVED); i-- > 0;)
+			{
+				e.Pop(SAVED[i]);
+			}
+			e.Ret();
+		}
+
+		Label& Exit(word pc)
+		{
+			exits.emplace_back();
+			exits.back().second = pc;
+			return exits.back().first;
+		}
+
+		// Leaves where the block ends, or goes on into the block at `pc`.
+		Label& Chain(word pc)
+		{
+			chains.emplace_back();
+			chains.back().pc = pc;
+			chains.back().slot = slotOf(pc);
+			return chains.back().label;
+		}
+
+		// Leaves mid-block, so Execute() carries on without its stop checks.
+		Label& OpenExit(word pc)
+		{
+			openExits.emplace_back();
+			openExits.back().second = pc;
+			return openExits.back().first;
+		}
+
+		// Control moves to `target` after an instruction ending the block.
+		// Looping back to the start takes the place of Execute()'s stop checks,
+		// as far as native code can make them.
+		void Continue(word target)
+		{
+			if (target == start)
+			{
+				loops = true;
+				e.Test32(REG_CYCLES, REG_CYCLES);
+				e.Jump(CC_LE, Exit(target));
+				e.CmpImm8(F_WAIT, 0);
+				e.Jump(CC_NE, Exit(target));
+				e.Jump(body);
+			}
+			else
+			{
+				e.Jump(Chain(target));
+			}
+		}
+
+		// eax = effective address
+		void Address(Addressing mode, word operand)
+		{
+			e.MovImm32(RAX, operand);
+			switch (mode)
+			{
+				case Addressing::ZeroPageX:
+				case Addressing::AbsoluteX:
+					e.Op32(0x01, RAX, REG_X);
+					break;
+				case Addressing::ZeroPageY:
+				case Addressing::AbsoluteY:
+					e.Op32(0x01, RAX, REG_Y);
+					break;
+				case Addressing::ZeroPageYWrapped:
+					e.Op32(0x01, RAX, REG_Y);
+					e.Movzx8(RAX, RAX);
+					break;
+				default:
+					break;
+			}
+		}
+
+		// Whether Address() of `mode` is always in the address space; only
+		// the indexed absolute modes can run past it.
+		static bool Fits(Addressing mode)
+		{
+			return mode != Addressing::AbsoluteX && mode != Addressing::AbsoluteY;
+		}
+
+		// eax = byte at address eax; `fits` drops the check that it is in the
+		// address space
+		void Read(bool fits = false)
+		{
+			Label slow, done;
+			if (!fits)
+			{
+				e.OpImm32(7, RAX, Memory::MAX_MEM - 1);
+				e.Jump(CC_A, slow);
+			}
+			e.Op32(0x89, RCX, RAX);
+			e.Shr32(RCX, 8);
+			e.Load64(RDX, F_READ_PAGES);
+			e.LoadTable(RDX, RDX, RCX);
+			e.Test64(RDX, RDX);
+			e.Jump(CC_E, slow);
+			e.Movzx8(RAX, RAX);
+			e.LoadIndexed8(RAX, RDX, RAX);
+			e.Jump(done);
+
+			e.Bind(slow);
+			e.Op32(0x89, ARG1, RAX);
+			e.Mov64(ARG0, REG_STATE);
+			e.Call(reinterpret_cast<const void*>(&ReadSlow));
+			e.Bind(done);
+		}
+
+		// byte at address eax = cl, `fits` as for Read()
+		void Write(bool fits = false)
+		{
+			Label slow, done;
+			if (!fits)
+			{
+				e.OpImm32(7, RAX, Memory::MAX_MEM - 1);
+				e.Jump(CC_A, slow);
+			}
+			e.Op32(0x89, R9, RAX);
+			e.Shr32(R9, 8);
+			e.Load64(R10, F_WRITE_PAGES);
+			e.LoadTable(R10, R10, R9);
+			e.Test64(R10, R10);
+			e.Jump(CC_E, slow);
+			e.Movzx8(RAX, RAX);
+			e.StoreIndexed8(R10, RAX, RCX);
+			e.Jump(done);
+
+			e.Bind(slow);
+			e.Op32(0x89, ARG2, RCX);
+			e.Op32(0x89, ARG1, RAX);
+			e.Mov64(ARG0, REG_STATE);
+			e.Call(reinterpret_cast<const void*>(&WriteSlow));
+			e.Bind(done);
+		}
+
+		// eax = SP + delta, as the u32 the interpreter would index with
+		void StackAddress(u32 delta)
+		{
+			e.Load16(RAX, F_SP);
+			if (delta)
+			{
+				e.OpImm32(0, RAX, delta);
+			}
+		}
+
+		void AdjustSP(u32 delta)
+		{
+			e.Load16(RDX, F_SP);
+			e.OpImm32(0, RDX, delta);
+			e.Store16(F_SP, RDX);
+		}
+
+		void Operand(const Form& form, word operand)
+		{
+			if (form.addressing == Addressing::Immediate)
+			{
+				e.MovImm32(RAX, (byte)operand);
+				return;
+			}
+			Address(form.addressing, operand);
+			Read(Fits(form.addressing));
+		}
+
+		// Emits one instruction; returns false when it ends the block.
+		bool Instruction(const Form& form, word pc, word operand, word next, u32 cycles)
+		{
+			e.OpImm32(5, REG_CYCLES, cycles);
+
+			bool writes = false;
+			switch (form.operation)
+			{
+				case Operation::ADC:
+				case Operation::SBC:
+				{
+					// binary computed as alu::Add() does, decimal one load from
+					// alu::s_Decimal, indexed as alu::Index() does, then the
+					// entry unpacked into A, C, V and ZN
+					Label decimal, done;
+					Operand(form, operand);
+					e.Load8(RCX, F_C);
+					e.CmpImm8(F_D, 0);
+					e.Jump(CC_NE, decimal);
+
+					if (form.operation == Operation::SBC)
+					{
+						e.OpImm32(6, RAX, 0xFF);
+					}
+					e.Op32(0x89, RDX, REG_A);
+					e.Op32(0x01, RDX, RAX);
+					e.Op32(0x01, RDX, RCX);
+					// V = (A ^ sum) & (data ^ sum) & 0x80
+					e.Op32(0x31, REG_A, RDX);
+					e.Op32(0x31, RAX, RDX);
+					e.Op32(0x21, RAX, REG_A);
+					e.Shr32(RAX, 7);
+					e.OpImm32(4, RAX, 1);
+					e.Store8(F_V, RAX);
+					e.Op32(0x89, RCX, RDX);
+					e.Shr32(RCX, 8);
+					e.Store8(F_C, RCX);
+					e.Movzx8(REG_A, RDX);
+					e.Op32(0x89, REG_ZN, REG_A);
+					e.Jump(done);
+
+					e.Bind(decimal);
+					e.Shl32(RAX, 8);
+					e.Op32(0x09, RAX, REG_A);
+					e.Shl32(RCX, 16);
+					e.Op32(0x09, RAX, RCX);
+					if (form.operation == Operation::SBC)
+					{
+						e.OpImm32(1, RAX, (u32)alu::SBC << 17);
+					}
+					e.MovImm64(RDX, (u64)alu::s_Decimal);
+					e.LoadTable32(RAX, RDX, RAX);
+					e.Movzx8(REG_A, RAX);
+					e.Op32(0x89, REG_ZN, RAX);
+					e.Shr32(REG_ZN, 16);
+					e.Op32(0x89, RCX, RAX);
+					e.Shr32(RCX, 8);
+					e.OpImm32(4, RCX, 1);
+					e.Store8(F_C, RCX);
+					e.Shr32(RAX, 9);
+					e.OpImm32(4, RAX, 1);
+					e.Store8(F_V, RAX);
+					e.Bind(done);
+					break;
+				}
+
+				case Operation::AND:
+				case Operation::ORA:
+				case Operation::EOR:
+					Operand(form, operand);
+					e.Op32(form.operation == Operation::AND ? 0x21 : form.operation == Operation::ORA ? 0x09 : 0x31, REG_A, RAX);
+					e.Op32(0x89, REG_ZN, REG_A);
+					break;
+
+				case Operation::Load:
+					Operand(form, operand);
+					e.Op32(0x89, Host(form.reg), RAX);
+					if (form.flags == LoadFlags::Result)
+					{
+						e.Op32(0x89, REG_ZN, RAX);
+					}
+					break;
+
+				case Operation::Compare:
+					Operand(form, operand);
+					e.Op32(0x39, Host(form.reg), RAX);
+					e.Set(CC_AE, F_C);
+					e.Op32(0x29, RAX, Host(form.reg));
+					e.Movzx8(REG_ZN, RAX);
+					break;
+
+				case Operation::INC:
+				case Operation::DEC:
+					Address(form.addressing, operand);
+					e.Store32(F_SCRATCH, RAX);
+					Read(Fits(form.addressing));
+					e.OpImm32(form.operation == Operation::INC ? 0 : 5, RAX, 1);
+					e.Movzx8(RCX, RAX);
+					e.Op32(0x89, REG_ZN, RCX);
+					e.Load32(RAX, F_SCRATCH);
+					Write(Fits(form.addressing));
+					writes = true;
+					break;
+
+				case Operation::Store:
+					Address(form.addressing, operand);
+					e.Op32(0x89, RCX, Host(form.reg));
+					Write(Fits(form.addressing));
+					writes = true;
+					break;
+
+				case Operation::CLC: e.StoreImm8(F_C, 0); break;
+				case Operation::CLD: e.StoreImm8(F_D, 0); break;
+				case Operation::SED: e.StoreImm8(F_D, 1); break;
+				case Operation::CLV: e.StoreImm8(F_V, 0); break;
+				case Operation::CLI: e.StoreImm8(F_I, 0); break;
+				case Operation::SEI: e.StoreImm8(F_I, 1); break;
+				case Operation::NOP: break;
+
+				case Operation::DEX:
+					e.Dec8(REG_X);
+					e.Op32(0x89, REG_ZN, REG_X);
+					break;
+				case Operation::DEY:
+					e.Dec8(REG_Y);
+					e.Op32(0x89, REG_ZN, REG_Y);
+					break;
+				case Operation::INX: e.Inc8(REG_X); break;
+				case Operation::INY: e.Inc8(REG_Y); break;
+
+				case Operation::PHA:
+					AdjustSP(-2u);
+					StackAddress(0);
+					e.Op32(0x31, RCX, RCX);
+					Write();
+					StackAddress(1);
+					e.Op32(0x89, RCX, REG_A);
+					Write();
+					writes = true;
+					break;
+
+				case Operation::PLA:
+					StackAddress(0);
+					Read();
+					StackAddress(1);
+					Read();
+					e.Op32(0x89, REG_A, RAX);
+					e.Op32(0x89, REG_ZN, RAX);
+					AdjustSP(2);
+					break;
+
+				case Operation::Branch:
+				{
+					Label& notTaken = Chain(next);
+					switch (form.condition)
+					{
+						case Condition::CarryClear:		e.CmpImm8(F_C, 0); e.Jump(CC_NE, notTaken); break;
+						case Condition::CarrySet:		e.CmpImm8(F_C, 0); e.Jump(CC_E, notTaken); break;
+						case Condition::ZeroSet:			e.TestImm32(REG_ZN, 0x0FF); e.Jump(CC_NE, notTaken); break;
+						case Condition::ZeroClear:		e.TestImm32(REG_ZN, 0x0FF); e.Jump(CC_E, notTaken); break;
+						case Condition::NegativeClear:	e.TestImm32(REG_ZN, 0x180); e.Jump(CC_NE, notTaken); break;
+						case Condition::OverflowClear:	e.CmpImm8(F_V, 0); e.Jump(CC_NE, notTaken); break;
+						case Condition::OverflowSet:		e.CmpImm8(F_V, 0); e.Jump(CC_E, notTaken); break;
+					}
+					e.OpImm32(5, REG_CYCLES, 1);
+					Continue((word)(next + (byte)operand));
+					return false;
+				}
+
+				case Operation::JMP:
+					if (operand == pc)
+					{
+						// a halt, which Execute() has to see
+						e.StoreImm8(F_HALTED, 1);
+						e.Jump(Exit(pc));
+						return false;
+					}
+					Continue(operand);
+					return false;
+
+				case Operation::JSR:
+				{
+					Label refetch;
+					AdjustSP(2);
+					StackAddress(0);
+					e.MovImm32(RCX, pc >> 8);
+					Write();
+					StackAddress(1);
+					e.MovImm32(RCX, pc & 0xFF);
+					Write();
+					e.CmpImm8(F_STALE, 0);
+					e.Jump(CC_NE, refetch);
+					Continue(operand);
+
+					// the push went to a code page, maybe over the operand,
+					// which the interpreter fetches after it
+					e.Bind(refetch);
+					e.MovImm32(RAX, (word)(pc + 1));
+					Read(true);
+					e.Store32(F_SCRATCH, RAX);
+					e.MovImm32(RAX, (word)(pc + 2));
+					Read(true);
+					e.Load32(RCX, F_SCRATCH);
+					e.Shl32(RCX, 8);
+					e.Op32(0x09, RAX, RCX);
+					e.Store16(F_PC, RAX);
+					e.Jump(epilogue);
+					return false;
+				}
+
+				case Operation::RTS:
+					StackAddress(0);
+					Read();
+					e.Store32(F_SCRATCH, RAX);
+					StackAddress(1);
+					Read();
+					e.Load32(RCX, F_SCRATCH);
+					e.Shl32(RCX, 8);
+					e.Op32(0x09, RAX, RCX);
+					e.Store16(F_PC, RAX);
+					AdjustSP(2);
+					e.Jump(epilogue);
+					return false;
+
+				// left to the interpreter (see Translates)
+				case Operation::Invalid:
+				case Operation::PHP:
+				case Operation::PLP:
+				case Operation::BRK:
+				case Operation::RTI:
+					return false;
+			}
+
+			if (writes)
+			{
+				e.CmpImm8(F_STALE, 0);
+				e.Jump(CC_NE, OpenExit(next));
+			}
+			return true;
+		}
+	};
+}
+
+Jit::Jit()
+{
+#if defined(_WIN32)
+	void* code = VirtualAlloc(nullptr, CODE_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+	void* code = mmap(nullptr, CODE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (code == MAP_FAILED)
+	{
+		code = nullptr;
+	}
+#endif
+	if (code)
+	{
+		m_Code = (byte*)code;
+		m_CodeSize = CODE_SIZE;
+	}
+}
+
+Jit::~Jit()
+{
+	if (m_Code)
+	{
+#if defined(_WIN32)
+		VirtualFree(m_Code, 0, MEM_RELEASE);
+#else
+		munmap(m_Code, m_CodeSize);
+#endif
+	}
+}
+
+ExecResult Jit::Execute(CPU& cpu, u64 cycles, Memory& ram)
+{
+	if (!m_Code)
+	{
+		return cpu.Execute(cycles, ram);
+	}
+	if (m_RamId != ram.Id())
+	{
+		Clear();
+		m_RamId = ram.Id();
+	}
+
+	dispatch::Budget budget(cycles, &ram);
+	StopReason reason = StopReason::Budget;
+
+	JitState state;
+	state.ram = &ram;
+	state.readPages = ram.ReadPages();
+	state.writePages = ram.WritePages();
+
+	// `cpu` is kept up to date outside of native code, so that interpreted
+	// blocks cost no copying
+	bool running = budget.Remaining();
+	while (running)
+	{
+		Entry& entry = Lookup(cpu.PC);
+		if ((entry.code || m_Interpreted[cpu.PC]) && !IsCurrent(entry, ram))
+		{
+			entry.code = nullptr;
+			entry.chain = nullptr;
+			m_Interpreted[cpu.PC] = false;
+		}
+		if (!entry.code && !m_Interpreted[cpu.PC] && ++entry.hits >= m_Threshold)
+		{
+			entry.hits = 0;
+			Translate(entry, cpu.PC, ram);
+		}
+
+		dispatch::Ending ending;
+		bool open = false;
+		if (entry.code)
+		{
+			if (ram.CodeEpoch() != m_ChainEpoch)
+			{
+				Unchain();
+				m_ChainEpoch = ram.CodeEpoch();
+			}
+			if (!entry.chain)
+			{
+				entry.chain = entry.body;
+				m_Chained.push_back(&entry);
+			}
+			state.Load(cpu);
+			state.epoch = ram.CodeEpoch();
+			state.stale = state.open = state.halted = state.wait = 0;
+			state.cycles = budget.cycles;
+			entry.code(&state);
+			budget.cycles = state.cycles;
+			state.Store(cpu);
+			open = state.open;
+			ending = state.halted ? dispatch::Ending::Halt : dispatch::Ending::Normal;
+			m_NativeRuns++;
+		}
+		else
+		{
+			ending = Interpret(cpu, ram, budget.cycles);
+		}
+
+		if (!open && dispatch::MayStop(ending, ram, budget.cycles))
+		{
+			running = !dispatch::Stop(ending, cpu, ram, budget, reason);
+		}
+	}
+
+	ram.Flush();
+	return { budget.Used(), reason };
+}
+
+void Jit::Clear()
+{
+	for (auto& page : m_Pages)
+	{
+		page.reset();
+	}
+	m_Interpreted.reset();
+	m_Chained.clear();
+	m_CodeUsed = 0;
+	m_RamId = 0;
+}
+
+Jit::Entry& Jit::Lookup(word pc)
+{
+	std::unique_ptr<EntryPage>& page = m_Pages[pc / Memory::PAGE_SIZE];
+	if (!page)
+	{
+		page = std::make_unique<EntryPage>();
+	}
+	return (*page)[pc % Memory::PAGE_SIZE];
+}
+
+bool Jit::IsCurrent(const Entry& entry, const Memory& ram) const
+{
+	return ram.CodeVersion(entry.firstPage) == entry.versions[0]
+		&& ram.CodeVersion(entry.lastPage) == entry.versions[1];
+}
+
+// Cuts every chain into a block, which may have changed since it was made.
+void Jit::Unchain()
+{
+	for (Entry* entry : m_Chained)
+	{
+		entry->chain = nullptr;
+	}
+	m_Chained.clear();
+}
+
+// Runs a block through the handler table, and the blocks after it for as
+// long as they are left to the interpreter too and Stop() has nothing to
+// decide, without going back to Execute() for each. Those are not checked
+// for changes: running them here is right either way, and Execute() checks
+// the block it comes back to after every stop, translating it again when it
+// has changed.
+dispatch::Ending Jit::Interpret(CPU& cpu, Memory& ram, u32& cycles)
+{
+	for (;;)
+	{
+		word pc;
+		byte ins;
+		do
+		{
+			pc = cpu.PC;
+			ins = dispatch::Fetch(cpu, ram);
+			dispatch::s_Table[ins](cpu, cycles, ram);
+		} while (!dispatch::s_Traits[ins].endsBlock);
+
+		dispatch::Ending ending = dispatch::EndOf(ins, pc, cpu.PC);
+		if (dispatch::MayStop(ending, ram, cycles) || !m_Interpreted[cpu.PC])
+		{
+			return ending;
+		}
+	}
+}
+
+void Jit::DropTranslations()
+{
+	for (auto& page : m_Pages)
+	{
+		if (page)
+		{
+			for (Entry& entry : *page)
+			{
+				entry.code = nullptr;
+				entry.body = nullptr;
+			}
+		}
+	}
+	Unchain();
+	m_CodeUsed = 0;
+}
+
+void Jit::Translate(Entry& entry, word pc, Memory& ram)
+{
+	Translator t;
+	t.start = pc;
+	t.slotOf = [this](word target) { return &Lookup(target).chain; };
+	t.Prologue();
+
+	byte firstPage = (byte)(pc / Memory::PAGE_SIZE);
+	byte lastPage = firstPage;
+
+	// same limits as BlockCache: at most two pages, no device pages
+	auto decodable = [&](u32 address)
+	{
+		u32 page = address / Memory::PAGE_SIZE;
+		return address < Memory::MAX_MEM && page <= firstPage + 1u && !ram.HasDevice(page);
+	};
+
+	u32 address = pc;
+	u32 count = 0;
+	bool open = true;
+	while (open && decodable(address))
+	{
+		byte opcode = ram.Read(address);
+		const dispatch::Decoding& decoding = dispatch::s_Decoding[opcode];
+		u32 last = address + decoding.length - 1;
+		const Form& form = dispatch::s_Forms[opcode];
+		if (!decodable(last) || !Translates(form))
+		{
+			break;
+		}
+
+		word operand = 0;
+		for (u32 i = 1; i < decoding.length; i++)
+		{
+			operand = (word)(operand << 8) | ram.Read(address + i);
+		}
+		word next = (word)(address + decoding.length);
+		open = t.Instruction(form, (word)address, operand, next, decoding.cycles);
+
+		lastPage = (byte)(last / Memory::PAGE_SIZE);
+		address += decoding.length;
+		count++;
+	}
+	ram.WatchCode(firstPage);
+	ram.WatchCode(lastPage);
+	entry.firstPage = firstPage;
+	entry.lastPage = lastPage;
+	entry.versions[0] = ram.CodeVersion(firstPage);
+	entry.versions[1] = ram.CodeVersion(lastPage);
+	// a short block is only worth entering native code for when it stays
+	// there, looping or going on into another block that may be translated
+	bool stays = !open && (t.loops || std::any_of(t.chains.begin(), t.chains.end(),
+		[&](const ChainExit& chain) { return !m_Interpreted[chain.pc]; }));
+	if (count < MIN_NATIVE && !stays)
+	{
+		m_Interpreted[pc] = true;
+		return;
+	}
+	if (open)
+	{
+		t.e.Jump(t.OpenExit((word)address));
+	}
+	t.Epilogue();
+
+	const std::vector<byte>& code = t.e.code;
+	if (code.size() > m_CodeSize)
+	{
+		return;
+	}
+	if (m_CodeUsed + code.size() > m_CodeSize)
+	{
+		DropTranslations();
+	}
+
+	byte* target = m_Code + m_CodeUsed;
+#if defined(_WIN32)
+	DWORD old;
+	VirtualProtect(m_Code, m_CodeSize, PAGE_READWRITE, &old);
+	std::memcpy(target, code.data(), code.size());
+	VirtualProtect(m_Code, m_CodeSize, PAGE_EXECUTE_READ, &old);
+	FlushInstructionCache(GetCurrentProcess(), target, code.size());
+#else
+	mprotect(m_Code, m_CodeSize, PROT_READ | PROT_WRITE);
+	std::memcpy(target, code.data(), code.size());
+	mprotect(m_Code, m_CodeSize, PROT_READ | PROT_EXEC);
+#endif
+	m_CodeUsed += (code.size() + 15) & ~(size_t)15;
+
+	entry.code = (Native)target;
+	entry.body = target + t.body.position;
+	m_Translated++;
+}
+
+#else
+
+Jit::Jit() {}
+Jit::~Jit() {}
+
+ExecResult Jit::Execute(CPU& cpu, u64 cycles, Memory& ram)
+{
+	return cpu.Execute(cycles, ram);
+}
+
+void Jit::Clear() {}
+
+#endif
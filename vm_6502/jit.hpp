@@ -0,0 +1,95 @@
+#pragma once
+#include <array>
+#include <bitset>
+#include <memory>
+#include <vector>
+#include "dispatch.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define VM_JIT_X64 1
+#else
+#define VM_JIT_X64 0
+#endif
+
+struct JitState;
+
+/// Dynamic translator from 6502 basic blocks to x86-64 code, an alternative
+/// to CPU::Execute for long-running guest programs.
+///
+/// Blocks (cut as in BlockCache) are interpreted and counted until one has
+/// started m_Threshold times, then it is translated into an executable buffer.
+/// Translated code keeps A, X, Y, the cycle budget and the value Z and N are
+/// derived from in host registers; Z and N themselves are only worked out when
+/// control returns to the interpreter. It returns there where the block ends
+/// or after any instruction that writes to a watched code page
+/// (Memory::WatchCode), and a translation is dropped once a page it came from
+/// changes. A block that jumps back to its own start loops without leaving
+/// native code while budget is left and no device wants Execute() to look
+/// at the bus (Memory::Requested); under the same conditions, a block that
+/// ends by going to another translated block jumps straight into it
+/// (chaining). The chains are cut whenever a watched code page changes
+/// (Memory::CodeEpoch), and made again as Execute() finds the blocks current.
+///
+/// Loads and stores go through Memory's page tables, calling back into
+/// Memory for devices and copy-on-write. BRK, RTI, PHP, PLP, invalid opcodes
+/// and code on device pages are left to the interpreter. A block of fewer
+/// than MIN_NATIVE instructions is not translated at all, unless it loops or
+/// can go on into a block that may be translated: entering and leaving
+/// native code would cost it more than it saves. It is interpreted whole,
+/// along with the blocks after it that are not translated either.
+///
+/// On other hosts, or when no executable memory can be had, Execute() just
+/// calls CPU::Execute.
+struct Jit
+{
+	Jit();
+	~Jit();
+
+	Jit(const Jit&) = delete;
+	Jit& operator=(const Jit&) = delete;
+
+	/// Same contract as CPU::Execute, without breakpoints.
+	ExecResult Execute(CPU& cpu, u64 cycles, Memory& ram);
+
+	/// Drops every translation.
+	void Clear();
+
+	static constexpr u32 MIN_NATIVE = 8;
+
+	u32 m_Threshold = 32;
+	u64 m_Translated = 0;		// blocks translated so far, including re-translations
+	u64 m_NativeRuns = 0;		// entries into translated code
+
+private:
+	using Native = void (*)(JitState* state);
+
+	struct Entry
+	{
+		Native code = nullptr;
+		const byte* body = nullptr;		// code past its prologue, where chained blocks come in
+		const byte* chain = nullptr;	// body while it is known to be current, else nullptr
+		u32 hits = 0;
+		byte firstPage = 0;
+		byte lastPage = 0;
+		u32 versions[2] = {};	// CodeVersion() of firstPage and lastPage
+	};
+
+	using EntryPage = std::array<Entry, Memory::PAGE_SIZE>;
+
+	Entry& Lookup(word pc);
+	bool IsCurrent(const Entry& entry, const Memory& ram) const;
+	void Unchain();
+	void Translate(Entry& entry, word pc, Memory& ram);
+	dispatch::Ending Interpret(CPU& cpu, Memory& ram, u32& cycles);
+	void DropTranslations();
+
+	std::unique_ptr<EntryPage> m_Pages[Memory::PAGE_COUNT];
+	u64 m_RamId = 0;			// Memory::Id() the translations are of
+	std::bitset<Memory::MAX_MEM> m_Interpreted;		// blocks not worth translating, see MIN_NATIVE
+	std::vector<Entry*> m_Chained;		// entries with a chain
+	u32 m_ChainEpoch = 0;				// Memory::CodeEpoch() the chains were made at
+
+	byte* m_Code = nullptr;		// executable buffer, filled front to back
+	size_t m_CodeSize = 0;
+	size_t m_CodeUsed = 0;
+};
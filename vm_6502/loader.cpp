@@ -0,0 +1,394 @@
+#include "loader.hpp"
+#include <cstring>
+#include "cpu.hpp"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	/// A whole file, mapped read-only.
+	struct Mapping
+	{
+		const byte* data = nullptr;
+		size_t size = 0;
+
+		Mapping() = default;
+		Mapping(const Mapping&) = delete;
+		Mapping& operator=(const Mapping&) = delete;
+
+		~Mapping()
+		{
+			if (data)
+			{
+#if defined(_WIN32)
+				UnmapViewOfFile(data);
+#else
+				munmap((void*)data, size);
+#endif
+			}
+		}
+	};
+
+	std::shared_ptr<const Mapping> Open(const char* path, std::string& error)
+	{
+		auto mapping = std::make_shared<Mapping>();
+		bool opened = false;
+#if defined(_WIN32)
+		HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file != INVALID_HANDLE_VALUE)
+		{
+			LARGE_INTEGER size;
+			if (GetFileSizeEx(file, &size))
+			{
+				opened = size.QuadPart == 0;
+				HANDLE view = opened ? nullptr : CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+				if (view)
+				{
+					mapping->data = (const byte*)MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0);
+					mapping->size = mapping->data ? (size_t)size.QuadPart : 0;
+					opened = mapping->data != nullptr;
+					CloseHandle(view);
+				}
+			}
+			CloseHandle(file);
+		}
+#else
+		int file = open(path, O_RDONLY);
+		if (file >= 0)
+		{
+			struct stat info;
+			if (fstat(file, &info) == 0)
+			{
+				opened = info.st_size == 0;
+				void* data = opened ? MAP_FAILED : mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+				if (data != MAP_FAILED)
+				{
+					mapping->data = (const byte*)data;
+					mapping->size = (size_t)info.st_size;
+					opened = true;
+				}
+			}
+			close(file);
+		}
+#endif
+		if (!opened)
+		{
+			error = "cannot map the file";
+			return nullptr;
+		}
+		return mapping;
+	}
+
+	word ReadWord(const byte* data)
+	{
+		return (word)(data[0] << 8 | data[1]);
+	}
+
+	// Lays out `size` bytes of the file from `offset` at `address`. Whole pages
+	// point into the mapping, the partial ones at either end are copied.
+	bool Place(Memory& memory, const std::shared_ptr<const Mapping>& mapping, size_t offset, size_t size, word address,
+		std::string& error)
+	{
+		if (address + size > Memory::MAX_MEM)
+		{
+			error = "program runs past address 0xFFFF";
+			return false;
+		}
+
+		const byte* data = mapping->data + offset;
+		u32 end = address + (u32)size;
+		for (u32 at = address; at < end; )
+		{
+			u32 page = at / Memory::PAGE_SIZE;
+			u32 pageEnd = std::min((page + 1) * Memory::PAGE_SIZE, end);
+			if (pageEnd - at == Memory::PAGE_SIZE)
+			{
+				memory.AttachReadOnly(page, data + (at - address), mapping);
+				at = pageEnd;
+			}
+			for (; at < pageEnd; at++)
+			{
+				memory[at] = data[at - address];
+			}
+		}
+		return true;
+	}
+
+	bool Apply(Memory& memory, const Vectors& vectors, std::string& error)
+	{
+		if (vectors.isrs.size() > 256)
+		{
+			error = "more than 256 ISRs";
+			return false;
+		}
+		for (size_t i = 0; i < vectors.isrs.size(); i++)
+		{
+			u32 address = Vectors::ISR_TABLE + 2 * (u32)i;
+			memory[address] = (byte)(vectors.isrs[i] >> 8);
+			memory[address + 1] = (byte)vectors.isrs[i];
+		}
+		if (vectors.entry)
+		{
+			memory[Vectors::STARTUP] = CPU::INS_JMP_ABS;
+			memory[Vectors::STARTUP + 1] = (byte)(*vectors.entry >> 8);
+			memory[Vectors::STARTUP + 2] = (byte)*vectors.entry;
+		}
+		return true;
+	}
+
+	Image Finish(std::shared_ptr<Memory> memory, const Vectors& vectors, std::string error)
+	{
+		if (error.empty() && Apply(*memory, vectors, error))
+		{
+			memory->Freeze();
+			return { std::move(memory), {} };
+		}
+		return { nullptr, std::move(error) };
+	}
+
+	Image FromBinary(const std::shared_ptr<const Mapping>& mapping, word address, const Vectors& vectors)
+	{
+		auto memory = std::make_shared<Memory>();
+		std::string error;
+		Place(*memory, mapping, 0, mapping->size, address, error);
+		return Finish(std::move(memory), vectors, std::move(error));
+	}
+
+	int HexDigit(char c)
+	{
+		if (c >= '0' && c <= '9') return c - '0';
+		if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+		if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+		return -1;
+	}
+
+	Image FromHex(const std::shared_ptr<const Mapping>& mapping, Vectors vectors)
+	{
+		auto memory = std::make_shared<Memory>();
+		std::optional<u32> start;
+		u32 base = 0;
+		bool ended = false;
+
+		const char* text = (const char*)mapping->data;
+		size_t size = mapping->size;
+		u32 line = 0;
+		std::string error;
+		for (size_t i = 0; i < size && !ended && error.empty(); )
+		{
+			size_t end = i;
+			while (end < size && text[end] != '\n')
+			{
+				end++;
+			}
+			line++;
+
+			size_t first = i;
+			size_t last = end;
+			i = end + 1;
+			while (first < last && (text[first] == ' ' || text[first] == '\t'))
+			{
+				first++;
+			}
+			while (last > first && (text[last - 1] == '\r' || text[last - 1] == ' ' || text[last - 1] == '\t'))
+			{
+				last--;
+			}
+			if (first == last)
+			{
+				continue;
+			}
+
+			auto fail = [&](const char* message)
+			{
+				error = "line " + std::to_string(line) + ": " + message;
+			};
+
+			// `:` count(1) address(2) type(1) data(count) checksum(1)
+			byte record[5 + 255];
+			size_t digits = last - first - 1;
+			if (text[first] != ':' || digits % 2 != 0 || digits / 2 < 5 || digits / 2 > sizeof(record))
+			{
+				fail("malformed record");
+				break;
+			}
+			byte sum = 0;
+			for (size_t k = 0; k < digits / 2; k++)
+			{
+				int high = HexDigit(text[first + 1 + 2 * k]);
+				int low = HexDigit(text[first + 2 + 2 * k]);
+				if (high < 0 || low < 0)
+				{
+					fail("malformed record");
+					break;
+				}
+				record[k] = (byte)(high << 4 | low);
+				sum += record[k];
+			}
+			if (!error.empty())
+			{
+				break;
+			}
+
+			u32 count = record[0];
+			if (digits / 2 != count + 5)
+			{
+				fail("record length does not match its count");
+				break;
+			}
+			if (sum != 0)
+			{
+				fail("bad checksum");
+				break;
+			}
+
+			u32 address = ReadWord(record + 1);
+			byte type = record[3];
+			const byte* data = record + 4;
+			switch (type)
+			{
+				case 0x00:
+					if (base + address + count > Memory::MAX_MEM)
+					{
+						fail("data beyond address 0xFFFF");
+						break;
+					}
+					for (u32 k = 0; k < count; k++)
+					{
+						(*memory)[base + address + k] = data[k];
+					}
+					break;
+
+				case 0x01:
+					ended = true;
+					break;
+
+				case 0x02:
+				case 0x04:
+					if (count != 2)
+					{
+						fail("malformed extended address record");
+						break;
+					}
+					base = type == 0x02 ? ReadWord(data) * 16 : (u32)ReadWord(data) << 16;
+					break;
+
+				case 0x03:
+				case 0x05:
+					if (count != 4)
+					{
+						fail("malformed start address record");
+						break;
+					}
+					start = type == 0x03 ? ReadWord(data) * 16 + ReadWord(data + 2) : (u32)ReadWord(data) << 16 | ReadWord(data + 2);
+					break;
+
+				default:
+					fail("unknown record type");
+					break;
+			}
+		}
+
+		if (error.empty() && !ended)
+		{
+			error = "no end of file record";
+		}
+		if (error.empty() && start && !vectors.entry)
+		{
+			if (*start >= Memory::MAX_MEM)
+			{
+				error = "start address beyond 0xFFFF";
+			}
+			else
+			{
+				vectors.entry = (word)*start;
+			}
+		}
+		return Finish(std::move(memory), vectors, std::move(error));
+	}
+
+	constexpr size_t HEADER_SIZE = 10;
+
+	bool IsProgram(const Mapping& mapping)
+	{
+		return mapping.size >= HEADER_SIZE && std::memcmp(mapping.data, "VM65", 4) == 0;
+	}
+
+	Image FromProgram(const std::shared_ptr<const Mapping>& mapping)
+	{
+		if (!IsProgram(*mapping))
+		{
+			return { nullptr, "not a VM65 image" };
+		}
+
+		const byte* header = mapping->data;
+		word address = ReadWord(header + 4);
+		Vectors vectors;
+		vectors.entry = ReadWord(header + 6);
+		size_t isrs = ReadWord(header + 8);
+		size_t offset = HEADER_SIZE + 2 * isrs;
+		if (isrs > 256 || offset > mapping->size)
+		{
+			return { nullptr, "truncated ISR table" };
+		}
+		for (size_t i = 0; i < isrs; i++)
+		{
+			vectors.isrs.push_back(ReadWord(header + HEADER_SIZE + 2 * i));
+		}
+
+		auto memory = std::make_shared<Memory>();
+		std::string error;
+		Place(*memory, mapping, offset, mapping->size - offset, address, error);
+		return Finish(std::move(memory), vectors, std::move(error));
+	}
+
+	template <typename F>
+	Image WithMapping(const char* path, F load)
+	{
+		std::string error;
+		std::shared_ptr<const Mapping> mapping = Open(path, error);
+		Image image = mapping ? load(mapping) : Image{ nullptr, error };
+		if (!image.Ok())
+		{
+			image.error = std::string(path) + ": " + image.error;
+		}
+		return image;
+	}
+}
+
+Image LoadBinary(const char* path, word address, const Vectors& vectors)
+{
+	return WithMapping(path, [&](const auto& mapping) { return FromBinary(mapping, address, vectors); });
+}
+
+Image LoadHex(const char* path, const Vectors& vectors)
+{
+	return WithMapping(path, [&](const auto& mapping) { return FromHex(mapping, vectors); });
+}
+
+Image LoadProgram(const char* path)
+{
+	return WithMapping(path, [](const auto& mapping) { return FromProgram(mapping); });
+}
+
+Image Load(const char* path)
+{
+	return WithMapping(path, [](const auto& mapping)
+	{
+		if (IsProgram(*mapping))
+		{
+			return FromProgram(mapping);
+		}
+		if (mapping->size > 0 && mapping->data[0] == ':')
+		{
+			return FromHex(mapping, {});
+		}
+		return FromBinary(mapping, 0, {});
+	});
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include "memory.hpp"
+
+/// Startup code and ISR table, laid out the way main() does it.
+struct Vectors
+{
+	static constexpr word ISR_TABLE = 0xFDFC;	// handler for BRK with A = i at ISR_TABLE + 2 * i
+	static constexpr word STARTUP = 0xFFFC;		// `JMP entry`, where CPU::Reset leaves PC
+
+	std::optional<word> entry;	// no startup code when unset
+	std::vector<word> isrs;		// at most 256 handler addresses, from ISR 0 up
+};
+
+/// A program ready to boot VMs from: a frozen Memory to fork or Restore()
+/// from (e.g. as VmJob::base), with PC starting at Vectors::STARTUP.
+///
+/// Whole 256-byte pages of a file are not copied: the file is mapped
+/// read-only and the pages point into the mapping (Memory::AttachReadOnly),
+/// so every VM booted from the image shares them until it writes to one.
+/// The mapping lives as long as any Memory still uses one of its pages.
+struct Image
+{
+	std::shared_ptr<const Memory> memory;	// nullptr when loading failed
+	std::string error;
+
+	bool Ok() const { return memory != nullptr; }
+};
+
+/// Raw bytes, placed at `address`.
+Image LoadBinary(const char* path, word address, const Vectors& vectors = {});
+
+/// Intel HEX records 00-05. A start address record (03 or 05) becomes the
+/// entry unless `vectors` has one. Decoded bytes are copied, not mapped.
+Image LoadHex(const char* path, const Vectors& vectors = {});
+
+/// The VM65 format, all words high byte first like the CPU reads them:
+///
+///		0		"VM65"
+///		4		word		load address of the program bytes
+///		6		word		entry, see Vectors
+///		8		word		n, the number of ISR table entries (at most 256)
+///		10		word[n]		ISR handler addresses, from ISR 0 up
+///		10 + 2n	byte[]		program bytes, to the end of the file
+Image LoadProgram(const char* path);
+
+/// Picks the format by content: VM65 by its magic, Intel HEX if the file
+/// starts with ':', otherwise a raw binary at address 0.
+Image Load(const char* path);
@@ -0,0 +1,754 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+using byte = unsigned char;
+using word = unsigned short;
+
+using u32 = unsigned int;
+using u64 = unsigned long long;
+
+/// For the small accessors every instruction goes through, which GCC
+/// otherwise stops inlining into the 256 handlers of CPU::ExecuteThreaded
+/// once that function has grown large.
+#if defined(__GNUC__) || defined(__clang__)
+#define VM_ALWAYS_INLINE inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define VM_ALWAYS_INLINE __forceinline
+#else
+#define VM_ALWAYS_INLINE inline
+#endif
+
+/// Memory-mapped device, see Memory::Map.
+struct Device
+{
+	virtual ~Device() = default;
+
+	/// `ram` is the byte stored at `address`, i.e. the last value written there.
+	virtual byte Read([[maybe_unused]] u32 address, byte ram) { return ram; }
+	/// Called after `data` has been stored at `address`.
+	virtual void Write(u32 address, byte data) = 0;
+	/// Called when the CPU stops executing, to push out buffered state.
+	virtual void Flush() {}
+	/// Called when an event scheduled with Memory::Schedule() comes due.
+	virtual void Event([[maybe_unused]] u32 tag) {}
+};
+
+/// 0x0000 - 0x00FF: Stack + ZeroPage
+/// 0x0100 - 0xF0FE: Free to use	(not hardcoded)
+/// 0xF0FF - 0xFDFA: ISR Handlering	(not hardcoded)
+/// 0xFDFB - 0xFFFC: ISR table
+/// 0xFFFC - 0xFFFF: Startup code
+///
+/// The address space is split into 256-byte pages that are shared
+/// copy-on-write: copying a Memory (forking a VM from a template) only copies
+/// the page table, and a page is duplicated the first time either side
+/// writes to it. Fresh memory points every page at one shared zero page.
+///
+/// Pages are handed out read-only after every reset, so the first write to a
+/// page goes through MakeWritable() and is recorded as dirty; Init() and
+/// Restore() then only revisit the dirty pages. Pages this Memory owns alone
+/// are cleared/copied in place and kept for the next job.
+///
+/// Memory is also the bus: devices can be mapped over any address range.
+/// Pages without devices are plain RAM and are read and written straight
+/// through the page table; pages with a device have no direct pointer, so
+/// accesses to them fall into the same slow path that handles copy-on-write
+/// and are routed through a per-page table of devices.
+///
+/// A decoder can WatchCode() the pages it decoded from; those also lose their
+/// write pointer, so the first change to one is caught in the slow path.
+/// TraceWrites() does the same for every page, to see every write.
+///
+/// Pages can also be backed by read-only data owned elsewhere, such as a
+/// mapped image file (AttachReadOnly); those are always copied on write.
+///
+/// Any page can also show a bank of host memory in place of its RAM
+/// (SetBank), which it reads and writes straight through like RAM; this is
+/// what bank switching (see Mmu) is built on.
+///
+/// Forking is safe from several threads at once as long as nobody writes to
+/// the source; call Freeze() on a template first so the forks only read it.
+struct Memory
+{
+	static constexpr u32 MAX_MEM = 1024 * 64;
+	static constexpr u32 PAGE_SIZE = 256;
+	static constexpr u32 PAGE_COUNT = MAX_MEM / PAGE_SIZE;
+
+	struct Page
+	{
+		byte m_Data[PAGE_SIZE];
+	};
+
+	Memory()
+		: m_Id(NextId())
+	{
+		const std::shared_ptr<Page>& zero = ZeroPage();
+		for (u32 page = 0; page < PAGE_COUNT; page++)
+		{
+			m_Owners[page] = zero;
+			m_Banks[page] = nullptr;
+			m_Pages[page] = zero->m_Data;
+			m_WritePages[page] = nullptr;
+			m_IsDirty[page] = false;
+			m_IsReadOnly[page] = false;
+			m_IsCode[page] = false;
+			m_CodeVersion[page] = 0;
+		}
+	}
+
+	Memory(const Memory& other)
+		: Memory()
+	{
+		*this = other;
+	}
+
+	/// Forks `other`: shares all of its pages.
+	Memory& operator=(const Memory& other)
+	{
+		if (this != &other)
+		{
+			other.Freeze();
+			for (u32 page = 0; page < PAGE_COUNT; page++)
+			{
+				Share(page, other);
+			}
+			m_DirtyCount = 0;
+			m_Baseline = &other;
+		}
+		return *this;
+	}
+
+	/// Clears memory to zero. Only touches the pages written since the last
+	/// Init(), unless memory was forked or restored from an image since then.
+	void Init()
+	{
+		ResetTo(nullptr);
+	}
+
+	/// Makes memory equal to `pristine`, which must not change between calls.
+	/// Repeated restores from the same image only copy the dirty pages back.
+	void Restore(const Memory& pristine)
+	{
+		ResetTo(&pristine);
+	}
+
+	/// Marks every page as shared, so the next write to any of them copies it.
+	void Freeze() const
+	{
+		for (u32 page = 0; page < PAGE_COUNT; page++)
+		{
+			if (m_WritePages[page])
+			{
+				m_WritePages[page] = nullptr;
+			}
+		}
+	}
+
+	VM_ALWAYS_INLINE byte Read(u32 address) const
+	{
+		assert(address < MAX_MEM);
+		const byte* page = m_Pages[address / PAGE_SIZE];
+		if (!page)
+		{
+			return ReadDevice(address);
+		}
+		return page[address % PAGE_SIZE];
+	}
+
+	VM_ALWAYS_INLINE void Write(u32 address, byte data)
+	{
+		assert(address < MAX_MEM);
+		byte* page = m_WritePages[address / PAGE_SIZE];
+		if (!page)
+		{
+			WriteSlow(address, data);
+			return;
+		}
+		page[address % PAGE_SIZE] = data;
+	}
+
+	/// Routes reads and writes of [first, last] to `device`, which must
+	/// outlive the mapping. Device mappings belong to this Memory: they are not
+	/// copied by forks and survive Init() and Restore().
+	void Map(u32 first, u32 last, Device& device)
+	{
+		SetDevice(first, last, &device);
+	}
+
+	void Unmap(u32 first, u32 last)
+	{
+		SetDevice(first, last, nullptr);
+	}
+
+	/// Flushes every mapped device.
+	void Flush()
+	{
+		for (Device* device : m_DeviceList)
+		{
+			device->Flush();
+		}
+	}
+
+	void ReadBlock(u32 address, byte* out, size_t size) const
+	{
+		assert(address + size <= MAX_MEM);
+		for (size_t i = 0; i < size; i++)
+		{
+			out[i] = Read(address + (u32)i);
+		}
+	}
+
+	void WriteBlock(u32 address, const byte* data, size_t size)
+	{
+		assert(address + size <= MAX_MEM);
+		for (size_t i = 0; i < size; i++)
+		{
+			Write(address + (u32)i, data[i]);
+		}
+	}
+
+	/// Makes `page` show the PAGE_SIZE bytes at `data` without copying them,
+	/// for images mapped from files. `data` must stay valid and unchanged while
+	/// `owner` lives; it is never written, the first write copies the page as
+	/// for a shared one. Forks share the page like any other.
+	void AttachReadOnly(u32 page, const byte* data, std::shared_ptr<const void> owner)
+	{
+		Touch(page);
+		m_Owners[page] = std::shared_ptr<Page>(std::const_pointer_cast<void>(owner), (Page*)data);
+		m_IsReadOnly[page] = true;
+		Bind(page);
+		if (!m_IsDirty[page])
+		{
+			m_IsDirty[page] = true;
+			m_Dirty[m_DirtyCount++] = (byte)page;
+		}
+	}
+
+	/// Makes `page` show the PAGE_SIZE bytes at `data` instead of its RAM,
+	/// without copying either, or its RAM again for nullptr. Reads and writes
+	/// go straight to `data`, which must stay valid while shown; the RAM
+	/// underneath is kept as it was. Like devices, banks belong to this
+	/// Memory: forks see the RAM, and Init() and Restore() leave banks shown
+	/// and their contents alone. Changing what a watched page shows counts
+	/// as a change to it (see WatchCode).
+	void SetBank(u32 page, byte* data)
+	{
+		Touch(page);
+		m_Banks[page] = data;
+		Bind(page);
+	}
+
+	/// Also hands every write to `tracer`, after the device it went to, until
+	/// called with nullptr. Host-side writes through operator[] are not traced.
+	/// Like devices, the tracer belongs to this Memory and is not forked.
+	void TraceWrites(Device* tracer)
+	{
+		m_Tracer = tracer;
+		Freeze();
+	}
+
+	/// For a device with nothing for the guest yet: the running Execute()
+	/// returns StopReason::IoWait where the current block ends, and the host
+	/// calls it again once the device is ready.
+	void WaitForIo()
+	{
+		m_Requests |= REQUEST_IO_WAIT;
+	}
+
+	/// Whether a device wants the running Execute() to look at the bus where
+	/// the current block ends: it is waiting for I/O, scheduled an event or
+	/// changed an interrupt line.
+	bool Requested() const
+	{
+		return m_Requests != 0;
+	}
+
+	/// Clears the request made by WaitForIo() and says whether there was one.
+	bool TakeIoWait()
+	{
+		bool waiting = m_Requests & REQUEST_IO_WAIT;
+		m_Requests &= ~REQUEST_IO_WAIT;
+		return waiting;
+	}
+
+	/// Cycles Execute() has run on this memory, as of where the last block
+	/// ended. Like the device mappings, the clock, the events and the
+	/// interrupt lines below belong to this Memory: they are not copied by
+	/// forks and survive Init() and Restore().
+	u64 Now() const
+	{
+		return m_Now;
+	}
+
+	/// Calls Event(`tag`) on `device` once `delay` more cycles have run,
+	/// counted from where the current block ends, or from the event's own time
+	/// when called from an Event(). Execute() runs straight-line code up to
+	/// the next event and runs events where blocks end, so they come at most
+	/// a block late. Unmapping a device drops its events.
+	void Schedule(u64 delay, Device& device, u32 tag = 0)
+	{
+		m_Scheduled.push_back({ delay, m_EventCount++, &device, tag });
+		m_Requests |= REQUEST_EVENTS;
+	}
+
+	bool HasEvents() const
+	{
+		return !m_Events.empty();
+	}
+
+	/// Cycles from Now() to the next event, ~0 if there is none.
+	u64 UntilEvent() const
+	{
+		return m_Events.empty() ? ~0ull : m_Events.front().time - m_Now;
+	}
+
+	/// Moves Now() on by `cycles` and runs the events that came due, in the
+	/// order of their time. Called by the engines where blocks end.
+	void Advance(u64 cycles)
+	{
+		m_Requests &= ~REQUEST_EVENTS;
+		u64 end = m_Now + cycles;
+		m_Now = end;
+		PlaceEvents();
+		while (!m_Events.empty() && m_Events.front().time <= end)
+		{
+			std::pop_heap(m_Events.begin(), m_Events.end(), Later);
+			ScheduledEvent event = m_Events.back();
+			m_Events.pop_back();
+			m_Now = event.time;
+			event.device->Event(event.tag);
+			PlaceEvents();
+		}
+		m_Now = end;
+	}
+
+	/// Asserts or releases IRQ input `source`, 0 to 31. The IRQ line is
+	/// asserted while any input is, and Execute() takes it where a block ends
+	/// with the I flag clear.
+	void SetIrq(u32 source, bool asserted)
+	{
+		assert(source < 32);
+		m_IrqSources = asserted ? m_IrqSources | 1u << source : m_IrqSources & ~(1u << source);
+		m_Requests |= REQUEST_EVENTS;
+	}
+
+	bool Irq() const
+	{
+		return m_IrqSources != 0;
+	}
+
+	/// Triggers an NMI, which Execute() takes where the current block ends
+	/// whatever the I flag.
+	void Nmi()
+	{
+		m_Nmi = true;
+		m_Requests |= REQUEST_EVENTS;
+	}
+
+	/// Clears a triggered NMI and says whether there was one.
+	bool TakeNmi()
+	{
+		bool nmi = m_Nmi;
+		m_Nmi = false;
+		return nmi;
+	}
+
+	/// Takes back every write pointer, so that the next guest write to any
+	/// page goes through here and shows in Written().
+	void WatchWrites()
+	{
+		Freeze();
+		m_Written = false;
+	}
+
+	/// Whether the guest wrote anything since WatchWrites().
+	bool Written() const
+	{
+		return m_Written;
+	}
+
+	bool HasDevice(u32 page) const
+	{
+		return m_Devices[page] != nullptr;
+	}
+
+	/// Asks to be told when `page` changes, because code was decoded from it.
+	/// The next write to the page, reset or fork over it bumps its
+	/// CodeVersion() and CodeEpoch() and ends the watch.
+	void WatchCode(u32 page)
+	{
+		m_IsCode[page] = true;
+		m_WritePages[page] = nullptr;
+	}
+
+	u32 CodeVersion(u32 page) const
+	{
+		return m_CodeVersion[page];
+	}
+
+	/// Counts changes to watched pages, on all pages.
+	u32 CodeEpoch() const
+	{
+		return m_CodeEpoch;
+	}
+
+	/// Tells this Memory from every other one made in the process, including
+	/// one made later at the same address, whose CodeVersion()s start over.
+	/// Forking keeps it. Never 0.
+	u64 Id() const
+	{
+		return m_Id;
+	}
+
+	/// The page tables behind Read() and Write(), for generated code: a
+	/// non-null entry may be used directly, a null one means calling Read() or
+	/// Write() instead. Entries change, the arrays stay put.
+	const byte* const* ReadPages() const
+	{
+		return m_Pages;
+	}
+
+	byte* const* WritePages() const
+	{
+		return m_WritePages;
+	}
+
+	/// Number of pages this Memory owns alone.
+	u32 PrivatePages() const
+	{
+		u32 count = 0;
+		for (u32 page = 0; page < PAGE_COUNT; page++)
+		{
+			count += Owns(page);
+		}
+		return count;
+	}
+
+	/// Number of pages written since the last fork, Init() or Restore().
+	u32 DirtyPages() const
+	{
+		return m_DirtyCount;
+	}
+
+	/// The `i`th of DirtyPages(), in the order they were first written.
+	u32 DirtyPage(u32 i) const
+	{
+		return m_Dirty[i];
+	}
+
+	/// What the clean pages hold: the Memory last forked or restored from,
+	/// nullptr after Init() (zeroes).
+	const Memory* Baseline() const
+	{
+		return m_Baseline;
+	}
+
+	/// The PAGE_SIZE bytes `page` shows, bypassing devices like operator[].
+	const byte* PageData(u32 page) const
+	{
+		return Shown(page);
+	}
+
+	/// Whether `page` is still the zero page every fresh Memory starts with.
+	bool SharesZeroPage(u32 page) const
+	{
+		return m_Owners[page] == ZeroPage();
+	}
+
+	/// Host-side copy of PAGE_SIZE bytes into `page`, bypassing devices.
+	void WritePage(u32 page, const byte* data)
+	{
+		std::memcpy(MakeWritable(page), data, PAGE_SIZE);
+	}
+
+	byte operator[](u32 address) const
+	{
+		return Read(address);
+	}
+
+	/// Host-side access; makes the page private and bypasses devices.
+	byte& operator[](u32 address)
+	{
+		assert(address < MAX_MEM);
+		byte* page = m_WritePages[address / PAGE_SIZE];
+		if (!page)
+		{
+			page = MakeWritable(address / PAGE_SIZE);
+		}
+		return page[address % PAGE_SIZE];
+	}
+
+private:
+	static const std::shared_ptr<Page>& ZeroPage()
+	{
+		static const std::shared_ptr<Page> zero = std::make_shared<Page>();
+		return zero;
+	}
+
+	// The bank the page shows, else its RAM.
+	byte* Shown(u32 page) const
+	{
+		return m_Banks[page] ? m_Banks[page] : m_Owners[page]->m_Data;
+	}
+
+	// Device pages never get direct pointers, so every access to them lands here.
+	void Bind(u32 page)
+	{
+		m_Pages[page] = m_Devices[page] ? nullptr : Shown(page);
+		m_WritePages[page] = nullptr;
+	}
+
+	// Watched pages never get a write pointer, so every change to them lands here.
+	static u64 NextId()
+	{
+		static std::atomic<u64> s_NextId{ 1 };
+		return s_NextId++;
+	}
+
+	void Touch(u32 page)
+	{
+		if (m_IsCode[page])
+		{
+			m_IsCode[page] = false;
+			m_CodeVersion[page]++;
+			m_CodeEpoch++;
+		}
+	}
+
+	// Whether the page can be changed in place.
+	bool Owns(u32 page) const
+	{
+		return m_Owners[page].use_count() == 1 && !m_IsReadOnly[page];
+	}
+
+	byte* MakeWritable(u32 page)
+	{
+		Touch(page);
+		if (m_Banks[page])
+		{
+			// banks are written in place and not reset, so never dirty
+			if (!m_Devices[page] && !m_Tracer)
+			{
+				m_WritePages[page] = m_Banks[page];
+			}
+			return m_Banks[page];
+		}
+		if (!Owns(page))
+		{
+			m_Owners[page] = std::make_shared<Page>(*m_Owners[page]);
+			m_IsReadOnly[page] = false;
+			Bind(page);
+		}
+		if (!m_IsDirty[page])
+		{
+			m_IsDirty[page] = true;
+			m_Dirty[m_DirtyCount++] = (byte)page;
+		}
+		if (!m_Devices[page] && !m_Tracer)
+		{
+			m_WritePages[page] = m_Owners[page]->m_Data;
+		}
+		return m_Owners[page]->m_Data;
+	}
+
+	void WriteSlow(u32 address, byte data)
+	{
+		m_Written = true;
+		u32 page = address / PAGE_SIZE;
+		MakeWritable(page)[address % PAGE_SIZE] = data;
+		if (m_Devices[page])
+		{
+			if (Device* device = (*m_Devices[page])[address % PAGE_SIZE])
+			{
+				device->Write(address, data);
+			}
+		}
+		if (m_Tracer)
+		{
+			m_Tracer->Write(address, data);
+		}
+	}
+
+	byte ReadDevice(u32 address) const
+	{
+		u32 page = address / PAGE_SIZE;
+		byte ram = Shown(page)[address % PAGE_SIZE];
+		Device* device = (*m_Devices[page])[address % PAGE_SIZE];
+		return device ? device->Read(address, ram) : ram;
+	}
+
+	void SetDevice(u32 first, u32 last, Device* device)
+	{
+		assert(first <= last && last < MAX_MEM);
+		for (u32 address = first; address <= last; address++)
+		{
+			u32 page = address / PAGE_SIZE;
+			if (!m_Devices[page])
+			{
+				if (!device)
+				{
+					continue;
+				}
+				m_Devices[page] = std::make_unique<DevicePage>();
+				m_Devices[page]->fill(nullptr);
+			}
+			(*m_Devices[page])[address % PAGE_SIZE] = device;
+		}
+
+		m_DeviceList.clear();
+		for (u32 page = 0; page < PAGE_COUNT; page++)
+		{
+			if (m_Devices[page])
+			{
+				for (Device* mapped : *m_Devices[page])
+				{
+					if (mapped && std::find(m_DeviceList.begin(), m_DeviceList.end(), mapped) == m_DeviceList.end())
+					{
+						m_DeviceList.push_back(mapped);
+					}
+				}
+			}
+		}
+
+		auto unmapped = [this](const ScheduledEvent& event)
+		{
+			return std::find(m_DeviceList.begin(), m_DeviceList.end(), event.device) == m_DeviceList.end();
+		};
+		std::erase_if(m_Events, unmapped);
+		std::erase_if(m_Scheduled, unmapped);
+		std::make_heap(m_Events.begin(), m_Events.end(), Later);
+
+		for (u32 page = first / PAGE_SIZE; page <= last / PAGE_SIZE; page++)
+		{
+			Touch(page);
+			if (m_Devices[page] && std::all_of(m_Devices[page]->begin(), m_Devices[page]->end(),
+				[](Device* d) { return d == nullptr; }))
+			{
+				m_Devices[page].reset();
+			}
+			Bind(page);
+		}
+	}
+
+	void Share(u32 page, const Memory& other)
+	{
+		Touch(page);
+		m_Owners[page] = other.m_Owners[page];
+		m_IsReadOnly[page] = other.m_IsReadOnly[page];
+		Bind(page);
+		m_IsDirty[page] = false;
+	}
+
+	void ResetPage(u32 page, const Memory* pristine)
+	{
+		Touch(page);
+		const byte* source = pristine ? pristine->m_Owners[page]->m_Data : ZeroPage()->m_Data;
+		if (Owns(page) && m_Owners[page]->m_Data != source)
+		{
+			std::memcpy(m_Owners[page]->m_Data, source, PAGE_SIZE);
+			m_WritePages[page] = nullptr;
+			m_IsDirty[page] = false;
+		}
+		else if (pristine)
+		{
+			Share(page, *pristine);
+		}
+		else
+		{
+			m_Owners[page] = ZeroPage();
+			m_IsReadOnly[page] = false;
+			Bind(page);
+			m_IsDirty[page] = false;
+		}
+	}
+
+	void ResetTo(const Memory* pristine)
+	{
+		if (pristine != m_Baseline)
+		{
+			if (pristine)
+			{
+				pristine->Freeze();
+			}
+			for (u32 page = 0; page < PAGE_COUNT; page++)
+			{
+				ResetPage(page, pristine);
+			}
+		}
+		else
+		{
+			for (u32 i = 0; i < m_DirtyCount; i++)
+			{
+				ResetPage(m_Dirty[i], pristine);
+			}
+		}
+		m_DirtyCount = 0;
+		m_Baseline = pristine;
+	}
+
+	using DevicePage = std::array<Device*, PAGE_SIZE>;
+
+	const byte* m_Pages[PAGE_COUNT];			// nullptr for device pages
+	mutable byte* m_WritePages[PAGE_COUNT];		// nullptr for device pages and until the page's first write after a reset
+	std::shared_ptr<Page> m_Owners[PAGE_COUNT];
+	byte* m_Banks[PAGE_COUNT];					// see SetBank, nullptr shows the RAM
+	std::unique_ptr<DevicePage> m_Devices[PAGE_COUNT];
+	std::vector<Device*> m_DeviceList;
+	Device* m_Tracer = nullptr;					// see TraceWrites
+	static constexpr byte REQUEST_IO_WAIT = 1;
+	static constexpr byte REQUEST_EVENTS = 2;	// events to place or run, or an interrupt line changed
+	byte m_Requests = 0;						// see Requested
+
+	struct ScheduledEvent
+	{
+		u64 time;		// cycles to wait, until placed in m_Events
+		u64 order;		// breaks ties, first scheduled first
+		Device* device;
+		u32 tag;
+	};
+
+	// the heap order of m_Events: the front is the earliest
+	static bool Later(const ScheduledEvent& a, const ScheduledEvent& b)
+	{
+		return a.time != b.time ? a.time > b.time : a.order > b.order;
+	}
+
+	// Counts the events scheduled since the last Advance() from Now().
+	void PlaceEvents()
+	{
+		for (ScheduledEvent& event : m_Scheduled)
+		{
+			event.time += m_Now;
+			m_Events.push_back(event);
+			std::push_heap(m_Events.begin(), m_Events.end(), Later);
+		}
+		m_Scheduled.clear();
+	}
+
+	u64 m_Now = 0;
+	u64 m_EventCount = 0;
+	std::vector<ScheduledEvent> m_Events;		// a heap, see Later
+	std::vector<ScheduledEvent> m_Scheduled;	// not placed yet
+	u32 m_IrqSources = 0;
+	bool m_Nmi = false;
+	bool m_Written = false;						// see WatchWrites
+
+	u64 m_Id;
+	bool m_IsCode[PAGE_COUNT];
+	u32 m_CodeVersion[PAGE_COUNT];
+	u32 m_CodeEpoch = 0;
+
+	bool m_IsReadOnly[PAGE_COUNT];				// see AttachReadOnly
+
+	bool m_IsDirty[PAGE_COUNT];
+	byte m_Dirty[PAGE_COUNT];
+	u32 m_DirtyCount = 0;
+	const Memory* m_Baseline = nullptr;			// what the clean pages currently hold, nullptr = zeroes
+};
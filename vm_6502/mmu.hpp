@@ -0,0 +1,128 @@
+#pragma once
+#include <cstdlib>
+#include <memory>
+#include "memory.hpp"
+
+/// Bank-switching MMU, for guest data past the 64 KiB address space. The
+/// address space is cut into WINDOW_COUNT windows of WINDOW_SIZE bytes, and
+/// each shows RAM or one bank of an arena of up to MAX_BANKS banks of that
+/// size kept on the host. One register per window, mapped from `address`:
+///
+///		+2w, +2w+1	BANK	bank window w shows, high byte first; NONE for RAM
+///
+/// Writing the high byte only latches it, writing the low byte switches the
+/// window, so a switch never shows a bank half-selected. Banks past the
+/// arena show RAM, as NONE does. Windows start out showing RAM.
+///
+/// A switch points the window's pages at the bank (Memory::SetBank) without
+/// copying anything, and loads and stores to a window stay one page table
+/// lookup, the same as for RAM. Engines that decoded code from a window see
+/// a switch as a change to it and decode it again.
+///
+/// The arena is zeroed lazily by the host OS, so a large arena costs only
+/// the banks that are used; Banks() is 0 if it could not be allocated. The
+/// MMU maps itself on construction and, when destroyed, shows RAM in every
+/// window and unmaps itself.
+struct Mmu : Device
+{
+	static constexpr u32 WINDOW_SIZE = 4096;
+	static constexpr u32 WINDOW_COUNT = Memory::MAX_MEM / WINDOW_SIZE;
+	static constexpr u32 PAGES_PER_WINDOW = WINDOW_SIZE / Memory::PAGE_SIZE;
+	static constexpr u32 SIZE = 2 * WINDOW_COUNT;
+
+	static constexpr word NONE = 0xFFFF;
+	static constexpr u32 MAX_BANKS = NONE;		// just under 256 MiB
+
+	Mmu(Memory& ram, u32 address, u32 banks)
+		: m_Ram(ram), m_Address(address)
+	{
+		banks = std::min(banks, MAX_BANKS);
+		m_Arena.reset((byte*)std::calloc(banks, WINDOW_SIZE));
+		m_BankCount = m_Arena ? banks : 0;
+		for (word& bank : m_Selected)
+		{
+			bank = NONE;
+		}
+		m_Ram.Map(address, address + SIZE - 1, *this);
+	}
+
+	~Mmu() override
+	{
+		for (u32 window = 0; window < WINDOW_COUNT; window++)
+		{
+			Select(window, NONE);
+		}
+		m_Ram.Unmap(m_Address, m_Address + SIZE - 1);
+	}
+
+	Mmu(const Mmu&) = delete;
+	Mmu& operator=(const Mmu&) = delete;
+
+	byte Read(u32 address, byte) override
+	{
+		u32 offset = address - m_Address;
+		word bank = m_Selected[offset / 2];
+		return offset % 2 == 0 ? (byte)(bank >> 8) : (byte)bank;
+	}
+
+	void Write(u32 address, byte data) override
+	{
+		u32 offset = address - m_Address;
+		if (offset % 2 == 0)
+		{
+			m_Latch[offset / 2] = data;
+		}
+		else
+		{
+			Select(offset / 2, (word)(m_Latch[offset / 2] << 8 | data));
+		}
+	}
+
+	/// Switches `window` to `bank`, as the guest does through its register.
+	void Select(u32 window, word bank)
+	{
+		assert(window < WINDOW_COUNT);
+		m_Selected[window] = bank;
+		byte* data = Bank(bank);
+		if (data == m_Shown[window])
+		{
+			return;
+		}
+		m_Shown[window] = data;
+		for (u32 i = 0; i < PAGES_PER_WINDOW; i++)
+		{
+			m_Ram.SetBank(window * PAGES_PER_WINDOW + i, data ? data + i * Memory::PAGE_SIZE : nullptr);
+		}
+	}
+
+	word Selected(u32 window) const
+	{
+		return m_Selected[window];
+	}
+
+	/// The WINDOW_SIZE bytes of `bank`, for the host to fill or inspect;
+	/// nullptr past the arena.
+	byte* Bank(u32 bank)
+	{
+		return bank < m_BankCount ? m_Arena.get() + (size_t)bank * WINDOW_SIZE : nullptr;
+	}
+
+	u32 Banks() const
+	{
+		return m_BankCount;
+	}
+
+private:
+	struct Free
+	{
+		void operator()(byte* arena) const { std::free(arena); }
+	};
+
+	Memory& m_Ram;
+	u32 m_Address;
+	std::unique_ptr<byte[], Free> m_Arena;
+	u32 m_BankCount = 0;
+	word m_Selected[WINDOW_COUNT];				// as written, see Read
+	byte m_Latch[WINDOW_COUNT] = {};			// high bytes written
+	byte* m_Shown[WINDOW_COUNT] = {};			// bank data each window shows, nullptr for RAM
+};
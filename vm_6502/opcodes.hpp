@@ -0,0 +1,222 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include "cpu.hpp"
+
+/// Addressing modes, as instructions are written in assembly.
+enum class AddressMode : byte
+{
+	Implied,
+	Immediate,
+	ZeroPage,
+	ZeroPageX,
+	ZeroPageY,
+	Absolute,
+	AbsoluteX,
+	AbsoluteY,
+	Relative,
+};
+
+inline constexpr std::size_t ADDRESS_MODE_COUNT = (std::size_t)AddressMode::Relative + 1;
+
+/// Operand bytes that follow the opcode in `mode`.
+constexpr byte OperandBytes(AddressMode mode)
+{
+	switch (mode)
+	{
+		case AddressMode::Implied:
+			return 0;
+		case AddressMode::Absolute:
+		case AddressMode::AbsoluteX:
+		case AddressMode::AbsoluteY:
+			return 2;
+		default:
+			return 1;
+	}
+}
+
+/// What there is to know about an opcode without running it.
+///
+/// `s_Opcodes` holds one for each of the 256 opcodes and is where cycle
+/// counts live: the dispatch handlers charge `cycles` in one go (see
+/// dispatch.hpp), and the block cache, JIT, batch, tracer and profiler read
+/// them from there. The assembler takes its mnemonics from it and
+/// Disassemble() prints them.
+///
+/// Modes are as written, e.g. AbsoluteX for DEC abs,X even though the CPU
+/// ignores X there. Flags are the status bits an instruction may change, in
+/// the order of CPU::Status(); LDA/LDX/LDY from memory and INX/INY leave Z
+/// and N alone, as ExecuteSwitch does.
+struct OpcodeInfo
+{
+	static constexpr byte C = 0x01;
+	static constexpr byte Z = 0x02;
+	static constexpr byte I = 0x04;
+	static constexpr byte D = 0x08;
+	static constexpr byte B = 0x10;
+	static constexpr byte V = 0x20;
+	static constexpr byte N = 0x40;
+	static constexpr byte ALL = C | Z | I | D | B | V | N;
+
+	const char* mnemonic;	// nullptr where the opcode is invalid and raises ISR 5
+	AddressMode mode;
+	byte length;			// opcode + operand bytes
+	byte cycles;			// base; a taken branch takes one more
+	byte pageCross;			// on top of cycles when indexing crosses a page; this
+							// CPU charges nothing for it, so 0 throughout
+	byte flags;				// status bits it may change
+
+	constexpr bool Valid() const { return mnemonic != nullptr; }
+};
+
+namespace opcodes
+{
+	struct Row
+	{
+		byte opcode;
+		const char* mnemonic;
+		AddressMode mode;
+		byte cycles;
+		byte flags;
+	};
+
+	constexpr byte NZ = OpcodeInfo::N | OpcodeInfo::Z;
+	constexpr byte NZC = NZ | OpcodeInfo::C;
+	constexpr byte NZCV = NZC | OpcodeInfo::V;
+
+	// every opcode CPU implements; cycles as ExecuteSwitch charges them
+	constexpr Row ROWS[] =
+	{
+		{ CPU::INS_ADC_IM,		"ADC", AddressMode::Immediate,	2, NZCV },
+		{ CPU::INS_ADC_ZP,		"ADC", AddressMode::ZeroPage,	3, NZCV },
+		{ CPU::INS_ADC_ZPX,		"ADC", AddressMode::ZeroPageX,	4, NZCV },
+		{ CPU::INS_ADC_ABS,		"ADC", AddressMode::Absolute,	4, NZCV },
+		{ CPU::INS_ADC_ABSX,	"ADC", AddressMode::AbsoluteX,	4, NZCV },
+		{ CPU::INS_ADC_ABSY,	"ADC", AddressMode::AbsoluteY,	4, NZCV },
+
+		{ CPU::INS_SBC_IM,		"SBC", AddressMode::Immediate,	2, NZCV },
+		{ CPU::INS_SBC_ZP,		"SBC", AddressMode::ZeroPage,	3, NZCV },
+		{ CPU::INS_SBC_ZPX,		"SBC", AddressMode::ZeroPageX,	4, NZCV },
+		{ CPU::INS_SBC_ABS,		"SBC", AddressMode::Absolute,	4, NZCV },
+		{ CPU::INS_SBC_ABSX,	"SBC", AddressMode::AbsoluteX,	4, NZCV },
+		{ CPU::INS_SBC_ABSY,	"SBC", AddressMode::AbsoluteY,	4, NZCV },
+
+		{ CPU::INS_CLC_IM,		"CLC", AddressMode::Implied,	2, OpcodeInfo::C },
+		{ CPU::INS_CLD_IM,		"CLD", AddressMode::Implied,	2, OpcodeInfo::D },
+		{ CPU::INS_SED_IM,		"SED", AddressMode::Implied,	2, OpcodeInfo::D },
+		{ CPU::INS_CLV_IM,		"CLV", AddressMode::Implied,	2, OpcodeInfo::V },
+
+		{ CPU::INS_EOR_IM,		"EOR", AddressMode::Immediate,	2, NZ },
+		{ CPU::INS_EOR_ZP,		"EOR", AddressMode::ZeroPage,	3, NZ },
+		{ CPU::INS_EOR_ZPX,		"EOR", AddressMode::ZeroPageX,	4, NZ },
+		{ CPU::INS_EOR_ABS,		"EOR", AddressMode::Absolute,	4, NZ },
+		{ CPU::INS_EOR_ABSX,	"EOR", AddressMode::AbsoluteX,	5, NZ },
+		{ CPU::INS_EOR_ABSY,	"EOR", AddressMode::AbsoluteY,	5, NZ },
+
+		{ CPU::INS_AND_IM,		"AND", AddressMode::Immediate,	2, NZ },
+		{ CPU::INS_AND_ZP,		"AND", AddressMode::ZeroPage,	3, NZ },
+		{ CPU::INS_AND_ZPX,		"AND", AddressMode::ZeroPageX,	3, NZ },
+		{ CPU::INS_AND_ABS,		"AND", AddressMode::Absolute,	4, NZ },
+		{ CPU::INS_AND_ABSX,	"AND", AddressMode::AbsoluteX,	4, NZ },
+		{ CPU::INS_AND_ABSY,	"AND", AddressMode::AbsoluteY,	4, NZ },
+
+		{ CPU::INS_ORA_IM,		"ORA", AddressMode::Immediate,	2, NZ },
+		{ CPU::INS_ORA_ZP,		"ORA", AddressMode::ZeroPage,	3, NZ },
+		{ CPU::INS_ORA_ZPX,		"ORA", AddressMode::ZeroPageX,	4, NZ },
+		{ CPU::INS_ORA_ABS,		"ORA", AddressMode::Absolute,	4, NZ },
+		{ CPU::INS_ORA_ABSX,	"ORA", AddressMode::AbsoluteX,	5, NZ },
+		{ CPU::INS_ORA_ABSY,	"ORA", AddressMode::AbsoluteY,	5, NZ },
+
+		{ CPU::INS_BCC_RL,		"BCC", AddressMode::Relative,	3, 0 },
+		{ CPU::INS_BCS_RL,		"BCS", AddressMode::Relative,	3, 0 },
+		{ CPU::INS_BEQ_RL,		"BEQ", AddressMode::Relative,	3, 0 },
+		{ CPU::INS_BNE_RL,		"BNE", AddressMode::Relative,	3, 0 },
+		{ CPU::INS_BPL_RL,		"BPL", AddressMode::Relative,	3, 0 },
+		{ CPU::INS_BVC_RL,		"BVC", AddressMode::Relative,	3, 0 },
+		{ CPU::INS_BVS_RL,		"BVS", AddressMode::Relative,	3, 0 },
+
+		{ CPU::INS_LDA_IM,		"LDA", AddressMode::Immediate,	2, NZ },
+		{ CPU::INS_LDA_ZP,		"LDA", AddressMode::ZeroPage,	3, 0 },
+		{ CPU::INS_LDA_ZPX,		"LDA", AddressMode::ZeroPageX,	4, 0 },
+
+		{ CPU::INS_LDX_IM,		"LDX", AddressMode::Immediate,	2, NZ },
+		{ CPU::INS_LDX_ZP,		"LDX", AddressMode::ZeroPage,	3, 0 },
+		{ CPU::INS_LDX_ZPY,		"LDX", AddressMode::ZeroPageY,	4, 0 },
+
+		{ CPU::INS_LDY_IM,		"LDY", AddressMode::Immediate,	2, NZ },
+		{ CPU::INS_LDY_ZP,		"LDY", AddressMode::ZeroPage,	3, 0 },
+		{ CPU::INS_LDY_ZPX,		"LDY", AddressMode::ZeroPageX,	4, 0 },
+
+		{ CPU::INS_JMP_ABS,		"JMP", AddressMode::Absolute,	3, 0 },
+		{ CPU::INS_JSR_ABS,		"JSR", AddressMode::Absolute,	6, 0 },
+		{ CPU::INS_RTS_ABS,		"RTS", AddressMode::Implied,	6, 0 },
+
+		{ CPU::INS_CMP_IM,		"CMP", AddressMode::Immediate,	2, NZC },
+		{ CPU::INS_CMP_ZP,		"CMP", AddressMode::ZeroPage,	3, NZC },
+		{ CPU::INS_CMP_ZPX,		"CMP", AddressMode::ZeroPageX,	3, NZC },
+		{ CPU::INS_CMP_ABS,		"CMP", AddressMode::Absolute,	4, NZC },
+		{ CPU::INS_CMP_ABSX,	"CMP", AddressMode::AbsoluteX,	4, NZC },
+		{ CPU::INS_CMP_ABSY,	"CMP", AddressMode::AbsoluteY,	4, NZC },
+
+		{ CPU::INS_CPX_IM,		"CPX", AddressMode::Immediate,	2, NZC },
+		{ CPU::INS_CPX_ZP,		"CPX", AddressMode::ZeroPage,	3, NZC },
+		{ CPU::INS_CPX_ABS,		"CPX", AddressMode::Absolute,	4, NZC },
+
+		{ CPU::INS_CPY_IM,		"CPY", AddressMode::Immediate,	2, NZC },
+		{ CPU::INS_CPY_ZP,		"CPY", AddressMode::ZeroPage,	3, NZC },
+		{ CPU::INS_CPY_ABS,		"CPY", AddressMode::Absolute,	4, NZC },
+
+		{ CPU::INS_DEC_ZP,		"DEC", AddressMode::ZeroPage,	5, NZ },
+		{ CPU::INS_DEC_ZPX,		"DEC", AddressMode::ZeroPageX,	6, NZ },
+		{ CPU::INS_DEC_ABS,		"DEC", AddressMode::Absolute,	6, NZ },
+		{ CPU::INS_DEC_ABSX,	"DEC", AddressMode::AbsoluteX,	7, NZ },
+
+		{ CPU::INS_DEX_IM,		"DEX", AddressMode::Implied,	2, NZ },
+		{ CPU::INS_DEY_IM,		"DEY", AddressMode::Implied,	2, NZ },
+
+		{ CPU::INS_INC_ZP,		"INC", AddressMode::ZeroPage,	5, NZ },
+		{ CPU::INS_INC_ZPX,		"INC", AddressMode::ZeroPageX,	6, NZ },
+		{ CPU::INS_INC_ABS,		"INC", AddressMode::Absolute,	6, NZ },
+		{ CPU::INS_INC_ABSX,	"INC", AddressMode::AbsoluteX,	5, NZ },
+
+		{ CPU::INS_INX_IM,		"INX", AddressMode::Implied,	2, 0 },
+		{ CPU::INS_INY_IM,		"INY", AddressMode::Implied,	2, 0 },
+
+		{ CPU::INS_PHA_IM,		"PHA", AddressMode::Implied,	3, 0 },
+		{ CPU::INS_PHP_IM,		"PHP", AddressMode::Implied,	3, 0 },
+		{ CPU::INS_PLA_IM,		"PLA", AddressMode::Implied,	3, NZ },
+		{ CPU::INS_PLP_IM,		"PLP", AddressMode::Implied,	3, OpcodeInfo::ALL },
+
+		{ CPU::INS_SDA_ZP,		"SDA", AddressMode::ZeroPage,	3, 0 },
+		{ CPU::INS_SDA_ZPX,		"SDA", AddressMode::ZeroPageX,	4, 0 },
+		{ CPU::INS_SDA_ABS,		"SDA", AddressMode::Absolute,	4, 0 },
+		{ CPU::INS_SDA_ABSX,	"SDA", AddressMode::AbsoluteX,	5, 0 },
+		{ CPU::INS_SDA_ABSY,	"SDA", AddressMode::AbsoluteY,	5, 0 },
+
+		{ CPU::INS_SDX_ZP,		"SDX", AddressMode::ZeroPage,	3, 0 },
+		{ CPU::INS_SDX_ZPY,		"SDX", AddressMode::ZeroPageY,	4, 0 },
+		{ CPU::INS_SDX_ABS,		"SDX", AddressMode::Absolute,	4, 0 },
+
+		{ CPU::INS_CLI_IM,		"CLI", AddressMode::Implied,	2, OpcodeInfo::I },
+		{ CPU::INS_SEI_IM,		"SEI", AddressMode::Implied,	2, OpcodeInfo::I },
+		{ CPU::INS_NOP_IM,		"NOP", AddressMode::Implied,	2, 0 },
+		{ CPU::INS_BRK_IM,		"BRK", AddressMode::Implied,	7, OpcodeInfo::B },
+		{ CPU::INS_RTI_IM,		"RTI", AddressMode::Implied,	6, OpcodeInfo::ALL },
+	};
+
+	// what an invalid opcode takes to raise ISR 5, as BRK
+	constexpr OpcodeInfo INVALID{ nullptr, AddressMode::Implied, 1, 7, 0, 0 };
+
+	constexpr std::array<OpcodeInfo, 256> MakeTable()
+	{
+		std::array<OpcodeInfo, 256> table{};
+		table.fill(INVALID);
+		for (const Row& row : ROWS)
+		{
+			table[row.opcode] = { row.mnemonic, row.mode, (byte)(1 + OperandBytes(row.mode)), row.cycles, 0, row.flags };
+		}
+		return table;
+	}
+}
+
+inline constexpr std::array<OpcodeInfo, 256> s_Opcodes = opcodes::MakeTable();
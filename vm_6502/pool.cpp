@@ -0,0 +1,159 @@
+#include "pool.hpp"
+
+VmPool::VmPool(unsigned threads)
+{
+	if (threads == 0)
+	{
+		threads = 1;
+	}
+
+	for (unsigned i = 0; i < threads; i++)
+	{
+		m_Workers.push_back(std::make_unique<Worker>());
+	}
+	for (unsigned i = 0; i < threads; i++)
+	{
+		m_Workers[i]->thread = std::thread(&VmPool::WorkerLoop, this, i);
+	}
+}
+
+VmPool::~VmPool()
+{
+	{
+		std::lock_guard<std::mutex> guard(m_SleepLock);
+		m_Stopping = true;
+	}
+	m_Wake.notify_all();
+
+	for (auto& worker : m_Workers)
+	{
+		worker->thread.join();
+	}
+}
+
+std::future<VmResult> VmPool::Submit(VmJob job)
+{
+	// frozen here, once, so that the workers restoring from it only read it
+	if (job.base)
+	{
+		job.base->Freeze();
+	}
+
+	Task task;
+	task.job = std::move(job);
+	std::future<VmResult> result = task.promise.get_future();
+
+	// counted before it can be taken, so that m_Pending never goes below zero
+	{
+		// taken so a worker cannot miss the wake-up between its check and its wait
+		std::lock_guard<std::mutex> guard(m_SleepLock);
+		m_Pending++;
+	}
+	Worker& worker = *m_Workers[m_Next++ % m_Workers.size()];
+	{
+		std::lock_guard<std::mutex> guard(worker.lock);
+		worker.tasks.push_back(std::move(task));
+	}
+	m_Wake.notify_one();
+
+	return result;
+}
+
+VmResult VmPool::Run(const VmJob& job, Memory& ram)
+{
+	VmResult result;
+	CPU& cpu = result.cpu;
+	if (job.base)
+	{
+		cpu.Reset(ram, *job.base);
+	}
+	else
+	{
+		cpu.Reset(ram);
+	}
+	if (job.image)
+	{
+		const VmImage& image = *job.image;
+		ram.WriteBlock(image.origin, image.data.data(), image.data.size());
+	}
+
+	Console console([&result](std::span<const byte> data)
+	{
+		result.output.insert(result.output.end(), data.begin(), data.end());
+	});
+	ram.Map(Console::ADDRESS, Console::ADDRESS, console);
+
+	cpu.PC = job.entry;
+	// the console gives no input, so an idle guest is as stuck as a halted one
+	while (result.cycles < job.cycles && result.reason != StopReason::Halt && result.reason != StopReason::Idle)
+	{
+		ExecResult run = cpu.Execute(job.cycles - result.cycles, ram);
+		result.cycles += run.cycles;
+		result.reason = run.reason;
+	}
+	console.Flush();
+	ram.Unmap(Console::ADDRESS, Console::ADDRESS);
+
+	return result;
+}
+
+void VmPool::WorkerLoop(unsigned index)
+{
+	std::unique_ptr<Memory> ram = std::make_unique<Memory>();
+
+	for (;;)
+	{
+		Task task;
+		if (Pop(index, task) || Steal(index, task))
+		{
+			try
+			{
+				task.promise.set_value(Run(task.job, *ram));
+			}
+			catch (...)
+			{
+				task.promise.set_exception(std::current_exception());
+			}
+			continue;
+		}
+
+		std::unique_lock<std::mutex> guard(m_SleepLock);
+		m_Wake.wait(guard, [this]() { return m_Stopping || m_Pending > 0; });
+		if (m_Stopping && m_Pending == 0)
+		{
+			return;
+		}
+	}
+}
+
+bool VmPool::Pop(unsigned index, Task& task)
+{
+	Worker& worker = *m_Workers[index];
+	std::lock_guard<std::mutex> guard(worker.lock);
+	if (worker.tasks.empty())
+	{
+		return false;
+	}
+
+	task = std::move(worker.tasks.back());
+	worker.tasks.pop_back();
+	m_Pending--;
+	return true;
+}
+
+bool VmPool::Steal(unsigned index, Task& task)
+{
+	for (size_t i = 1; i < m_Workers.size(); i++)
+	{
+		Worker& victim = *m_Workers[(index + i) % m_Workers.size()];
+		std::lock_guard<std::mutex> guard(victim.lock);
+		if (!victim.tasks.empty())
+		{
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+			m_Pending--;
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "console.hpp"
+#include "cpu.hpp"
+
+/// Raw bytes placed at `origin` before a job starts. Shared between jobs.
+struct VmImage
+{
+	word origin = 0;
+	std::vector<byte> data;
+};
+
+struct VmJob
+{
+	/// Restored (see Memory::Restore) when set, zeroed memory otherwise.
+	/// Shared by the workers, so it must stay frozen (Memory::Freeze) and
+	/// unwritten while jobs on it run; Submit() freezes it.
+	std::shared_ptr<const Memory> base;
+	std::shared_ptr<const VmImage> image;	// written on top of `base`
+	word entry = 0xFFFC;
+	u64 cycles = 0;
+};
+
+struct VmResult
+{
+	CPU cpu;					// registers when the job stopped
+	std::vector<byte> output;	// bytes written to 0xFFFF
+	u64 cycles = 0;				// cycles used, at most a block over budget
+	StopReason reason = StopReason::Budget;	// or Halt or Idle, if the guest got stuck first
+};
+
+/// Runs VmJobs on a fixed set of worker threads.
+///
+/// Every worker owns one Memory, reused from job to job, and a deque of
+/// pending jobs. Submit() deals jobs round-robin; a worker pops from the back
+/// of its own deque and, once that is empty, steals from the front of the
+/// others.
+struct VmPool
+{
+	explicit VmPool(unsigned threads = std::thread::hardware_concurrency());
+	~VmPool();
+
+	VmPool(const VmPool&) = delete;
+	VmPool& operator=(const VmPool&) = delete;
+
+	std::future<VmResult> Submit(VmJob job);
+
+	unsigned Threads() const { return (unsigned)m_Workers.size(); }
+
+	/// Runs a single job on the calling thread.
+	static VmResult Run(const VmJob& job, Memory& ram);
+
+private:
+	struct Task
+	{
+		VmJob job;
+		std::promise<VmResult> promise;
+	};
+
+	struct Worker
+	{
+		std::mutex lock;
+		std::deque<Task> tasks;
+		std::thread thread;
+	};
+
+	void WorkerLoop(unsigned index);
+	bool Pop(unsigned index, Task& task);
+	bool Steal(unsigned index, Task& task);
+
+	std::vector<std::unique_ptr<Worker>> m_Workers;
+	std::atomic<unsigned> m_Next{ 0 };
+
+	std::mutex m_SleepLock;
+	std::condition_variable m_Wake;
+	std::atomic<size_t> m_Pending{ 0 };
+	bool m_Stopping = false;
+};
@@ -0,0 +1,353 @@
+#include "profiler.hpp"
+#include <algorithm>
+#include <numeric>
+#include "dispatch.hpp"
+
+namespace
+{
+	enum class Flow : byte
+	{
+		None,
+		Branch,
+		Call,		// JSR, BRK and invalid opcodes, which raise ISR 5
+		Return,		// RTS, RTI
+	};
+
+	template <byte Opcode>
+	constexpr Flow FlowOf()
+	{
+		switch (dispatch::s_Forms[Opcode].operation)
+		{
+			case dispatch::Operation::Branch:
+				return Flow::Branch;
+			case dispatch::Operation::JSR:
+			case dispatch::Operation::BRK:
+			case dispatch::Operation::Invalid:
+				return Flow::Call;
+			case dispatch::Operation::RTS:
+			case dispatch::Operation::RTI:
+				return Flow::Return;
+			default:
+				return Flow::None;
+		}
+	}
+
+	template <std::size_t... Opcodes>
+	constexpr std::array<Flow, 256> MakeFlowTable(std::index_sequence<Opcodes...>)
+	{
+		return { { FlowOf<Opcodes>()... } };
+	}
+
+	constexpr std::array<Flow, 256> s_Flow = MakeFlowTable(std::make_index_sequence<256>{});
+
+	int HexDigit(char c)
+	{
+		if (c >= '0' && c <= '9') return c - '0';
+		if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+		if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+		return -1;
+	}
+
+	bool ParseAddress(const std::string& text, word& address)
+	{
+		size_t i = text.starts_with('$') ? 1 : text.starts_with("0x") || text.starts_with("0X") ? 2 : 0;
+		if (i == text.size())
+		{
+			return false;
+		}
+		u32 value = 0;
+		for (; i < text.size(); i++)
+		{
+			int digit = HexDigit(text[i]);
+			if (digit < 0 || (value = value * 16 + digit) > 0xFFFF)
+			{
+				return false;
+			}
+		}
+		address = (word)value;
+		return true;
+	}
+
+	double Percent(u64 part, u64 total)
+	{
+		return total ? 100.0 * part / total : 0.0;
+	}
+}
+
+Profiler::Profiler()
+	: m_Hits(Memory::MAX_MEM), m_Cycles(Memory::MAX_MEM), m_Taken(Memory::MAX_MEM), m_NotTaken(Memory::MAX_MEM)
+{
+	Clear();
+}
+
+ExecResult Profiler::Execute(CPU& cpu, u64 cycles, Memory& ram)
+{
+	if (m_Frames.empty())
+	{
+		m_Frames.push_back({ cpu.PC, 0, 0, {} });
+	}
+	return dispatch::Run(cpu, cycles, ram, *this);
+}
+
+void Profiler::Clear()
+{
+	m_OpcodeCounts.fill(0);
+	m_OpcodeCycles.fill(0);
+	std::fill(m_Hits.begin(), m_Hits.end(), 0);
+	std::fill(m_Cycles.begin(), m_Cycles.end(), 0);
+	std::fill(m_Taken.begin(), m_Taken.end(), 0);
+	std::fill(m_NotTaken.begin(), m_NotTaken.end(), 0);
+
+	m_Frames.clear();
+	m_Frame = 0;
+	m_Depth = 0;
+	m_Overflow = 0;
+}
+
+void Profiler::Retired(const CPU& cpu, word pc, byte opcode, u32 cycles)
+{
+	m_OpcodeCounts[opcode]++;
+	m_OpcodeCycles[opcode] += cycles;
+	m_Hits[pc]++;
+	m_Cycles[pc] += cycles;
+	m_Frames[m_Frame].cycles += cycles;
+
+	switch (s_Flow[opcode])
+	{
+		case Flow::None:
+			break;
+		case Flow::Branch:
+			// a taken branch costs one cycle more than s_Decoding says
+			(cycles > dispatch::s_Decoding[opcode].cycles ? m_Taken : m_NotTaken)[pc]++;
+			break;
+		case Flow::Call:
+			Enter(cpu.PC);
+			break;
+		case Flow::Return:
+			Leave();
+			break;
+	}
+}
+
+void Profiler::Interrupted(const CPU& cpu)
+{
+	Enter(cpu.PC);
+}
+
+void Profiler::Enter(word entry)
+{
+	if (m_Depth == MAX_DEPTH)
+	{
+		m_Overflow++;
+		return;
+	}
+
+	u32 child = 0;
+	for (u32 candidate : m_Frames[m_Frame].children)
+	{
+		if (m_Frames[candidate].entry == entry)
+		{
+			child = candidate;
+			break;
+		}
+	}
+	if (!child)
+	{
+		child = (u32)m_Frames.size();
+		m_Frames.push_back({ entry, m_Frame, 0, {} });
+		m_Frames[m_Frame].children.push_back(child);
+	}
+	m_Frame = child;
+	m_Depth++;
+}
+
+void Profiler::Leave()
+{
+	if (m_Overflow)
+	{
+		m_Overflow--;
+	}
+	else if (m_Depth)
+	{
+		m_Frame = m_Frames[m_Frame].parent;
+		m_Depth--;
+	}
+	// a return from the outermost frame (e.g. RTI after jumping out of an ISR) stays there
+}
+
+void Profiler::SetSymbols(std::vector<Symbol> symbols)
+{
+	m_Symbols = std::move(symbols);
+	std::stable_sort(m_Symbols.begin(), m_Symbols.end(), [](const Symbol& a, const Symbol& b) { return a.value < b.value; });
+}
+
+bool Profiler::LoadSymbols(const char* path)
+{
+	FILE* file = std::fopen(path, "r");
+	if (!file)
+	{
+		return false;
+	}
+
+	std::vector<Symbol> symbols;
+	char line[512];
+	while (std::fgets(line, sizeof(line), file))
+	{
+		std::string text(line);
+		text.erase(std::min(text.find(';'), text.size()));
+		size_t equals = text.find('=');
+		bool assigned = equals != std::string::npos;
+		if (assigned)
+		{
+			text[equals] = ' ';
+		}
+
+		char first[256], second[256];
+		if (std::sscanf(text.c_str(), "%255s %255s", first, second) != 2)
+		{
+			continue;
+		}
+		Symbol symbol;
+		if (assigned && ParseAddress(second, symbol.value))
+		{
+			symbol.name = first;
+		}
+		else if (!assigned && ParseAddress(first, symbol.value))
+		{
+			symbol.name = second;
+		}
+		else
+		{
+			continue;
+		}
+		symbols.push_back(std::move(symbol));
+	}
+	std::fclose(file);
+
+	SetSymbols(std::move(symbols));
+	return true;
+}
+
+std::string Profiler::Name(word address) const
+{
+	auto it = std::upper_bound(m_Symbols.begin(), m_Symbols.end(), address,
+		[](word address, const Symbol& symbol) { return address < symbol.value; });
+
+	char text[16];
+	if (it == m_Symbols.begin())
+	{
+		std::snprintf(text, sizeof(text), "$%04X", address);
+		return text;
+	}
+
+	const Symbol& symbol = *--it;
+	if (symbol.value == address)
+	{
+		return symbol.name;
+	}
+	std::snprintf(text, sizeof(text), "+$%X", address - symbol.value);
+	return symbol.name + text;
+}
+
+std::string Profiler::Path(u32 frame) const
+{
+	std::string path = Name(m_Frames[frame].entry);
+	for (u32 at = frame; at != 0; )
+	{
+		at = m_Frames[at].parent;
+		path = Name(m_Frames[at].entry) + ";" + path;
+	}
+	return path;
+}
+
+void Profiler::WriteFolded(FILE* out) const
+{
+	for (u32 frame = 0; frame < m_Frames.size(); frame++)
+	{
+		if (m_Frames[frame].cycles)
+		{
+			std::fprintf(out, "%s %llu\n", Path(frame).c_str(), m_Frames[frame].cycles);
+		}
+	}
+}
+
+void Profiler::WriteReport(FILE* out, size_t top) const
+{
+	u64 total = std::accumulate(m_OpcodeCycles.begin(), m_OpcodeCycles.end(), 0ull);
+	u64 instructions = std::accumulate(m_OpcodeCounts.begin(), m_OpcodeCounts.end(), 0ull);
+	std::fprintf(out, "%llu instructions, %llu cycles\n", instructions, total);
+
+	// indices of the `top` largest non-zero values
+	auto hottest = [top](size_t count, auto value)
+	{
+		std::vector<u32> order;
+		for (u32 i = 0; i < count; i++)
+		{
+			if (value(i))
+			{
+				order.push_back(i);
+			}
+		}
+		size_t shown = std::min(top, order.size());
+		std::partial_sort(order.begin(), order.begin() + shown, order.end(),
+			[&](u32 a, u32 b) { return value(a) > value(b); });
+		order.resize(shown);
+		return order;
+	};
+
+	std::fprintf(out, "\n%-8s %14s %14s %8s\n", "opcode", "count", "cycles", "cycles%");
+	for (u32 opcode : hottest(256, [&](u32 i) { return m_OpcodeCycles[i]; }))
+	{
+		const char* mnemonic = s_Opcodes[opcode].Valid() ? s_Opcodes[opcode].mnemonic : "???";
+		std::fprintf(out, "$%02X %-4s %14llu %14llu %7.2f%%\n", opcode, mnemonic, m_OpcodeCounts[opcode], m_OpcodeCycles[opcode],
+			Percent(m_OpcodeCycles[opcode], total));
+	}
+
+	std::fprintf(out, "\n%-24s %14s %14s %8s\n", "address", "hits", "cycles", "cycles%");
+	for (u32 address : hottest(Memory::MAX_MEM, [&](u32 i) { return m_Cycles[i]; }))
+	{
+		std::fprintf(out, "%-24s %14llu %14llu %7.2f%%\n", Name((word)address).c_str(), m_Hits[address], m_Cycles[address],
+			Percent(m_Cycles[address], total));
+	}
+
+	// address ranges: from each symbol up to the next one, or whole pages
+	std::vector<u32> starts;
+	for (const Symbol& symbol : m_Symbols)
+	{
+		if (starts.empty() || starts.back() != symbol.value)
+		{
+			starts.push_back(symbol.value);
+		}
+	}
+	if (starts.empty())
+	{
+		for (u32 page = 0; page < Memory::PAGE_COUNT; page++)
+		{
+			starts.push_back(page * Memory::PAGE_SIZE);
+		}
+	}
+	else if (starts.front() != 0)
+	{
+		starts.insert(starts.begin(), 0);
+	}
+	std::vector<u64> rangeCycles(starts.size());
+	for (size_t i = 0; i < starts.size(); i++)
+	{
+		u32 end = i + 1 < starts.size() ? starts[i + 1] : Memory::MAX_MEM;
+		rangeCycles[i] = std::accumulate(m_Cycles.begin() + starts[i], m_Cycles.begin() + end, 0ull);
+	}
+	std::fprintf(out, "\n%-24s %-12s %14s %8s\n", "range", "addresses", "cycles", "cycles%");
+	for (u32 i : hottest(starts.size(), [&](u32 i) { return rangeCycles[i]; }))
+	{
+		u32 end = i + 1 < starts.size() ? starts[i + 1] : Memory::MAX_MEM;
+		std::fprintf(out, "%-24s $%04X-$%04X  %14llu %7.2f%%\n", Name((word)starts[i]).c_str(), starts[i], end - 1,
+			rangeCycles[i], Percent(rangeCycles[i], total));
+	}
+
+	std::fprintf(out, "\n%-24s %14s %14s %8s\n", "branch", "taken", "not taken", "taken%");
+	for (u32 address : hottest(Memory::MAX_MEM, [&](u32 i) { return m_Taken[i] + m_NotTaken[i]; }))
+	{
+		std::fprintf(out, "%-24s %14llu %14llu %7.2f%%\n", Name((word)address).c_str(), m_Taken[address], m_NotTaken[address],
+			Percent(m_Taken[address], m_Taken[address] + m_NotTaken[address]));
+	}
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <array>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "compiler.hpp"
+#include "cpu.hpp"
+
+/// Execution profile of a guest program, an alternative to CPU::Execute for
+/// finding out where it spends its time.
+///
+/// Execute() runs the same loop as CPU::Execute with this as its probe (see
+/// dispatch::Run), counting per opcode, per PC and per branch. It also follows
+/// calls to attribute cycles to call stacks: JSR, BRK, invalid opcodes and
+/// interrupts enter a frame named after their target, RTS and RTI leave it.
+///
+/// Addresses are shown by symbol when symbols are given, as `name` or
+/// `name+offset` from the nearest symbol at or below the address.
+struct Profiler
+{
+	static constexpr size_t MAX_DEPTH = 256;	// deeper calls are charged to the frame at this depth
+
+	Profiler();
+
+	/// Same contract as CPU::Execute, without breakpoints.
+	ExecResult Execute(CPU& cpu, u64 cycles, Memory& ram);
+
+	/// Forgets everything recorded, keeps the symbols.
+	void Clear();
+
+	void SetSymbols(std::vector<Symbol> symbols);
+	/// Reads `name = address` or `address name` lines; addresses are $hex,
+	/// 0xhex or plain hex and `;` starts a comment. Other lines are skipped.
+	/// False if the file cannot be read.
+	bool LoadSymbols(const char* path);
+
+	/// `name` / `name+offset` for symbolised addresses, `$XXXX` otherwise.
+	std::string Name(word address) const;
+
+	/// Cycles per call stack in the folded format flamegraph.pl, inferno and
+	/// speedscope read: `outer;inner;innermost cycles` per line.
+	void WriteFolded(FILE* out) const;
+
+	/// Opcodes, hottest addresses, cycles per symbol (per page without
+	/// symbols) and branches, `top` lines each.
+	void WriteReport(FILE* out, size_t top = 20) const;
+
+	// dispatch::Run probe
+	void Retired(const CPU& cpu, word pc, byte opcode, u32 cycles);
+	void Interrupted(const CPU& cpu);
+
+	std::array<u64, 256> m_OpcodeCounts;
+	std::array<u64, 256> m_OpcodeCycles;
+	std::vector<u64> m_Hits;		// instructions started, by address
+	std::vector<u64> m_Cycles;		// cycles spent, by address of the instruction
+	std::vector<u64> m_Taken;		// by address of the branch
+	std::vector<u64> m_NotTaken;
+
+private:
+	struct Frame
+	{
+		word entry;				// address the frame was entered at
+		u32 parent;
+		u64 cycles = 0;			// spent in this frame itself, not in its callees
+		std::vector<u32> children;
+	};
+
+	void Enter(word entry);
+	void Leave();
+	std::string Path(u32 frame) const;
+
+	std::vector<Frame> m_Frames;	// call tree, m_Frames[0] is the root
+	u32 m_Frame = 0;
+	u32 m_Depth = 0;
+	u32 m_Overflow = 0;			// calls not entered because of MAX_DEPTH
+
+	std::vector<Symbol> m_Symbols;	// sorted by value
+};
@@ -0,0 +1,237 @@
+#include "recompiler.hpp"
+#include <cstdarg>
+#include <cstdio>
+#include <map>
+#include <vector>
+#include "disassembler.hpp"
+#include "dispatch.hpp"
+#include "loader.hpp"
+
+namespace
+{
+	struct Instruction
+	{
+		word address;
+		byte opcode;
+		byte length;
+		word operand;
+	};
+
+	struct Block
+	{
+		std::vector<Instruction> instructions;		// empty when nothing could be decoded
+		bool endsBlock = false;
+		dispatch::Ending ending = dispatch::Ending::Normal;
+
+		word End() const
+		{
+			const Instruction& last = instructions.back();
+			return (word)(last.address + last.length);
+		}
+	};
+
+	word ReadWord(const Memory& image, u32 address)
+	{
+		return (word)(image[address] << 8 | image[address + 1]);
+	}
+
+	// Decodes the block at `address` the way BlockCache::Decode does, and adds
+	// where control goes from it to `targets`.
+	Block Decode(const Memory& image, word address, std::vector<word>& targets)
+	{
+		Block block;
+		u32 firstPage = address / Memory::PAGE_SIZE;
+		auto decodable = [&](u32 at)
+		{
+			return at < Memory::MAX_MEM && at / Memory::PAGE_SIZE <= firstPage + 1;
+		};
+
+		u32 pc = address;
+		while (decodable(pc))
+		{
+			byte opcode = image[pc];
+			const dispatch::Decoding& decoding = dispatch::s_Decoding[opcode];
+			if (!decodable(pc + decoding.length - 1))
+			{
+				break;
+			}
+
+			Instruction ins{ (word)pc, opcode, decoding.length, 0 };
+			for (u32 i = 1; i < decoding.length; i++)
+			{
+				ins.operand = (word)(ins.operand << 8) | image[pc + i];
+			}
+			block.instructions.push_back(ins);
+
+			word next = (word)(pc + decoding.length);
+			if (decoding.endsBlock)
+			{
+				block.endsBlock = true;
+				block.ending = dispatch::EndOf(opcode, (word)pc, ins.operand);
+				switch (dispatch::s_Forms[opcode].operation)
+				{
+					case dispatch::Operation::Branch:
+						targets.push_back(next);
+						targets.push_back((word)(next + (byte)ins.operand));
+						break;
+					case dispatch::Operation::JMP:
+						targets.push_back(ins.operand);
+						break;
+					case dispatch::Operation::JSR:
+						// RTS comes back to the JSR itself
+						targets.push_back(ins.operand);
+						targets.push_back((word)pc);
+						break;
+					case dispatch::Operation::BRK:
+						// and RTI to the instruction after the BRK; a block that
+						// is a lone BRK is more likely zeroed memory, which would
+						// be followed to its end
+						if (pc != address)
+						{
+							targets.push_back(next);
+						}
+						break;
+					default:
+						break;
+				}
+				return block;
+			}
+			pc = next;
+		}
+
+		// cut at the page limit, the rest is a block of its own
+		if (!block.instructions.empty() && pc < Memory::MAX_MEM)
+		{
+			targets.push_back((word)pc);
+		}
+		return block;
+	}
+
+	void Append(std::string& out, const char* format, ...)
+	{
+		char line[160];
+		va_list args;
+		va_start(args, format);
+		std::vsnprintf(line, sizeof(line), format, args);
+		va_end(args);
+		out += line;
+	}
+
+	const char* EndingName(dispatch::Ending ending)
+	{
+		switch (ending)
+		{
+			case dispatch::Ending::Halt:		return "dispatch::Ending::Halt";
+			case dispatch::Ending::Invalid:		return "dispatch::Ending::Invalid";
+			default:							return "dispatch::Ending::Normal";
+		}
+	}
+
+	void Emit(std::string& out, const Memory& image, word address, const Block& block)
+	{
+		const std::vector<Instruction>& instructions = block.instructions;
+		word end = block.End();
+
+		Append(out, "\tconst byte CODE_%04X[] = {", address);
+		for (u32 at = address; at != end; at = (word)(at + 1))
+		{
+			Append(out, "%s0x%02X", at == address ? " " : ", ", image[at]);
+		}
+		out += " };\n\n";
+
+		Append(out, "\tbool Block_%04X(CPU& cpu, u32& cycles, Memory& ram)\n\t{\n", address);
+		bool watches = false;
+		for (size_t i = 0; i + 1 < instructions.size(); i++)
+		{
+			watches |= dispatch::s_Traits[instructions[i].opcode].writes;
+		}
+		if (watches)
+		{
+			out += "\t\tu32 epoch = ram.CodeEpoch();\n";
+		}
+
+		for (size_t i = 0; i < instructions.size(); i++)
+		{
+			const Instruction& ins = instructions[i];
+			word next = (word)(ins.address + ins.length);
+			bool last = i + 1 == instructions.size();
+
+			// only the instructions that end a block look at PC
+			if (last && block.endsBlock)
+			{
+				Append(out, "\t\tcpu.PC = 0x%04X;\n", next);
+			}
+			Append(out, "\t\tdispatch::HandleDecoded<0x%02X>(cpu, 0x%04X, cycles, ram);\t// $%04X: %s\n",
+				ins.opcode, ins.operand, ins.address, Disassemble(image, ins.address).text.c_str());
+			if (!last && dispatch::s_Traits[ins.opcode].writes)
+			{
+				Append(out, "\t\tif (ram.CodeEpoch() != epoch)\n\t\t{\n\t\t\tcpu.PC = 0x%04X;\n\t\t\treturn false;\n\t\t}\n", next);
+			}
+		}
+		if (!block.endsBlock)
+		{
+			Append(out, "\t\tcpu.PC = 0x%04X;\n", end);
+		}
+		out += "\t\treturn true;\n\t}\n\n";
+	}
+}
+
+Recompilation Recompile(const Memory& image, const std::string& symbol)
+{
+	std::vector<word> targets = { Vectors::STARTUP };
+	for (u32 i = 0; i < 256; i++)
+	{
+		// unset entries read as $0000, which holds data, not a handler
+		word isr = ReadWord(image, Vectors::ISR_TABLE + 2 * i);
+		if (isr != 0)
+		{
+			targets.push_back(isr);
+		}
+	}
+
+	std::map<word, Block> blocks;
+	while (!targets.empty())
+	{
+		word address = targets.back();
+		targets.pop_back();
+		if (!blocks.contains(address))
+		{
+			blocks.emplace(address, Decode(image, address, targets));
+		}
+	}
+
+	Recompilation result;
+	std::string body;
+	std::string table;
+	for (const auto& [address, block] : blocks)
+	{
+		if (block.instructions.empty())
+		{
+			continue;
+		}
+		Emit(body, image, address, block);
+		Append(table, "\t\t{ 0x%04X, %u, CODE_%04X, &Block_%04X, %s, %s },\n", address,
+			(u32)(block.End() - address) & 0xFFFF, address, address,
+			block.endsBlock ? "true" : "false", EndingName(block.ending));
+		result.blocks++;
+		result.instructions += (u32)block.instructions.size();
+	}
+
+	std::string& out = result.source;
+	Append(out, "// Recompiled ahead of time (see recompiler.hpp): %u blocks, %u instructions.\n\n",
+		result.blocks, result.instructions);
+	out += "#include \"aot.hpp\"\n\nnamespace\n{\n";
+	out += body;
+	if (result.blocks > 0)
+	{
+		out += "\tconst aot::Block BLOCKS[] =\n\t{\n";
+		out += table;
+		out += "\t};\n}\n\n";
+	}
+	else
+	{
+		out += "\tconst aot::Block* const BLOCKS = nullptr;\n}\n\n";
+	}
+	Append(out, "extern const aot::Program %s = { BLOCKS, %u };\n", symbol.c_str(), result.blocks);
+	return result;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <string>
+#include "memory.hpp"
+
+struct Recompilation
+{
+	std::string source;			// the C++ translation unit
+	u32 blocks = 0;
+	u32 instructions = 0;		// in all blocks, counted once for each they are in
+};
+
+/// Ahead-of-time recompiler from an image to C++.
+///
+/// Recovers the control flow of `image` from its startup code
+/// (Vectors::STARTUP) and every set entry of its ISR table, following
+/// branches both ways, JMP and JSR targets, the JSR itself (where RTS comes
+/// back to) and the instruction after BRK (where RTI does). Each block found
+/// becomes a function over CPU and Memory (see aot.hpp), and the whole an
+/// `aot::Program` defined as `symbol`, for another program to declare
+///
+///		extern const aot::Program symbol;
+///
+/// and run with AotRunner, linked with the rest of the VM and compiled with
+/// optimizations on. Whatever it did not reach, or what memory holds
+/// differently at run time, is interpreted.
+///
+/// `image` is read the way the CPU reads it, so it should have no devices
+/// mapped; at run time they are left to the interpreter anyway.
+Recompilation Recompile(const Memory& image, const std::string& symbol);
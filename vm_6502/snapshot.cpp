@@ -0,0 +1,295 @@
+#include "snapshot.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	constexpr byte MAGIC[4] = { 'V', 'M', 'S', 'S' };
+	constexpr byte VERSION = 1;
+	constexpr size_t HEADER_SIZE = 18;
+
+	constexpr byte RAW = 0;
+	constexpr byte RUNS = 1;
+
+	// PackBits: a header byte h followed by h + 1 literal bytes when h < 128,
+	// or by one byte repeated 257 - h times when h > 128. Only runs of three
+	// or more are worth a repeat, so a page never grows by more than a header
+	// per 128 bytes.
+	constexpr size_t MAX_PACKED = Memory::PAGE_SIZE + Memory::PAGE_SIZE / 128;
+
+	size_t Pack(const byte* page, byte* out)
+	{
+		constexpr size_t SIZE = Memory::PAGE_SIZE;
+		size_t size = 0;
+		for (size_t i = 0; i < SIZE; )
+		{
+			size_t run = 1;
+			while (i + run < SIZE && run < 128 && page[i + run] == page[i])
+			{
+				run++;
+			}
+			if (run >= 3)
+			{
+				out[size++] = (byte)(257 - run);
+				out[size++] = page[i];
+				i += run;
+				continue;
+			}
+
+			size_t start = i;
+			do
+			{
+				i++;
+			} while (i < SIZE && i - start < 128 && !(i + 2 < SIZE && page[i] == page[i + 1] && page[i] == page[i + 2]));
+			out[size++] = (byte)(i - start - 1);
+			std::memcpy(out + size, page + start, i - start);
+			size += i - start;
+		}
+		return size;
+	}
+
+	// whether `in` unpacks to exactly one page
+	bool CheckPacked(const byte* in, size_t size)
+	{
+		size_t at = 0;
+		size_t i = 0;
+		while (i < size)
+		{
+			byte header = in[i++];
+			if (header == 128)
+			{
+				return false;
+			}
+			i += header < 128 ? header + 1u : 1u;
+			at += header < 128 ? header + 1u : 257u - header;
+		}
+		// both only grow, so ending exactly on the page and the data means no
+		// run overshot either
+		return at == Memory::PAGE_SIZE && i == size;
+	}
+
+	// `in` must pass CheckPacked()
+	void Unpack(const byte* in, byte* page)
+	{
+		for (size_t at = 0; at < Memory::PAGE_SIZE; )
+		{
+			byte header = *in++;
+			if (header < 128)
+			{
+				std::memcpy(page + at, in, header + 1u);
+				in += header + 1u;
+				at += header + 1u;
+			}
+			else
+			{
+				std::memset(page + at, *in++, 257u - header);
+				at += 257u - header;
+			}
+		}
+	}
+
+	bool IsZero(const byte* page)
+	{
+		static const byte zero[Memory::PAGE_SIZE] = {};
+		return std::memcmp(page, zero, Memory::PAGE_SIZE) == 0;
+	}
+
+	void PutWord(std::vector<byte>& out, word value)
+	{
+		out.push_back((byte)(value >> 8));
+		out.push_back((byte)value);
+	}
+
+	word GetWord(const byte* data)
+	{
+		return (word)(data[0] << 8 | data[1]);
+	}
+}
+
+void SaveSnapshot(std::vector<byte>& out, const CPU& cpu, const Memory& ram, const Memory* base, Compression compression)
+{
+	out.assign(MAGIC, MAGIC + sizeof(MAGIC));
+	out.push_back(VERSION);
+	out.push_back(base != nullptr);
+	out.push_back((byte)compression);
+	out.push_back(0);
+	PutWord(out, cpu.PC);
+	PutWord(out, cpu.SP);
+	out.push_back(cpu.A);
+	out.push_back(cpu.X);
+	out.push_back(cpu.Y);
+	out.push_back(cpu.Status());
+	size_t countAt = out.size();
+	PutWord(out, 0);
+
+	// only the dirty pages can differ from the reference the VM was last reset to
+	u32 candidates[Memory::PAGE_COUNT];
+	u32 candidateCount = 0;
+	if (ram.Baseline() == base)
+	{
+		for (u32 i = 0; i < ram.DirtyPages(); i++)
+		{
+			candidates[candidateCount++] = ram.DirtyPage(i);
+		}
+		std::sort(candidates, candidates + candidateCount);
+	}
+	else
+	{
+		for (u32 page = 0; page < Memory::PAGE_COUNT; page++)
+		{
+			candidates[candidateCount++] = page;
+		}
+	}
+
+	word count = 0;
+	byte packed[MAX_PACKED];
+	for (u32 i = 0; i < candidateCount; i++)
+	{
+		u32 page = candidates[i];
+		const byte* data = ram.PageData(page);
+		if (base)
+		{
+			const byte* reference = base->PageData(page);
+			if (data == reference || std::memcmp(data, reference, Memory::PAGE_SIZE) == 0)
+			{
+				continue;
+			}
+		}
+		else if (ram.SharesZeroPage(page) || IsZero(data))
+		{
+			continue;
+		}
+
+		count++;
+		out.push_back((byte)page);
+		size_t size = compression == Compression::Runs ? Pack(data, packed) : Memory::PAGE_SIZE;
+		if (size < Memory::PAGE_SIZE)
+		{
+			out.push_back(RUNS);
+			out.push_back((byte)size);
+			out.insert(out.end(), packed, packed + size);
+		}
+		else
+		{
+			out.push_back(RAW);
+			out.insert(out.end(), data, data + Memory::PAGE_SIZE);
+		}
+	}
+	out[countAt] = (byte)(count >> 8);
+	out[countAt + 1] = (byte)count;
+}
+
+bool RestoreSnapshot(std::span<const byte> snapshot, CPU& cpu, Memory& ram, const Memory* base, std::string* error)
+{
+	auto fail = [error](const char* message)
+	{
+		if (error)
+		{
+			*error = message;
+		}
+		return false;
+	};
+
+	const byte* data = snapshot.data();
+	if (snapshot.size() < HEADER_SIZE || std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0)
+	{
+		return fail("not a snapshot");
+	}
+	if (data[4] != VERSION)
+	{
+		return fail("unsupported snapshot version");
+	}
+	if (data[5] > 1 || data[6] > (byte)Compression::Runs)
+	{
+		return fail("malformed header");
+	}
+	if (data[5] && !base)
+	{
+		return fail("snapshot was taken against a base");
+	}
+	if (!data[5] && base)
+	{
+		return fail("snapshot was taken against zeroes");
+	}
+
+	// check every page before touching the VM
+	u32 count = GetWord(data + 16);
+	if (count > Memory::PAGE_COUNT)
+	{
+		return fail("malformed header");
+	}
+	size_t at = HEADER_SIZE;
+	int previous = -1;
+	for (u32 i = 0; i < count; i++)
+	{
+		if (at + 2 > snapshot.size() || data[at] <= previous)
+		{
+			return fail("malformed page");
+		}
+		previous = data[at];
+		byte kind = data[at + 1];
+		at += 2;
+		if (kind == RAW)
+		{
+			at += Memory::PAGE_SIZE;
+		}
+		else if (kind == RUNS && at < snapshot.size())
+		{
+			size_t size = data[at++];
+			if (at + size > snapshot.size() || !CheckPacked(data + at, size))
+			{
+				return fail("malformed page");
+			}
+			at += size;
+		}
+		else
+		{
+			return fail("malformed page");
+		}
+		if (at > snapshot.size())
+		{
+			return fail("malformed page");
+		}
+	}
+	if (at != snapshot.size())
+	{
+		return fail("trailing bytes");
+	}
+
+	cpu.PC = GetWord(data + 8);
+	cpu.SP = GetWord(data + 10);
+	cpu.A = data[12];
+	cpu.X = data[13];
+	cpu.Y = data[14];
+	cpu.SetStatus(data[15]);
+
+	if (base)
+	{
+		ram.Restore(*base);
+	}
+	else
+	{
+		ram.Init();
+	}
+	byte page[Memory::PAGE_SIZE];
+	at = HEADER_SIZE;
+	for (u32 i = 0; i < count; i++)
+	{
+		u32 number = data[at];
+		byte kind = data[at + 1];
+		at += 2;
+		if (kind == RAW)
+		{
+			ram.WritePage(number, data + at);
+			at += Memory::PAGE_SIZE;
+		}
+		else
+		{
+			size_t size = data[at++];
+			Unpack(data + at, page);
+			ram.WritePage(number, page);
+			at += size;
+		}
+	}
+	return true;
+}
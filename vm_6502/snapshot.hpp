@@ -0,0 +1,44 @@
+#pragma once
+#include <span>
+#include <string>
+#include <vector>
+#include "cpu.hpp"
+
+/// How SaveSnapshot() stores the pages it keeps.
+enum class Compression : byte
+{
+	None,
+	Runs,		// PackBits run-length coding, per page, where it makes the page smaller
+};
+
+/// Checkpoint of a VM: its registers and the pages of its memory that differ
+/// from a reference, either zeroes or `base`, a frozen Memory the VM was
+/// forked or restored from (e.g. an Image or VmJob::base).
+///
+/// A VM last reset to the reference only has its dirty pages compared (see
+/// Memory::DirtyPages), so saving and restoring costs about a memcpy per page
+/// the guest wrote to. Device state is not part of a snapshot.
+///
+/// The format, words high byte first like the CPU reads them:
+///
+///		0		"VMSS"
+///		4		byte		version
+///		5		byte		1 if taken against a base, 0 against zeroes
+///		6		byte		Compression
+///		7		byte		0
+///		8		word, word	PC, SP
+///		12		byte[4]		A, X, Y, CPU::Status()
+///		16		word		n, the number of pages
+///		18		n pages		page number, 0 (raw) then PAGE_SIZE bytes, or
+///							1 (runs) then their length as a byte and the runs
+///
+/// Pages are in ascending order, so equal VMs give equal snapshots.
+void SaveSnapshot(std::vector<byte>& out, const CPU& cpu, const Memory& ram, const Memory* base = nullptr,
+	Compression compression = Compression::None);
+
+/// Makes `cpu` and `ram` what they were when `snapshot` was saved. A snapshot
+/// taken against a base needs the same base, unchanged, and one taken
+/// against zeroes needs none. Nothing is changed when this fails; the reason
+/// goes to `error` if given.
+bool RestoreSnapshot(std::span<const byte> snapshot, CPU& cpu, Memory& ram, const Memory* base = nullptr,
+	std::string* error = nullptr);
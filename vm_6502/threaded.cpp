@@ -0,0 +1,66 @@
+#include "dispatch.hpp"
+
+#if defined(__GNUC__) || defined(__clang__)
+
+// Every handler is inlined at its own label and ends with its own indirect
+// jump, so the branch predictor sees one dispatch site per opcode. Only the
+// labels of instructions that end a block look at the budget.
+ExecResult CPU::ExecuteThreaded(u64 cycles, Memory& ram)
+{
+#define VM_LABEL_ADDRESS(op) &&op_##op,
+	static void* const labels[256] = { VM_FOR_EACH_OPCODE(VM_LABEL_ADDRESS) };
+#undef VM_LABEL_ADDRESS
+
+	dispatch::Budget budget(cycles, &ram);
+	StopReason reason = StopReason::Budget;
+	u32 left = 0;
+
+#define VM_DISPATCH() \
+	goto *labels[dispatch::Fetch(*this, ram)]
+
+	if (!budget.Remaining())
+	{
+		goto stop;
+	}
+	left = budget.cycles;
+	VM_DISPATCH();
+
+#define VM_LABEL(op) \
+	op_##op: \
+	{ \
+		[[maybe_unused]] word pc = PC - 1; \
+		dispatch::Handle<op>(*this, left, ram); \
+		if constexpr (dispatch::s_Traits[op].endsBlock) \
+		{ \
+			dispatch::Ending ending = dispatch::EndOf(op, pc, PC); \
+			if (dispatch::MayStop(ending, ram, left)) \
+			{ \
+				budget.cycles = left; \
+				if (dispatch::Stop(ending, *this, ram, budget, reason)) \
+				{ \
+					goto stop; \
+				} \
+				left = budget.cycles; \
+			} \
+		} \
+	} \
+	VM_DISPATCH();
+
+	VM_FOR_EACH_OPCODE(VM_LABEL)
+
+#undef VM_LABEL
+#undef VM_DISPATCH
+
+stop:
+	ram.Flush();
+	return { budget.Used(), reason };
+}
+
+#else
+
+ExecResult CPU::ExecuteThreaded(u64 cycles, Memory& ram)
+{
+	return ExecuteTable(cycles, ram);
+}
+
+#endif
@@ -0,0 +1,114 @@
+#pragma once
+#include "memory.hpp"
+
+/// Programmable interval timer, four registers mapped from `address`:
+///
+///		+0, +1	PERIOD		cycles between expiries, high byte first; 0 is 65536
+///		+2		CONTROL		ENABLE, REPEAT and NMI bits
+///		+3		STATUS		bit 0 set once the timer expired; any write clears it
+///
+/// Writing CONTROL with ENABLE set (re)starts the count from PERIOD, without
+/// it stops the timer. On expiry the timer sets STATUS and raises IRQ input
+/// `irq` until the guest writes STATUS, or triggers an NMI if the NMI bit is
+/// set. With REPEAT it starts over, counted from the expiry, so the period
+/// does not drift; otherwise ENABLE is cleared.
+///
+/// The timer schedules one event per expiry (Memory::Schedule) and costs
+/// nothing between them. It maps itself on construction and unmaps itself
+/// when destroyed.
+struct Timer : Device
+{
+	static constexpr u32 PERIOD = 0;
+	static constexpr u32 CONTROL = 2;
+	static constexpr u32 STATUS = 3;
+	static constexpr u32 SIZE = 4;
+
+	static constexpr byte ENABLE = 0x01;
+	static constexpr byte REPEAT = 0x02;
+	static constexpr byte NMI = 0x04;
+
+	Timer(Memory& ram, u32 address, u32 irq = 0)
+		: m_Ram(ram), m_Address(address), m_Irq(irq)
+	{
+		m_Ram.Map(address, address + SIZE - 1, *this);
+	}
+
+	~Timer() override
+	{
+		m_Ram.SetIrq(m_Irq, false);
+		m_Ram.Unmap(m_Address, m_Address + SIZE - 1);
+	}
+
+	Timer(const Timer&) = delete;
+	Timer& operator=(const Timer&) = delete;
+
+	byte Read(u32 address, byte ram) override
+	{
+		return address - m_Address == STATUS ? m_Expired : ram;
+	}
+
+	void Write(u32 address, byte data) override
+	{
+		switch (address - m_Address)
+		{
+			case PERIOD:
+				m_Period = (word)(data << 8 | (m_Period & 0x00FF));
+				break;
+			case PERIOD + 1:
+				m_Period = (word)((m_Period & 0xFF00) | data);
+				break;
+			case CONTROL:
+				m_Control = data;
+				// a pending expiry of the last start no longer counts
+				m_Start++;
+				if (data & ENABLE)
+				{
+					Start();
+				}
+				break;
+			case STATUS:
+				m_Expired = 0;
+				m_Ram.SetIrq(m_Irq, false);
+				break;
+		}
+	}
+
+	void Event(u32 tag) override
+	{
+		if (tag != m_Start)
+		{
+			return;
+		}
+		m_Expired = 1;
+		if (m_Control & NMI)
+		{
+			m_Ram.Nmi();
+		}
+		else
+		{
+			m_Ram.SetIrq(m_Irq, true);
+		}
+		if (m_Control & REPEAT)
+		{
+			Start();
+		}
+		else
+		{
+			m_Control &= ~ENABLE;
+		}
+	}
+
+private:
+	void Start()
+	{
+		m_Ram.Schedule(m_Period ? m_Period : 0x10000, *this, m_Start);
+	}
+
+	Memory& m_Ram;
+	u32 m_Address;
+	u32 m_Irq;
+	word m_Period = 0;
+	byte m_Control = 0;
+	byte m_Expired = 0;
+	u32 m_Start = 0;		// tags the events of the current start
+};
@@ -0,0 +1,488 @@
+#include "trace.hpp"
+#include <cstring>
+#include <vector>
+#include "dispatch.hpp"
+
+// A trace is an 8-byte header, "VMTR" and a version, followed by records.
+// Every record starts with a tag byte saying which fields follow, in this
+// order:
+//
+//		EXTENDED	byte		more flags: EXT_CYCLES, EXT_STATE, EXT_INTERRUPT
+//					byte		opcode (not in state records)
+//		EXT_CYCLES	byte		cycles taken, when not s_Decoding[opcode].cycles
+//		JUMP		word		PC after the instruction, when not the next one
+//		A, X, Y		byte		the new value
+//		SP			varint		zigzag difference to the old value
+//		FLAGS		byte		CPU::Status()
+//		WRITES		varint		count, then per write the zigzag difference
+//								of its address to the previous write's, varint,
+//								and the byte written
+//
+// A state record (EXTENDED with EXT_STATE) holds the whole CPU instead: PC
+// and SP as words, then A, X, Y and the flags. An interrupt record (EXTENDED
+// with EXT_INTERRUPT) holds the address of the handler an IRQ or NMI went
+// to, as a word; what it pushed and the I flag follow from the CPU before it.
+// Words are high byte first, like the CPU reads them; varints are LEB128.
+namespace
+{
+	constexpr byte MAGIC[4] = { 'V', 'M', 'T', 'R' };
+	constexpr byte VERSION = 2;			// 1 had no interrupt records
+	constexpr size_t HEADER_SIZE = 8;
+
+	constexpr byte JUMP = 0x01;
+	constexpr byte REG_A = 0x02;
+	constexpr byte REG_X = 0x04;
+	constexpr byte REG_Y = 0x08;
+	constexpr byte REG_SP = 0x10;
+	constexpr byte FLAGS = 0x20;
+	constexpr byte WRITES = 0x40;
+	constexpr byte EXTENDED = 0x80;
+
+	constexpr byte EXT_CYCLES = 0x01;
+	constexpr byte EXT_STATE = 0x02;
+	constexpr byte EXT_INTERRUPT = 0x04;
+
+	// tag, extension, opcode, cycles, PC, A, X, Y, SP, flags, write count
+	// and the writes, with every varint at its longest
+	constexpr size_t MAX_RECORD = 3 + 1 + 2 + 3 + 3 + 1 + 1 + 16 * (3 + 1);
+
+	u32 ZigZag(int value)
+	{
+		return (u32)value << 1 ^ (u32)(value >> 31);
+	}
+
+	int UnZigZag(u32 value)
+	{
+		return (int)(value >> 1) ^ -(int)(value & 1);
+	}
+
+	byte* PutVarint(byte* out, u32 value)
+	{
+		while (value >= 0x80)
+		{
+			*out++ = (byte)(value | 0x80);
+			value >>= 7;
+		}
+		*out++ = (byte)value;
+		return out;
+	}
+
+	byte* PutWord(byte* out, word value)
+	{
+		*out++ = (byte)(value >> 8);
+		*out++ = (byte)value;
+		return out;
+	}
+
+	/// Reads a trace file in chunks, always holding at least MAX_RECORD bytes
+	/// ahead unless the file ends sooner.
+	struct Reader
+	{
+		static constexpr size_t CHUNK_SIZE = 1024 * 1024;
+
+		FILE* file = nullptr;
+		std::vector<byte> buffer = std::vector<byte>(CHUNK_SIZE + MAX_RECORD);
+		size_t at = 0;
+		size_t size = 0;
+		bool truncated = false;			// a field ran past the end of the file
+
+		~Reader()
+		{
+			if (file)
+			{
+				std::fclose(file);
+			}
+		}
+
+		// false at the end of the file
+		bool Next()
+		{
+			if (size - at < MAX_RECORD && file)
+			{
+				std::memmove(buffer.data(), buffer.data() + at, size - at);
+				size -= at;
+				at = 0;
+				size += std::fread(buffer.data() + size, 1, buffer.size() - size, file);
+			}
+			return at < size;
+		}
+
+		byte Byte()
+		{
+			if (at == size)
+			{
+				truncated = true;
+				return 0;
+			}
+			return buffer[at++];
+		}
+
+		word Word()
+		{
+			byte high = Byte();
+			return (word)(high << 8 | Byte());
+		}
+
+		u32 Varint()
+		{
+			u32 value = 0;
+			for (u32 shift = 0; shift < 35; shift += 7)
+			{
+				byte part = Byte();
+				value |= (u32)(part & 0x7F) << shift;
+				if (!(part & 0x80))
+				{
+					break;
+				}
+			}
+			return value;
+		}
+	};
+
+	/// Collects the writes of one instruction during replay.
+	struct WriteLog : Device
+	{
+		std::vector<std::pair<word, byte>> writes;
+
+		void Write(u32 address, byte data) override
+		{
+			writes.emplace_back((word)address, data);
+		}
+	};
+
+	std::string Hex(u32 value, int digits)
+	{
+		char text[8];
+		std::snprintf(text, sizeof(text), "$%0*X", digits, value);
+		return text;
+	}
+
+	std::string Writes(const std::vector<std::pair<word, byte>>& writes)
+	{
+		std::string text = writes.empty() ? "none" : "";
+		for (const auto& [address, data] : writes)
+		{
+			if (!text.empty())
+		{
+			text += ' ';
+		}
+		text += Hex(address, 4);
+		text += '=';
+		text += Hex(data, 2);
+		}
+		return text;
+	}
+}
+
+TraceRecorder::TraceRecorder(const char* path)
+	: m_File(std::fopen(path, "wb")), m_Block(std::make_unique<byte[]>(BLOCK_SIZE))
+{
+	std::memcpy(m_Block.get(), MAGIC, sizeof(MAGIC));
+	m_Block[4] = VERSION;
+	std::memset(m_Block.get() + 5, 0, HEADER_SIZE - 5);
+	m_Size = HEADER_SIZE;
+	Flush();
+}
+
+TraceRecorder::~TraceRecorder()
+{
+	Flush();
+	if (m_File)
+	{
+		std::fclose(m_File);
+	}
+}
+
+ExecResult TraceRecorder::Execute(CPU& cpu, u64 cycles, Memory& ram)
+{
+	Sync(cpu);
+	ram.TraceWrites(this);
+	ExecResult result = dispatch::Run(cpu, cycles, ram, *this);
+	ram.TraceWrites(nullptr);
+	Flush();
+	return result;
+}
+
+void TraceRecorder::Flush()
+{
+	if (m_File && m_Size)
+	{
+		if (std::fwrite(m_Block.get(), 1, m_Size, m_File) != m_Size || std::fflush(m_File) != 0)
+		{
+			std::fclose(m_File);
+			m_File = nullptr;
+		}
+	}
+	m_Bytes += m_Size;
+	m_Size = 0;
+}
+
+void TraceRecorder::Sync(const CPU& cpu)
+{
+	byte flags = cpu.Status();
+	if (m_Synced && cpu.PC == m_PC && cpu.SP == m_SP && cpu.A == m_A && cpu.X == m_X && cpu.Y == m_Y && flags == m_Flags)
+	{
+		return;
+	}
+
+	if (m_Size > BLOCK_SIZE - MAX_RECORD)
+	{
+		Flush();
+	}
+	byte* out = m_Block.get() + m_Size;
+	*out++ = EXTENDED;
+	*out++ = EXT_STATE;
+	out = PutWord(out, cpu.PC);
+	out = PutWord(out, cpu.SP);
+	*out++ = cpu.A;
+	*out++ = cpu.X;
+	*out++ = cpu.Y;
+	*out++ = flags;
+	m_Size = out - m_Block.get();
+
+	m_PC = cpu.PC;
+	m_SP = cpu.SP;
+	m_A = cpu.A;
+	m_X = cpu.X;
+	m_Y = cpu.Y;
+	m_Flags = flags;
+	m_Synced = true;
+}
+
+void TraceRecorder::Write(u32 address, byte data)
+{
+	// a device or event can write more than any opcode; keep the first
+	// MAX_WRITES, and replay reports the instruction's writes as diverging
+	if (m_WriteCount < MAX_WRITES)
+	{
+		m_Writes[m_WriteCount++] = { (word)address, data };
+	}
+}
+
+void TraceRecorder::Interrupted(const CPU& cpu)
+{
+	if (m_Size > BLOCK_SIZE - MAX_RECORD)
+	{
+		Flush();
+	}
+	byte* out = m_Block.get() + m_Size;
+	*out++ = EXTENDED;
+	*out++ = EXT_INTERRUPT;
+	out = PutWord(out, cpu.PC);
+	m_Size = out - m_Block.get();
+
+	// the replay pushes the same bytes itself
+	m_WriteCount = 0;
+	m_PC = cpu.PC;
+	m_SP = cpu.SP;
+	m_Flags = cpu.Status();
+}
+
+void TraceRecorder::Retired(const CPU& cpu, word pc, byte opcode, u32 cycles)
+{
+	if (m_Size > BLOCK_SIZE - MAX_RECORD)
+	{
+		Flush();
+	}
+	m_Instructions++;
+
+	const dispatch::Decoding& decoding = dispatch::s_Decoding[opcode];
+	byte flags = cpu.Status();
+	byte tag = (cpu.PC != (word)(pc + decoding.length) ? JUMP : 0)
+		| (cpu.A != m_A ? REG_A : 0)
+		| (cpu.X != m_X ? REG_X : 0)
+		| (cpu.Y != m_Y ? REG_Y : 0)
+		| (cpu.SP != m_SP ? REG_SP : 0)
+		| (flags != m_Flags ? FLAGS : 0)
+		| (m_WriteCount ? WRITES : 0);
+	bool oddCycles = cycles != decoding.cycles;
+
+	byte* out = m_Block.get() + m_Size;
+	*out++ = tag | (oddCycles ? EXTENDED : 0);
+	if (oddCycles)
+	{
+		*out++ = EXT_CYCLES;
+	}
+	*out++ = opcode;
+	if (oddCycles)
+	{
+		*out++ = (byte)cycles;
+	}
+	if (tag & JUMP)
+	{
+		out = PutWord(out, cpu.PC);
+	}
+	if (tag & REG_A)
+	{
+		*out++ = cpu.A;
+	}
+	if (tag & REG_X)
+	{
+		*out++ = cpu.X;
+	}
+	if (tag & REG_Y)
+	{
+		*out++ = cpu.Y;
+	}
+	if (tag & REG_SP)
+	{
+		out = PutVarint(out, ZigZag((short)(cpu.SP - m_SP)));
+	}
+	if (tag & FLAGS)
+	{
+		*out++ = flags;
+	}
+	if (tag & WRITES)
+	{
+		out = PutVarint(out, m_WriteCount);
+		for (u32 i = 0; i < m_WriteCount; i++)
+		{
+			out = PutVarint(out, ZigZag(m_Writes[i].address - m_LastWrite));
+			*out++ = m_Writes[i].data;
+			m_LastWrite = m_Writes[i].address;
+		}
+		m_WriteCount = 0;
+	}
+	m_Size = out - m_Block.get();
+
+	m_PC = cpu.PC;
+	m_SP = cpu.SP;
+	m_A = cpu.A;
+	m_X = cpu.X;
+	m_Y = cpu.Y;
+	m_Flags = flags;
+}
+
+Replay ReplayTrace(const char* path, CPU& cpu, Memory& ram)
+{
+	Replay replay;
+	Reader reader;
+	reader.file = std::fopen(path, "rb");
+	if (!reader.file)
+	{
+		replay.error = std::string(path) + ": cannot open the file";
+		return replay;
+	}
+	byte header[HEADER_SIZE];
+	if (std::fread(header, 1, HEADER_SIZE, reader.file) != HEADER_SIZE || std::memcmp(header, MAGIC, sizeof(MAGIC)) != 0)
+	{
+		replay.error = std::string(path) + ": not a trace";
+		return replay;
+	}
+	if (header[4] != VERSION && header[4] != 1)
+	{
+		replay.error = std::string(path) + ": unsupported trace version " + std::to_string(header[4]);
+		return replay;
+	}
+
+	WriteLog log;
+	ram.TraceWrites(&log);
+
+	// the CPU as the trace has it
+	word sp = 0;
+	byte a = 0, x = 0, y = 0, flags = 0;
+	bool synced = false;
+	word lastWrite = 0;
+	std::vector<std::pair<word, byte>> writes;
+
+	while (reader.Next())
+	{
+		byte tag = reader.Byte();
+		byte extension = tag & EXTENDED ? reader.Byte() : 0;
+
+		if (extension & EXT_STATE)
+		{
+			cpu.PC = reader.Word();
+			cpu.SP = sp = reader.Word();
+			cpu.A = a = reader.Byte();
+			cpu.X = x = reader.Byte();
+			cpu.Y = y = reader.Byte();
+			flags = reader.Byte();
+			cpu.SetStatus(flags);
+			synced = true;
+			if (reader.truncated)
+			{
+				break;
+			}
+			continue;
+		}
+		if (extension & EXT_INTERRUPT)
+		{
+			word handler = reader.Word();
+			if (reader.truncated)
+			{
+				break;
+			}
+			dispatch::Interrupt::Enter(cpu, ram);
+			cpu.PC = handler;
+			sp = cpu.SP;
+			flags = cpu.Status();
+			continue;
+		}
+
+		byte opcode = reader.Byte();
+		const dispatch::Decoding& decoding = dispatch::s_Decoding[opcode];
+		word start = cpu.PC;
+		u32 cycles = extension & EXT_CYCLES ? reader.Byte() : decoding.cycles;
+		word pc = tag & JUMP ? reader.Word() : (word)(start + decoding.length);
+		a = tag & REG_A ? reader.Byte() : a;
+		x = tag & REG_X ? reader.Byte() : x;
+		y = tag & REG_Y ? reader.Byte() : y;
+		sp = tag & REG_SP ? (word)(sp + UnZigZag(reader.Varint())) : sp;
+		flags = tag & FLAGS ? reader.Byte() : flags;
+		writes.clear();
+		for (u32 count = tag & WRITES ? reader.Varint() : 0; count > 0 && !reader.truncated; count--)
+		{
+			lastWrite = (word)(lastWrite + UnZigZag(reader.Varint()));
+			writes.emplace_back(lastWrite, reader.Byte());
+		}
+		if (reader.truncated)
+		{
+			break;
+		}
+		if (!synced)
+		{
+			replay.error = std::string(path) + ": instructions before the first state record";
+			break;
+		}
+
+		// as CPU::Step, keeping the opcode
+		log.writes.clear();
+		u32 left = 0;
+		byte ran = dispatch::Fetch(cpu, ram);
+		dispatch::s_Table[ran](cpu, left, ram);
+		u32 took = 0 - left;
+
+		std::string reason;
+		auto check = [&reason](const char* what, bool same, const std::string& actual, const std::string& expected)
+		{
+			if (!same)
+			{
+				reason += (reason.empty() ? "" : ", ") + std::string(what) + " " + actual + " (trace " + expected + ")";
+			}
+		};
+		check("opcode", ran == opcode, Hex(ran, 2), Hex(opcode, 2));
+		check("writes", log.writes == writes, Writes(log.writes), Writes(writes));
+		check("PC", cpu.PC == pc, Hex(cpu.PC, 4), Hex(pc, 4));
+		check("A", cpu.A == a, Hex(cpu.A, 2), Hex(a, 2));
+		check("X", cpu.X == x, Hex(cpu.X, 2), Hex(x, 2));
+		check("Y", cpu.Y == y, Hex(cpu.Y, 2), Hex(y, 2));
+		check("SP", cpu.SP == sp, Hex(cpu.SP, 4), Hex(sp, 4));
+		check("flags", cpu.Status() == flags, Hex(cpu.Status(), 2), Hex(flags, 2));
+		check("cycles", took == cycles, std::to_string(took), std::to_string(cycles));
+		if (!reason.empty())
+		{
+			replay.divergence = Divergence{ replay.instructions, start, std::move(reason) };
+			break;
+		}
+		replay.instructions++;
+	}
+
+	ram.TraceWrites(nullptr);
+	ram.Flush();
+	if (reader.truncated)
+	{
+		replay.error = std::string(path) + ": truncated record after instruction " + std::to_string(replay.instructions);
+	}
+	return replay;
+}
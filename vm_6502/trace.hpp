@@ -0,0 +1,104 @@
+#pragma once
+#include <cstdio>
+#include <memory>
+#include <optional>
+#include <string>
+#include "cpu.hpp"
+
+/// Records everything a guest does into a binary trace file, for
+/// ReplayTrace() to re-run it later and point out where a run went
+/// differently.
+///
+/// Execute() runs the same loop as CPU::Execute with this as its probe (see
+/// dispatch::Run) and as the write tracer of `ram` (Memory::TraceWrites), and
+/// logs one record per instruction: its opcode, the registers and flags it
+/// changed, where it went if that was not the next instruction, its cycles if
+/// they were not the usual ones, and every byte it wrote; and one record per
+/// interrupt taken. Records only hold what changed, so most take two to four
+/// bytes; a state record with all registers starts every Execute() that
+/// finds the CPU changed behind its back.
+///
+/// Records are collected in a block of BLOCK_SIZE bytes that is written out
+/// when it fills up and when Execute() returns, so the file always ends on a
+/// whole record and a crashed run loses at most its last block.
+struct TraceRecorder : Device
+{
+	static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+	/// Creates or truncates the file at `path`; see Ok().
+	explicit TraceRecorder(const char* path);
+	~TraceRecorder() override;
+
+	TraceRecorder(const TraceRecorder&) = delete;
+	TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+	/// False if the file could not be created or written to; nothing is
+	/// recorded from then on.
+	bool Ok() const { return m_File != nullptr; }
+
+	/// Same contract as CPU::Execute, without breakpoints.
+	ExecResult Execute(CPU& cpu, u64 cycles, Memory& ram);
+
+	/// Writes out the records collected so far.
+	void Flush() override;
+
+	// dispatch::Run probe
+	void Retired(const CPU& cpu, word pc, byte opcode, u32 cycles);
+	void Interrupted(const CPU& cpu);
+	// Memory::TraceWrites tracer
+	void Write(u32 address, byte data) override;
+
+	u64 m_Instructions = 0;
+	u64 m_Bytes = 0;			// trace size so far, header included
+
+private:
+	struct Access
+	{
+		word address;
+		byte data;
+	};
+
+	static constexpr size_t MAX_WRITES = 16;	// per instruction, beyond which Write drops; BRK makes 4
+
+	void Sync(const CPU& cpu);
+
+	FILE* m_File = nullptr;
+	std::unique_ptr<byte[]> m_Block;
+	size_t m_Size = 0;
+
+	// the CPU as the trace last left it
+	word m_PC = 0;
+	word m_SP = 0;
+	byte m_A = 0, m_X = 0, m_Y = 0;
+	byte m_Flags = 0;
+	bool m_Synced = false;
+	word m_LastWrite = 0;
+
+	Access m_Writes[MAX_WRITES];
+	u32 m_WriteCount = 0;
+};
+
+/// Where a replay first did something other than the trace says.
+struct Divergence
+{
+	u64 instruction;		// index of the instruction in the trace, from 0
+	word pc;				// where it started
+	std::string reason;		// e.g. "A $05 (trace $06), PC $0210 (trace $0208)"
+};
+
+struct Replay
+{
+	u64 instructions = 0;				// replayed and matching the trace
+	std::optional<Divergence> divergence;
+	std::string error;					// the trace could not be read
+
+	bool Ok() const { return error.empty() && !divergence; }
+};
+
+/// Re-runs the trace at `path` one instruction at a time and compares each
+/// against its record, stopping at the first difference or the end of the
+/// trace. `ram` must hold what it held when recording started, with the same
+/// devices mapped; the CPU is taken from the trace's state records and is
+/// left where the replay stopped. Host-side changes to memory between
+/// Execute() calls are not in the trace and have to be made again.
+Replay ReplayTrace(const char* path, CPU& cpu, Memory& ram);